@@ -1,7 +1,45 @@
 #pragma once
 #include <type_traits>
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span>
+#define ARCHIVE_HAS_SPAN 1
+#endif
+
+/// `ARCHIVE_X86` and `ARCHIVE_TARGET(features)` stay defined for the SIMD kernels of other archive headers
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define ARCHIVE_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#define ARCHIVE_TARGET(features)
+#else
+#define ARCHIVE_TARGET(features) __attribute__((target(features)))
+#endif
 
 #define ARCHIVE_ASSERT(x)
 
@@ -17,6 +55,17 @@ struct is_primitive {
 template<typename T> inline constexpr bool is_primitive_v = is_primitive<T>::value;
 
 
+/// Checks if type is an integer that can be written as varint.
+/// Single-byte integers and bools are always written as is
+template<typename T>
+struct is_varint_integer {
+    static const bool value = std::is_integral<T>::value
+            && !std::is_same<T, bool>::value
+            && sizeof(T) > 1;
+};
+template<typename T> inline constexpr bool is_varint_integer_v = is_varint_integer<T>::value;
+
+
 /// Checks if given class looks like an stl container
 template<typename T, typename = void>
 struct is_container : std::false_type {};
@@ -133,6 +182,30 @@ struct has_insert_after<
 template<typename T> inline constexpr bool has_insert_after_v = has_insert_after<T>::value;
 
 
+/// Checks container for `emplace_back(Args...)`
+template<typename Container, typename = void>
+struct has_emplace_back : std::false_type {};
+
+template<typename Container>
+struct has_emplace_back<
+        Container,
+        std::void_t<decltype(std::declval<Container>().emplace_back(std::declval<typename Container::value_type>()))>
+> : std::true_type {};
+template<typename T> inline constexpr bool has_emplace_back_v = has_emplace_back<T>::value;
+
+
+/// Checks container for `emplace_hint(It, Args...)`: ordered and unordered associative containers
+template<typename Container, typename = void>
+struct has_emplace_hint : std::false_type {};
+
+template<typename Container>
+struct has_emplace_hint<
+        Container,
+        std::void_t<decltype(std::declval<Container>().emplace_hint(std::declval<Container>().end(), std::declval<typename Container::value_type>()))>
+> : std::true_type {};
+template<typename T> inline constexpr bool has_emplace_hint_v = has_emplace_hint<T>::value;
+
+
 /// Checks container for `reserve(size_t)`
 template<typename Container, typename = void>
 struct has_reserve: std::false_type {};
@@ -145,6 +218,80 @@ struct has_reserve<
 template<typename T> inline constexpr bool has_reserve_v = has_reserve<T>::value;
 
 
+/// Checks container for `get_allocator()`
+template<typename Container, typename = void>
+struct has_get_allocator: std::false_type {};
+
+template<typename Container>
+struct has_get_allocator<
+        Container,
+        std::void_t<decltype(std::declval<Container>().get_allocator())>
+> : std::true_type {};
+template<typename T> inline constexpr bool has_get_allocator_v = has_get_allocator<T>::value;
+
+
+/// Checks if type is a `std::pair`
+template<typename T>
+struct is_pair : std::false_type {};
+
+template<typename First, typename Second>
+struct is_pair<std::pair<First, Second>> : std::true_type {};
+template<typename T> inline constexpr bool is_pair_v = is_pair<T>::value;
+
+
+/// Checks container for `resize(size_t)`
+template<typename Container, typename = void>
+struct has_resize: std::false_type {};
+
+template<typename Container>
+struct has_resize<
+        Container,
+        std::void_t<decltype(std::declval<Container>().resize(0))>
+> : std::true_type {};
+template<typename T> inline constexpr bool has_resize_v = has_resize<T>::value;
+
+
+/// Checks if container/array keeps its elements in a single memory block
+/// accessible with `std::data` (vector, string, std::array, C arrays)
+template<typename T, typename = void>
+struct is_contiguous : std::false_type {};
+
+template<typename T>
+struct is_contiguous<
+        T,
+        std::void_t<
+            decltype(std::data(std::declval<T&>())),
+            decltype(std::size(std::declval<T&>()))
+        >
+> : std::true_type {};
+template<typename T> inline constexpr bool is_contiguous_v = is_contiguous<T>::value;
+
+
+/// Checks if container/array is contiguous and holds primitives, so
+/// its whole payload can be copied with a single storage call
+template<typename T, typename = void>
+struct is_contiguous_primitive : std::false_type {};
+
+template<typename T>
+struct is_contiguous_primitive<
+        T,
+        std::enable_if_t<is_contiguous_v<T>>
+> : is_primitive<std::remove_const_t<element_type_t<T>>> {};
+template<typename T> inline constexpr bool is_contiguous_primitive_v = is_contiguous_primitive<T>::value;
+
+
+/// Checks if container/array is contiguous and holds integers that can be written as varints
+template<typename T, typename = void>
+struct is_contiguous_varint_integer : std::false_type {};
+
+template<typename T>
+struct is_contiguous_varint_integer<
+        T,
+        std::enable_if_t<is_contiguous_v<T>>
+> : is_varint_integer<std::remove_const_t<element_type_t<T>>> {};
+template<typename T> inline constexpr bool is_contiguous_varint_integer_v = is_contiguous_varint_integer<T>::value;
+
+
 /// Checks if `std::tuple_size<Type>` can be applyed to object
 /// so it can be atreated as tuple and `std::get` can be applied
 /// zero-element tuples intentonally give false
@@ -184,6 +331,172 @@ struct is_optional<
 > : public std::true_type {};
 template<typename T> inline constexpr bool is_optional_v = is_optional<T>::value;
 
+
+/// Checks if type is a pointer the archive follows to its object: `std::shared_ptr`, `std::weak_ptr`,
+/// `std::unique_ptr` with the default deleter, or a raw pointer. Pointers to arrays, functions and `void` are not
+template<typename T>
+struct is_pointer : std::bool_constant<
+        std::is_pointer_v<T>
+        && std::is_object_v<std::remove_pointer_t<T>>
+        && !std::is_array_v<std::remove_pointer_t<T>>
+> {};
+
+template<typename T>
+struct is_pointer<std::shared_ptr<T>> : std::bool_constant<std::is_object_v<T> && !std::is_array_v<T>> {};
+
+template<typename T>
+struct is_pointer<std::weak_ptr<T>> : std::bool_constant<std::is_object_v<T> && !std::is_array_v<T>> {};
+
+template<typename T>
+struct is_pointer<std::unique_ptr<T>> : std::bool_constant<std::is_object_v<T> && !std::is_array_v<T>> {};
+template<typename T> inline constexpr bool is_pointer_v = is_pointer<std::remove_const_t<T>>::value;
+
+
+/// Checks if storage keeps its data in a single memory block that can be read without copying:
+/// `data()` points to the beginning of the block, `read_position()` is an offset of the next read
+/// and `advance(size_t)` moves it forward
+template<typename Storage, typename = void>
+struct is_contiguous_storage : std::false_type {};
+
+template<typename Storage>
+struct is_contiguous_storage<
+        Storage,
+        std::void_t<
+            decltype(static_cast<const unsigned char*>(std::declval<Storage&>().data())),
+            decltype(static_cast<size_t>(std::declval<Storage&>().read_position())),
+            decltype(std::declval<Storage&>().advance(size_t{}))
+        >
+> : public std::true_type {};
+template<typename T> inline constexpr bool is_contiguous_storage_v = is_contiguous_storage<T>::value;
+
+/// Checks if storage can move its read position forward without reading: `advance(size_t)`.
+/// Storages without it are read into a scratch buffer when bytes are skipped
+template<typename Storage, typename = void>
+struct has_advance : std::false_type {};
+
+template<typename Storage>
+struct has_advance<Storage, std::void_t<decltype(std::declval<Storage&>().advance(size_t{}))>> : std::true_type {};
+template<typename T> inline constexpr bool has_advance_v = has_advance<T>::value;
+
+/// Checks if storage buffers writes that are pushed to the sink by `flush()`
+template<typename Storage, typename = void>
+struct has_flush : std::false_type {};
+
+template<typename Storage>
+struct has_flush<Storage, std::void_t<decltype(std::declval<Storage&>().flush())>> : std::true_type {};
+template<typename T> inline constexpr bool has_flush_v = has_flush<T>::value;
+
+/// Checks if storage holds a resource released by `close()`
+template<typename Storage, typename = void>
+struct has_close : std::false_type {};
+
+template<typename Storage>
+struct has_close<Storage, std::void_t<decltype(std::declval<Storage&>().close())>> : std::true_type {};
+template<typename T> inline constexpr bool has_close_v = has_close<T>::value;
+
+/// Checks if storage may keep pointers to memory passed to `write` until `flush()` instead of copying it,
+/// declared as `static constexpr bool references_writes = true` (e.g. `GatherWriter`).
+/// Writers that reuse a buffer after handing it to such a storage flush the storage first
+template<typename Storage, typename = void>
+struct references_writes : std::false_type {};
+
+template<typename Storage>
+struct references_writes<Storage, std::void_t<decltype(Storage::references_writes)>> : std::bool_constant<Storage::references_writes> {};
+template<typename T> inline constexpr bool references_writes_v = references_writes<T>::value;
+
+
+/// Checks if object bytes in memory are exactly its field-wise encoding, so it can be written
+/// and read as a single block: primitives, and `std::pair`, `std::tuple` and `std::array`
+/// of such types without padding. Specialize it as `std::true_type` to opt-in a user type:
+/// it must have no padding and its `serialize_object`/`stream_serialization` must write
+/// fields in declaration order. Trivially copyable types are copied as single blocks,
+/// `std::pair` and `std::tuple` are gathered field by field into chunks (see `BinaryArchive::is_gathered_v`)
+template<typename T, typename = void>
+struct is_trivially_serializable : is_primitive<T> {};
+
+template<typename T, size_t N>
+struct is_trivially_serializable<std::array<T, N>> : std::bool_constant<
+        (N > 0) && is_trivially_serializable<T>::value
+> {};
+
+template<typename First, typename Second>
+struct is_trivially_serializable<std::pair<First, Second>> : std::bool_constant<
+        is_trivially_serializable<First>::value
+        && is_trivially_serializable<Second>::value
+        && sizeof(std::pair<First, Second>) == sizeof(First) + sizeof(Second)
+> {};
+
+template<typename... Types>
+struct is_trivially_serializable<std::tuple<Types...>> : std::bool_constant<
+        (sizeof...(Types) > 0)
+        && (is_trivially_serializable<Types>::value && ...)
+        && sizeof(std::tuple<Types...>) == (sizeof(Types) + ... + 0)
+> {};
+template<typename T> inline constexpr bool is_trivially_serializable_v = is_trivially_serializable<T>::value;
+
+
+/// Checks if container/array is contiguous and holds trivially serializable types
+template<typename T, typename = void>
+struct is_contiguous_trivially_serializable : std::false_type {};
+
+template<typename T>
+struct is_contiguous_trivially_serializable<
+        T,
+        std::enable_if_t<is_contiguous_v<T>>
+> : is_trivially_serializable<std::remove_const_t<element_type_t<T>>> {};
+template<typename T> inline constexpr bool is_contiguous_trivially_serializable_v = is_contiguous_trivially_serializable<T>::value;
+
+
+/// Number of bytes a type takes when serialized, if it is known at compile time:
+/// primitives, empty types, trivially serializable types and tuple-like types (pairs, tuples, std::array) made of them
+template<typename T, typename = void>
+struct static_size {
+    static constexpr bool known = false;
+    static constexpr size_t value = 0;
+};
+
+template<typename Tuple, size_t... I>
+constexpr bool tuple_static_size_known(std::index_sequence<I...>) {
+    return (static_size<std::remove_cv_t<std::tuple_element_t<I, Tuple>>>::known && ...);
+}
+
+template<typename Tuple, size_t... I>
+constexpr size_t tuple_static_size(std::index_sequence<I...>) {
+    return (static_size<std::remove_cv_t<std::tuple_element_t<I, Tuple>>>::value + ... + 0);
+}
+
+template<typename T>
+struct static_size<T, std::enable_if_t<is_primitive_v<T>>> {
+    static constexpr bool known = true;
+    static constexpr size_t value = sizeof(T);
+};
+
+template<typename T>
+struct static_size<T, std::enable_if_t<std::is_empty_v<T> && !is_tuple_like_v<T>>> {
+    static constexpr bool known = true;
+    static constexpr size_t value = 0;
+};
+
+template<typename T>
+struct static_size<T, std::enable_if_t<is_tuple_like_v<T> && !is_primitive_v<T>>> {
+    static constexpr bool known = tuple_static_size_known<T>(std::make_index_sequence<std::tuple_size<T>::value>{});
+    static constexpr size_t value = known ? tuple_static_size<T>(std::make_index_sequence<std::tuple_size<T>::value>{}) : 0;
+};
+template<typename T>
+struct static_size<T, std::enable_if_t<
+        is_trivially_serializable_v<T> && !is_primitive_v<T> && !is_tuple_like_v<T> && !std::is_empty_v<T>
+>> {
+    static constexpr bool known = true;
+    static constexpr size_t value = sizeof(T);
+};
+template<typename T> inline constexpr bool has_static_size_v = static_size<T>::known;
+
+/// Execution policies accepted by `BinaryArchive::serialize(container, policy)`,
+/// specialized by the headers that define them (see `archive_parallel.h`)
+template<typename T>
+struct is_execution_policy : std::false_type {};
+template<typename T> inline constexpr bool is_execution_policy_v = is_execution_policy<T>::value;
+
 } // namespace traits
 
 
@@ -193,7 +506,29 @@ namespace archive {
 /// as it has different sizeof in different architectures
 using usize = std::uint64_t;
 
+/// Tag of the constructor-from-archive hook. Types with a constructor
+///    template<typename Archive> T(archive::from_archive_t, Archive& archive);
+/// are decoded by that constructor wherever the archive creates a new object: container elements,
+/// optionals and `deserialize<T>()`. Such types need no default constructor
+struct from_archive_t {
+    explicit from_archive_t() = default;
+};
+inline constexpr from_archive_t from_archive {};
+
 namespace details {
+/// Checks if `T` opts into construction from `Archive`, see `from_archive_t`
+template<typename T, typename Archive>
+inline constexpr bool is_archive_constructible_v = std::is_constructible_v<T, from_archive_t, Archive&>;
+
+/// Checks if `T` is a specialization of class template `Template` with type parameters
+template<typename T, template<typename...> class Template>
+struct is_instance_of : std::false_type {};
+
+template<template<typename...> class Template, typename... Args>
+struct is_instance_of<Template<Args...>, Template> : std::true_type {};
+template<typename T, template<typename...> class Template>
+inline constexpr bool is_instance_of_v = is_instance_of<T, Template>::value;
+
 /// Generalized `insert(Container, Type)` function to handle all possible differences
 /// with STL collection interfaces
 template<typename Container, typename T>
@@ -212,6 +547,34 @@ std::enable_if_t<traits::has_insert_after_v<Container>> insert(Container& contai
 }
 
 
+/// Generalized in-place construction at the end of a container. Ordered containers get the end as a hint,
+/// which is amortized O(1) for elements arriving in order, as the archive writes them
+template<typename Container, typename... Args>
+void emplace(Container& container, Args&&... args) {
+    if constexpr (traits::has_emplace_back_v<Container>) {
+        container.emplace_back(std::forward<Args>(args)...);
+    } else if constexpr (traits::has_emplace_hint_v<Container>) {
+        container.emplace_hint(container.end(), std::forward<Args>(args)...);
+    } else if constexpr (traits::has_insert_after_v<Container>) {
+        container.emplace_after(container.before_begin(), std::forward<Args>(args)...);
+    } else {
+        insert(container, typename Container::value_type(std::forward<Args>(args)...));
+    }
+}
+
+
+/// Checks if `emplace_back()` default-constructs an element and returns a reference to it
+template<typename Container, typename = void>
+struct emplaces_default_element : std::false_type {};
+
+template<typename Container>
+struct emplaces_default_element<Container, std::void_t<decltype(std::declval<Container&>().emplace_back())>>
+    : std::bool_constant<std::is_default_constructible_v<typename Container::value_type>
+                         && std::is_same_v<decltype(std::declval<Container&>().emplace_back()), typename Container::value_type&>> {};
+template<typename Container>
+inline constexpr bool emplaces_default_element_v = emplaces_default_element<Container>::value;
+
+
 /// Generalized `reserve(Container, size_t)` function to either reserve elements
 /// or do nothing if given container cannot reserve space for elements
 template<typename Container>
@@ -276,143 +639,2112 @@ constexpr void for_each_tuple_element(Tuple&& t, Function&& f) {
     (void)(f);
 }
 
-} // namespace details
-
 
-/// Storage policies for Archive
-namespace storage_policy {
+/// Constructor arguments for uses-allocator construction of `T` with `alloc`
+template<typename T, typename Alloc>
+auto uses_allocator_arguments(const Alloc& alloc) {
+    if constexpr (std::uses_allocator_v<T, Alloc> && std::is_constructible_v<T, std::allocator_arg_t, const Alloc&>) {
+        return std::tuple<std::allocator_arg_t, const Alloc&>(std::allocator_arg, alloc);
+    } else if constexpr (std::uses_allocator_v<T, Alloc> && std::is_constructible_v<T, const Alloc&>) {
+        return std::tuple<const Alloc&>(alloc);
+    } else {
+        (void)(alloc);
+        return std::tuple<>();
+    }
+}
 
-template<typename Storage>
-struct Parent : public Storage {
-    Storage& get_storage() { return *static_cast<Storage*>(this);}
-};
+/// Default-constructs `T` passing it `alloc` if `T` is allocator-aware.
+/// Pairs pass allocator to both members (`std::make_obj_using_allocator` from C++20)
+template<typename T, typename Alloc>
+T make_using_allocator(const Alloc& alloc) {
+    if constexpr (traits::is_pair_v<T>) {
+        return T(std::piecewise_construct,
+                 uses_allocator_arguments<typename T::first_type>(alloc),
+                 uses_allocator_arguments<typename T::second_type>(alloc));
+    } else {
+        return std::make_from_tuple<T>(uses_allocator_arguments<T>(alloc));
+    }
+}
 
-template<typename Storage>
-struct Inline {
-    Storage storage {};
-    Storage& get_storage() { return storage;}
-};
 
-template<typename Storage>
-struct NotOwningPointer {
-    NotOwningPointer(Storage* storage_)
-        : storage(storage_)
-    {}
+/// Default-constructs `T` with `resource` if it is set and `T` is allocator-aware
+template<typename T>
+T make_value(std::pmr::memory_resource* resource) {
+    if constexpr (std::uses_allocator_v<T, std::pmr::polymorphic_allocator<std::byte>> || traits::is_pair_v<T>) {
+        if (resource) {
+            return make_using_allocator<T>(std::pmr::polymorphic_allocator<std::byte>(resource));
+        }
+    }
+    return T();
+}
 
-    Storage* storage;
-    Storage& get_storage() { return *storage;}
-};
+/// Default-constructs an element of `container` propagating container allocator into it,
+/// elements of other containers get `resource`
+template<typename T, typename Container>
+T make_element(Container& container, std::pmr::memory_resource* resource) {
+    if constexpr (traits::has_get_allocator_v<Container>) {
+        if constexpr (std::uses_allocator_v<T, decltype(container.get_allocator())> || traits::is_pair_v<T>) {
+            return make_using_allocator<T>(container.get_allocator());
+        }
+    }
+    return make_value<T>(resource);
+}
 
-} // namespace storage_policy
+/// Checks if object bytes are laid out in encoding order. The memory order of tuple-like elements is
+/// unspecified (libstdc++ and MSVC store `std::tuple` elements in reverse), except for `std::array`
+template<typename T>
+struct has_block_layout : std::bool_constant<!traits::is_tuple_like_v<T> || traits::is_primitive_v<T>> {};
 
+template<typename T, size_t N>
+struct has_block_layout<std::array<T, N>> : has_block_layout<T> {};
 
-// TODO: contiguous primitive data deserialize optimization
-///
-// TODO: add endianness to read/wtite functions
-///
-// TODO:? add template overloads: `const auto v = a.deserialize<Type>()`
-///
-// TODO:? move all members to archive ns and rename as *_object, leave only template<T> members
-// calling *_object template, so that latter will be found via ADL.
-// this will enable behavoiur specializations for specific types
-/// BinaryArchive with `serialize(const T& t)` / `deserialize(T& t)` API
-/// to make custom type serializable add pair of functions:
-///    serialize_object(T object, BinaryArchive&);
-///    deserialize_object(T object, BinaryArchive&);
-template<typename Storage, template<typename S>class StoragePolicy = storage_policy::Parent>
-struct BinaryArchive : public StoragePolicy<Storage> {
-    using StoragePolicy<Storage>::get_storage;
+template<typename T, size_t... I>
+constexpr bool has_copyable_elements(std::index_sequence<I...>);
 
-    template<typename... Args>
-    BinaryArchive(Args... args)
-        : StoragePolicy<Storage> (std::forward<Args>(args)...)
-    {}
+/// Checks if a trivially serializable object can be copied field by field with `memcpy`:
+/// tuple-like objects are split into their elements, everything else must be trivially copyable
+template<typename T>
+constexpr bool has_copyable_fields() {
+    if constexpr (traits::is_tuple_like_v<T> && !traits::is_primitive_v<T>) {
+        return has_copyable_elements<T>(std::make_index_sequence<std::tuple_size<T>::value>{});
+    } else {
+        return std::is_trivially_copyable_v<T>;
+    }
+}
 
-    /// ===== Serialize =====
+template<typename T, size_t... I>
+constexpr bool has_copyable_elements(std::index_sequence<I...>) {
+    return (has_copyable_fields<std::remove_const_t<std::tuple_element_t<I, T>>>() && ...);
+}
 
-    template<typename Empty>
-    std::enable_if_t<std::is_empty_v<Empty>, usize> serialize(Empty) {
-        return 0;
+/// Copies the fields of a trivially serializable object to `out` one after another in encoding order
+template<typename T>
+void store_fields(const T& object, unsigned char* out) {
+    if constexpr (traits::is_tuple_like_v<T> && !(has_block_layout<T>::value && std::is_trivially_copyable_v<T>)) {
+        size_t offset = 0;
+        for_each_tuple_element<0, std::tuple_size<T>::value>(object, [&offset, out] (const auto& element) {
+            store_fields(element, out + offset);
+            offset += sizeof(element);
+        });
+    } else {
+        std::memcpy(out, &object, sizeof(T));
     }
+}
 
-    template<typename Primitive>
-    std::enable_if_t<traits::is_primitive_v<Primitive>, usize> serialize(const Primitive primitive) {
-        return get_storage().write(reinterpret_cast<const unsigned char*>(&primitive), sizeof(Primitive));
+/// Reverse of `store_fields`
+template<typename T>
+void load_fields(T& object, const unsigned char* in) {
+    if constexpr (traits::is_tuple_like_v<T> && !(has_block_layout<T>::value && std::is_trivially_copyable_v<T>)) {
+        size_t offset = 0;
+        for_each_tuple_element<0, std::tuple_size<T>::value>(object, [&offset, in] (auto& element) {
+            load_fields(element, in + offset);
+            offset += sizeof(element);
+        });
+    } else {
+        std::memcpy(&object, in, sizeof(T));
     }
+}
 
-    template<typename Container>
-    std::enable_if_t<traits::is_container_v<Container> || std::is_array<Container>::value, usize> serialize(const Container& container) {
-        const size_t length = std::size(container);
-        serialize<usize>(length);
-        for (auto&& e: container) {
-            serialize(e);
+
+/// Number of trailing zero bits, `value` must not be zero
+inline unsigned count_trailing_zeros(std::uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    _BitScanForward64(&index, value);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctzll(value));
+#endif
+}
+
+/// Number of significant bits, 0 for 0
+inline unsigned bit_width(std::uint64_t value) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index = 0;
+    return _BitScanReverse64(&index, value) ? static_cast<unsigned>(index) + 1 : 0;
+#else
+    return value ? 64 - static_cast<unsigned>(__builtin_clzll(value)) : 0;
+#endif
+}
+
+/// Host byte order
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+inline constexpr bool host_is_little_endian = false;
+#else
+inline constexpr bool host_is_little_endian = true;
+#endif
+
+/// Loads 8 bytes as a little-endian number regardless of host byte order
+inline std::uint64_t load_little_u64(const unsigned char* data) {
+    std::uint64_t value = 0;
+    if constexpr (host_is_little_endian) {
+        std::memcpy(&value, data, sizeof(value));
+    } else {
+        for (unsigned i = 0; i < 8; ++i) {
+            value |= std::uint64_t(data[i]) << (8 * i);
         }
-        return sizeof(usize) + length * sizeof(traits::element_type_t<Container>);
     }
+    return value;
+}
 
-    template<typename Gettable>
-    std::enable_if_t<
-            traits::is_tuple_like_v<Gettable>
-            && !traits::is_primitive_v<Gettable>
-    , usize> serialize(const Gettable& object) {
-        constexpr size_t N = std::tuple_size<Gettable>::value;
-        usize size = 0;
-        details::for_each_tuple_element<0, N>(object, [&size, this] (auto&& element) {
-            size += this->serialize(element);
-        });
-        return size;
+
+/// Instruction set extensions available at runtime, detected once
+struct CpuFeatures {
+    bool sse2 = false;
+    bool ssse3 = false;
+    bool sse42 = false;
+    bool avx2 = false;
+};
+
+inline const CpuFeatures& cpu_features() {
+    static const CpuFeatures features = [] {
+        CpuFeatures result;
+#if defined(ARCHIVE_X86) && (defined(__GNUC__) || defined(__clang__))
+        __builtin_cpu_init();
+        result.sse2 = __builtin_cpu_supports("sse2");
+        result.ssse3 = __builtin_cpu_supports("ssse3");
+        result.sse42 = __builtin_cpu_supports("sse4.2");
+        result.avx2 = __builtin_cpu_supports("avx2");
+#elif defined(ARCHIVE_X86) && defined(_MSC_VER)
+        int info[4] = {};
+        __cpuid(info, 1);
+        result.sse2 = (info[3] & (1 << 26)) != 0;
+        result.ssse3 = (info[2] & (1 << 9)) != 0;
+        result.sse42 = (info[2] & (1 << 20)) != 0;
+        const bool os_saves_ymm = (info[2] & (1 << 27)) && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        result.avx2 = os_saves_ymm && (info[1] & (1 << 5)) != 0;
+#endif
+        return result;
+    }();
+    return features;
+}
+
+
+/// Reverses byte order of a single primitive
+template<typename Primitive>
+Primitive byteswap(Primitive value) {
+    unsigned char bytes[sizeof(Primitive)];
+    std::memcpy(bytes, &value, sizeof(Primitive));
+    if constexpr (sizeof(Primitive) == 2) {
+        std::uint16_t v;
+        std::memcpy(&v, bytes, 2);
+        v = static_cast<std::uint16_t>((v >> 8) | (v << 8));
+        std::memcpy(bytes, &v, 2);
+    } else if constexpr (sizeof(Primitive) == 4) {
+        std::uint32_t v;
+        std::memcpy(&v, bytes, 4);
+#if defined(_MSC_VER) && !defined(__clang__)
+        v = _byteswap_ulong(v);
+#else
+        v = __builtin_bswap32(v);
+#endif
+        std::memcpy(bytes, &v, 4);
+    } else if constexpr (sizeof(Primitive) == 8) {
+        std::uint64_t v;
+        std::memcpy(&v, bytes, 8);
+#if defined(_MSC_VER) && !defined(__clang__)
+        v = _byteswap_uint64(v);
+#else
+        v = __builtin_bswap64(v);
+#endif
+        std::memcpy(bytes, &v, 8);
+    } else {
+        std::reverse(bytes, bytes + sizeof(Primitive));
     }
+    std::memcpy(&value, bytes, sizeof(Primitive));
+    return value;
+}
 
-    template<typename Serializable>
-    std::enable_if_t<details::external_serialize_exists_v<Serializable, BinaryArchive<Storage, StoragePolicy>>, usize> serialize(const Serializable& object) {
-        return serialize_object(object, *this);
+/// `pshufb` masks reversing every 2/4/8-byte lane of a 16-byte register
+template<size_t Size>
+inline const unsigned char* byteswap_shuffle_mask() {
+    alignas(16) static const unsigned char masks[3][16] = {
+        {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14},
+        {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12},
+        {7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8},
+    };
+    return masks[Size == 2 ? 0 : Size == 4 ? 1 : 2];
+}
+
+#if defined(ARCHIVE_X86)
+/// Swaps as many whole 32-byte blocks as fit in `bytes`, returns number of processed bytes
+ARCHIVE_TARGET("avx2")
+inline size_t byteswap_avx2(unsigned char* dst, const unsigned char* src, size_t bytes, const unsigned char* mask_bytes) {
+    const __m256i mask = _mm256_broadcastsi128_si256(_mm_load_si128(reinterpret_cast<const __m128i*>(mask_bytes)));
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_shuffle_epi8(v, mask));
     }
+    return i;
+}
 
-    template<typename Optional>
-    std::enable_if_t<traits::is_optional_v<Optional>, usize> serialize(const Optional& optional) {
-        usize size = serialize(optional.has_value());
-        if (optional.has_value()) {
-            size += serialize(*optional);
+/// Swaps as many whole 16-byte blocks as fit in `bytes`, returns number of processed bytes
+ARCHIVE_TARGET("ssse3")
+inline size_t byteswap_ssse3(unsigned char* dst, const unsigned char* src, size_t bytes, const unsigned char* mask_bytes) {
+    const __m128i mask = _mm_load_si128(reinterpret_cast<const __m128i*>(mask_bytes));
+    size_t i = 0;
+    for (; i + 16 <= bytes; i += 16) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, mask));
+    }
+    return i;
+}
+#endif
+
+/// Copies `count` elements of `Size` bytes from `src` to `dst` reversing byte order of each one.
+/// `dst` may be equal to `src` to swap in place. 2/4/8-byte elements use AVX2/SSSE3
+/// shuffles when the CPU supports them
+template<size_t Size>
+void byteswap_elements(unsigned char* dst, const unsigned char* src, size_t count) {
+    const size_t bytes = count * Size;
+    size_t done = 0;
+    if constexpr (Size == 1) {
+        if (dst != src) {
+            std::memmove(dst, src, bytes);
         }
-        return size;
+        return;
+    }
+#if defined(ARCHIVE_X86)
+    if constexpr (Size == 2 || Size == 4 || Size == 8) {
+        const CpuFeatures& cpu = cpu_features();
+        if (cpu.avx2) {
+            done = byteswap_avx2(dst, src, bytes, byteswap_shuffle_mask<Size>());
+        }
+        if (cpu.ssse3) {
+            done += byteswap_ssse3(dst + done, src + done, bytes - done, byteswap_shuffle_mask<Size>());
+        }
+    }
+#endif
+    for (; done < bytes; done += Size) {
+        unsigned char element[Size];
+        std::memcpy(element, src + done, Size);
+        std::reverse(element, element + Size);
+        std::memcpy(dst + done, element, Size);
     }
+}
 
-    /// ===== Deserialize =====
 
-    template<typename Empty>
-    std::enable_if_t<std::is_empty_v<Empty>> deserialize(Empty&) {}
+/// ===== Bit packing =====
 
-    template<typename Primitive>
-    std::enable_if_t<traits::is_primitive_v<Primitive>> deserialize(Primitive& primitive) {
-        get_storage().read(reinterpret_cast<unsigned char*>(&primitive), sizeof(Primitive));
+/// Values per bit-packed block: 8 interleaved lanes of 32 values
+inline constexpr size_t packed_block_size = 256;
+inline constexpr size_t packed_lanes = 8;
+
+inline std::uint32_t load_little_u32(const unsigned char* data) {
+    return std::uint32_t(data[0]) | std::uint32_t(data[1]) << 8 | std::uint32_t(data[2]) << 16 | std::uint32_t(data[3]) << 24;
+}
+
+inline void store_little_u32(unsigned char* out, std::uint32_t value) {
+    for (unsigned i = 0; i < 4; ++i) {
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
     }
+}
 
-    template<typename Container>
-    std::enable_if_t<traits::is_container_v<Container>> deserialize(Container& container) {
-        usize size = 0;
-        deserialize(size);
-        details::reserve_silent(container, static_cast<size_t>(size));
+/// Native-order value at `data`, which may hold an integer of another type of the same width
+template<typename Unsigned>
+Unsigned load_native(const unsigned char* data) {
+    Unsigned value;
+    std::memcpy(&value, data, sizeof(Unsigned));
+    return value;
+}
+
+template<typename Unsigned>
+void store_native(unsigned char* out, Unsigned value) {
+    std::memcpy(out, &value, sizeof(Unsigned));
+}
 
-        for (size_t i = 0; i < size; ++i) {
-            traits::remove_const_element_type_t<Container> e;
-            deserialize(e);
-            details::insert(container, std::move(e));
+/// Block kernels pack 256 values of `Bits` bits into `Bits * 32` bytes and back. Value `i` goes to
+/// lane `i % 8`, each lane is a bit stream of little-endian 32-bit words starting from the low bits,
+/// and word `w` of lane `l` is stored at byte `(w * 8 + l) * 4`. A row of 8 consecutive values is
+/// therefore one AVX2 register or two SSE2 ones, and every kernel produces the same bytes.
+/// Unpacked values are native 32-bit words passed as bytes and accessed with `memcpy` or unaligned
+/// SIMD loads, so callers can hand over buffers of any integer type of that width
+struct BitPackScalar {
+    template<unsigned Bits>
+    static void pack(const unsigned char* in, unsigned char* out) {
+        for (size_t lane = 0; lane < packed_lanes; ++lane) {
+            std::uint64_t pending = 0;
+            unsigned filled = 0;
+            size_t word = 0;
+            for (size_t row = 0; row < packed_block_size / packed_lanes; ++row) {
+                pending |= std::uint64_t(load_native<std::uint32_t>(in + (row * packed_lanes + lane) * 4)) << filled;
+                filled += Bits;
+                if (filled >= 32) {
+                    store_little_u32(out + (word++ * packed_lanes + lane) * 4, static_cast<std::uint32_t>(pending));
+                    pending >>= 32;
+                    filled -= 32;
+                }
+            }
         }
     }
 
-    template<typename Gettable>
-    std::enable_if_t<
-            traits::is_tuple_like_v<Gettable>
-            && !traits::is_primitive_v<Gettable>
-    > deserialize(Gettable& object) {
-        details::for_each_tuple_element<0, std::tuple_size<Gettable>::value>(object, [this] (auto&& element) {
-            this->deserialize(element);
+    template<unsigned Bits>
+    static void unpack(const unsigned char* in, unsigned char* out) {
+        constexpr std::uint64_t mask = (std::uint64_t(1) << Bits) - 1;
+        for (size_t lane = 0; lane < packed_lanes; ++lane) {
+            std::uint64_t pending = 0;
+            unsigned available = 0;
+            size_t word = 0;
+            for (size_t row = 0; row < packed_block_size / packed_lanes; ++row) {
+                if (available < Bits) {
+                    pending |= std::uint64_t(load_little_u32(in + (word++ * packed_lanes + lane) * 4)) << available;
+                    available += 32;
+                }
+                store_native(out + (row * packed_lanes + lane) * 4, static_cast<std::uint32_t>(pending & mask));
+                pending >>= Bits;
+                available -= Bits;
+            }
+        }
+    }
+
+    /// Replaces `count` zigzag encoded differences at `values` with the running sum starting from `previous`,
+    /// returns the last sum
+    template<typename Unsigned>
+    static Unsigned delta_decode(unsigned char* values, size_t count, Unsigned previous) {
+        for (size_t i = 0; i < count; ++i) {
+            const Unsigned value = load_native<Unsigned>(values + i * sizeof(Unsigned));
+            previous += static_cast<Unsigned>((value >> 1) ^ (Unsigned(0) - (value & 1)));
+            store_native(values + i * sizeof(Unsigned), previous);
+        }
+        return previous;
+    }
+};
+
+#if defined(ARCHIVE_X86)
+/// Rows are unrolled with the bit offsets known at compile time, so each one is a couple of shifts
+struct BitPackSse2 {
+    template<unsigned Bits>
+    ARCHIVE_TARGET("sse2")
+    static void pack(const unsigned char* in, unsigned char* out) {
+        if constexpr (Bits > 0) {
+            __m128i low = _mm_setzero_si128();
+            __m128i high = _mm_setzero_si128();
+            pack_rows<Bits>(in, out, low, high, std::make_index_sequence<packed_block_size / packed_lanes>{});
+        }
+    }
+
+    template<unsigned Bits>
+    ARCHIVE_TARGET("sse2")
+    static void unpack(const unsigned char* in, unsigned char* out) {
+        if constexpr (Bits == 0) {
+            std::memset(out, 0, packed_block_size * sizeof(std::uint32_t));
+        } else {
+            unpack_rows<Bits>(in, out, std::make_index_sequence<packed_block_size / packed_lanes>{});
+        }
+    }
+
+private:
+    template<unsigned Bits, size_t... Rows>
+    ARCHIVE_TARGET("sse2")
+    static void pack_rows(const unsigned char* in, unsigned char* out, __m128i& low, __m128i& high, std::index_sequence<Rows...>) {
+        (pack_row<Bits, Rows>(in, out, low, high), ...);
+    }
+
+    template<unsigned Bits, size_t Row>
+    ARCHIVE_TARGET("sse2")
+    static void pack_row(const unsigned char* in, unsigned char* out, __m128i& low, __m128i& high) {
+        constexpr unsigned shift = Row * Bits % 32;
+        constexpr size_t word = Row * Bits / 32;
+        const __m128i value_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + Row * 32));
+        const __m128i value_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + Row * 32 + 16));
+        if constexpr (shift == 0) {
+            low = value_low;
+            high = value_high;
+        } else {
+            low = _mm_or_si128(low, _mm_slli_epi32(value_low, shift));
+            high = _mm_or_si128(high, _mm_slli_epi32(value_high, shift));
+        }
+        if constexpr (shift + Bits >= 32) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + word * 32), low);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + word * 32 + 16), high);
+            if constexpr (shift + Bits > 32) {
+                low = _mm_srli_epi32(value_low, 32 - shift);
+                high = _mm_srli_epi32(value_high, 32 - shift);
+            }
+        }
+    }
+
+    template<unsigned Bits, size_t... Rows>
+    ARCHIVE_TARGET("sse2")
+    static void unpack_rows(const unsigned char* in, unsigned char* out, std::index_sequence<Rows...>) {
+        const __m128i mask = _mm_set1_epi32(static_cast<int>((std::uint64_t(1) << Bits) - 1));
+        (unpack_row<Bits, Rows>(in, out, mask), ...);
+    }
+
+    template<unsigned Bits, size_t Row>
+    ARCHIVE_TARGET("sse2")
+    static void unpack_row(const unsigned char* in, unsigned char* out, __m128i mask) {
+        constexpr unsigned shift = Row * Bits % 32;
+        constexpr size_t word = Row * Bits / 32;
+        const auto* words = reinterpret_cast<const __m128i*>(in + word * 32);
+        __m128i low = _mm_srli_epi32(_mm_loadu_si128(words), shift);
+        __m128i high = _mm_srli_epi32(_mm_loadu_si128(words + 1), shift);
+        if constexpr (shift + Bits > 32) {
+            low = _mm_or_si128(low, _mm_slli_epi32(_mm_loadu_si128(words + 2), 32 - shift));
+            high = _mm_or_si128(high, _mm_slli_epi32(_mm_loadu_si128(words + 3), 32 - shift));
+        }
+        if constexpr (Bits < 32) {
+            low = _mm_and_si128(low, mask);
+            high = _mm_and_si128(high, mask);
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + Row * 32), low);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + Row * 32 + 16), high);
+    }
+
+public:
+    /// Prefix sums of 4 values with two shifted adds, the carry is the broadcast last sum
+    ARCHIVE_TARGET("sse2")
+    static std::uint32_t delta_decode(unsigned char* values, size_t count, std::uint32_t previous) {
+        const __m128i one = _mm_set1_epi32(1);
+        __m128i carry = _mm_set1_epi32(static_cast<int>(previous));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i * 4));
+            v = _mm_xor_si128(_mm_srli_epi32(v, 1), _mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(v, one)));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+            v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi32(v, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i * 4), v);
+            carry = _mm_shuffle_epi32(v, 0xff);
+        }
+        return BitPackScalar::delta_decode(values + i * 4, count - i, i > 0 ? load_native<std::uint32_t>(values + (i - 1) * 4) : previous);
+    }
+
+    ARCHIVE_TARGET("sse2")
+    static std::uint64_t delta_decode(unsigned char* values, size_t count, std::uint64_t previous) {
+        const __m128i one = _mm_set1_epi64x(1);
+        __m128i carry = _mm_set1_epi64x(static_cast<long long>(previous));
+        size_t i = 0;
+        for (; i + 2 <= count; i += 2) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i * 8));
+            v = _mm_xor_si128(_mm_srli_epi64(v, 1), _mm_sub_epi64(_mm_setzero_si128(), _mm_and_si128(v, one)));
+            v = _mm_add_epi64(v, _mm_slli_si128(v, 8));
+            v = _mm_add_epi64(v, carry);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(values + i * 8), v);
+            carry = _mm_shuffle_epi32(v, 0xee);
+        }
+        return BitPackScalar::delta_decode(values + i * 8, count - i, i > 0 ? load_native<std::uint64_t>(values + (i - 1) * 8) : previous);
+    }
+};
+
+struct BitPackAvx2 {
+    template<unsigned Bits>
+    ARCHIVE_TARGET("avx2")
+    static void pack(const unsigned char* in, unsigned char* out) {
+        if constexpr (Bits > 0) {
+            __m256i word = _mm256_setzero_si256();
+            pack_rows<Bits>(in, out, word, std::make_index_sequence<packed_block_size / packed_lanes>{});
+        }
+    }
+
+    template<unsigned Bits>
+    ARCHIVE_TARGET("avx2")
+    static void unpack(const unsigned char* in, unsigned char* out) {
+        if constexpr (Bits == 0) {
+            std::memset(out, 0, packed_block_size * sizeof(std::uint32_t));
+        } else {
+            unpack_rows<Bits>(in, out, std::make_index_sequence<packed_block_size / packed_lanes>{});
+        }
+    }
+
+private:
+    template<unsigned Bits, size_t... Rows>
+    ARCHIVE_TARGET("avx2")
+    static void pack_rows(const unsigned char* in, unsigned char* out, __m256i& word, std::index_sequence<Rows...>) {
+        (pack_row<Bits, Rows>(in, out, word), ...);
+    }
+
+    template<unsigned Bits, size_t Row>
+    ARCHIVE_TARGET("avx2")
+    static void pack_row(const unsigned char* in, unsigned char* out, __m256i& word) {
+        constexpr unsigned shift = Row * Bits % 32;
+        constexpr size_t index = Row * Bits / 32;
+        const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + Row * 32));
+        if constexpr (shift == 0) {
+            word = value;
+        } else {
+            word = _mm256_or_si256(word, _mm256_slli_epi32(value, shift));
+        }
+        if constexpr (shift + Bits >= 32) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + index * 32), word);
+            if constexpr (shift + Bits > 32) {
+                word = _mm256_srli_epi32(value, 32 - shift);
+            }
+        }
+    }
+
+    template<unsigned Bits, size_t... Rows>
+    ARCHIVE_TARGET("avx2")
+    static void unpack_rows(const unsigned char* in, unsigned char* out, std::index_sequence<Rows...>) {
+        const __m256i mask = _mm256_set1_epi32(static_cast<int>((std::uint64_t(1) << Bits) - 1));
+        (unpack_row<Bits, Rows>(in, out, mask), ...);
+    }
+
+    template<unsigned Bits, size_t Row>
+    ARCHIVE_TARGET("avx2")
+    static void unpack_row(const unsigned char* in, unsigned char* out, __m256i mask) {
+        constexpr unsigned shift = Row * Bits % 32;
+        constexpr size_t index = Row * Bits / 32;
+        const auto* words = reinterpret_cast<const __m256i*>(in + index * 32);
+        __m256i value = _mm256_srli_epi32(_mm256_loadu_si256(words), shift);
+        if constexpr (shift + Bits > 32) {
+            value = _mm256_or_si256(value, _mm256_slli_epi32(_mm256_loadu_si256(words + 1), 32 - shift));
+        }
+        if constexpr (Bits < 32) {
+            value = _mm256_and_si256(value, mask);
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + Row * 32), value);
+    }
+
+public:
+    /// Prefix sums inside each 128-bit half, then the low half total is added to the high half
+    ARCHIVE_TARGET("avx2")
+    static std::uint32_t delta_decode(unsigned char* values, size_t count, std::uint32_t previous) {
+        const __m256i one = _mm256_set1_epi32(1);
+        const __m256i last = _mm256_set1_epi32(7);
+        __m256i carry = _mm256_set1_epi32(static_cast<int>(previous));
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i * 4));
+            v = _mm256_xor_si256(_mm256_srli_epi32(v, 1), _mm256_sub_epi32(_mm256_setzero_si256(), _mm256_and_si256(v, one)));
+            v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+            v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+            const __m256i low_total = _mm256_shuffle_epi32(v, 0xff);
+            v = _mm256_add_epi32(v, _mm256_permute2x128_si256(low_total, low_total, 0x08));
+            v = _mm256_add_epi32(v, carry);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i * 4), v);
+            carry = _mm256_permutevar8x32_epi32(v, last);
+        }
+        return BitPackScalar::delta_decode(values + i * 4, count - i, i > 0 ? load_native<std::uint32_t>(values + (i - 1) * 4) : previous);
+    }
+
+    ARCHIVE_TARGET("avx2")
+    static std::uint64_t delta_decode(unsigned char* values, size_t count, std::uint64_t previous) {
+        const __m256i one = _mm256_set1_epi64x(1);
+        __m256i carry = _mm256_set1_epi64x(static_cast<long long>(previous));
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i * 8));
+            v = _mm256_xor_si256(_mm256_srli_epi64(v, 1), _mm256_sub_epi64(_mm256_setzero_si256(), _mm256_and_si256(v, one)));
+            v = _mm256_add_epi64(v, _mm256_slli_si256(v, 8));
+            const __m256i low_total = _mm256_permute4x64_epi64(v, 0x55);
+            v = _mm256_add_epi64(v, _mm256_blend_epi32(_mm256_setzero_si256(), low_total, 0xf0));
+            v = _mm256_add_epi64(v, carry);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(values + i * 8), v);
+            carry = _mm256_permute4x64_epi64(v, 0xff);
+        }
+        return BitPackScalar::delta_decode(values + i * 8, count - i, i > 0 ? load_native<std::uint64_t>(values + (i - 1) * 8) : previous);
+    }
+};
+#endif
+
+/// Block kernels for every bit width from 0 to 32 and delta decoders of 32 and 64-bit values
+struct BitPackKernels {
+    using Pack = void (*)(const unsigned char*, unsigned char*);
+    using Unpack = void (*)(const unsigned char*, unsigned char*);
+    using DeltaDecode32 = std::uint32_t (*)(unsigned char*, size_t, std::uint32_t);
+    using DeltaDecode64 = std::uint64_t (*)(unsigned char*, size_t, std::uint64_t);
+
+    Pack pack[33];
+    Unpack unpack[33];
+    DeltaDecode32 delta_decode32;
+    DeltaDecode64 delta_decode64;
+};
+
+template<typename Kernel, size_t... Bits>
+BitPackKernels make_bit_pack_kernels(std::index_sequence<Bits...>) {
+    return {
+        {&Kernel::template pack<Bits>...},
+        {&Kernel::template unpack<Bits>...},
+        static_cast<BitPackKernels::DeltaDecode32>(&Kernel::delta_decode),
+        static_cast<BitPackKernels::DeltaDecode64>(&Kernel::delta_decode),
+    };
+}
+
+/// The widest kernel set the CPU supports, selected once
+inline const BitPackKernels& bit_pack_kernels() {
+    static const BitPackKernels kernels = [] {
+#if defined(ARCHIVE_X86)
+        if (cpu_features().avx2) {
+            return make_bit_pack_kernels<BitPackAvx2>(std::make_index_sequence<33>{});
+        }
+        if (cpu_features().sse2) {
+            return make_bit_pack_kernels<BitPackSse2>(std::make_index_sequence<33>{});
+        }
+#endif
+        return make_bit_pack_kernels<BitPackScalar>(std::make_index_sequence<33>{});
+    }();
+    return kernels;
+}
+
+/// Bytes taken by `count` values of `bits` bits: full blocks in the lane layout, a shorter tail as a plain bit stream
+inline size_t packed_bytes(size_t count, unsigned bits) {
+    return count == packed_block_size ? bits * packed_block_size / 8 : (count * bits + 7) / 8;
+}
+
+/// Writes `count` values of `bits` bits (up to 64) as one little-endian bit stream, used for the last block.
+/// `out` must hold `packed_bytes(count, bits)` zeroed bytes plus 8
+inline void pack_bits(const std::uint64_t* values, size_t count, unsigned bits, unsigned char* out) {
+    for (size_t i = 0; i < count; ++i) {
+        const size_t bit = i * bits;
+        const unsigned shift = bit % 8;
+        unsigned char* data = out + bit / 8;
+        const std::uint64_t low = values[i] << shift;
+        for (unsigned b = 0; b < 8; ++b) {
+            data[b] |= static_cast<unsigned char>(low >> (8 * b));
+        }
+        if (shift + bits > 64) {
+            data[8] |= static_cast<unsigned char>(values[i] >> (64 - shift));
+        }
+    }
+}
+
+/// Reads values written by `pack_bits`, `in` must be readable for `packed_bytes(count, bits)` plus 8 bytes
+inline void unpack_bits(const unsigned char* in, size_t count, unsigned bits, std::uint64_t* out) {
+    const std::uint64_t mask = bits < 64 ? (std::uint64_t(1) << bits) - 1 : ~std::uint64_t(0);
+    for (size_t i = 0; i < count; ++i) {
+        const size_t bit = i * bits;
+        const unsigned shift = bit % 8;
+        const unsigned char* data = in + bit / 8;
+        std::uint64_t value = load_little_u64(data) >> shift;
+        if (shift + bits > 64) {
+            value |= std::uint64_t(data[8]) << (64 - shift);
+        }
+        out[i] = value & mask;
+    }
+}
+
+/// Order-preserving map of integers to unsigned ones: the sign bit of signed values is flipped
+template<typename Integer>
+std::make_unsigned_t<Integer> to_ordered(Integer value) {
+    using Unsigned = std::make_unsigned_t<Integer>;
+    if constexpr (std::is_signed_v<Integer>) {
+        return static_cast<Unsigned>(static_cast<Unsigned>(value) ^ (Unsigned(1) << (8 * sizeof(Integer) - 1)));
+    } else {
+        return value;
+    }
+}
+
+template<typename Integer>
+Integer from_ordered(std::make_unsigned_t<Integer> value) {
+    return static_cast<Integer>(to_ordered(static_cast<Integer>(value)));
+}
+
+/// Zigzag encoding of a wrapping difference, so that small steps in both directions stay small
+template<typename Unsigned>
+Unsigned to_zigzag(Unsigned delta) {
+    constexpr unsigned top = 8 * sizeof(Unsigned) - 1;
+    return static_cast<Unsigned>(static_cast<Unsigned>(delta << 1) ^ static_cast<Unsigned>(0 - static_cast<Unsigned>(delta >> top)));
+}
+
+template<typename Unsigned>
+Unsigned from_zigzag(Unsigned value) {
+    return static_cast<Unsigned>(static_cast<Unsigned>(value >> 1) ^ static_cast<Unsigned>(0 - static_cast<Unsigned>(value & 1)));
+}
+
+
+/// LEB128 varint can take up to 10 bytes for a 64-bit value
+inline constexpr size_t max_varint_size = 10;
+
+/// Size of stack chunks used to encode/decode runs of varints and byte-swapped arrays
+inline constexpr size_t chunk_size = 4096;
+
+inline size_t varint_size(std::uint64_t value) {
+    return (bit_width(value | 1) + 6) / 7;
+}
+
+/// Writes `value` as LEB128 into `out`, returns number of bytes written
+inline size_t encode_varint(std::uint64_t value, unsigned char* out) {
+    size_t size = 0;
+    while (value >= 0x80) {
+        out[size++] = static_cast<unsigned char>(value | 0x80);
+        value >>= 7;
+    }
+    out[size++] = static_cast<unsigned char>(value);
+    return size;
+}
+
+/// Reads single LEB128 value starting at `data`, returns pointer past its last byte
+inline const unsigned char* decode_varint(const unsigned char* data, std::uint64_t& value) {
+    std::uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        const unsigned char byte = *data++;
+        result |= std::uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            break;
+        }
+    }
+    value = result;
+    return data;
+}
+
+/// Reads single LEB128 value from [data, end), a value cut by `end` (malformed input) stops there
+inline const unsigned char* decode_varint(const unsigned char* data, const unsigned char* end, std::uint64_t& value) {
+    std::uint64_t result = 0;
+    for (unsigned shift = 0; shift < 64 && data < end; shift += 7) {
+        const unsigned char byte = *data++;
+        result |= std::uint64_t(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            value = result;
+            return data;
+        }
+    }
+    ARCHIVE_ASSERT(false);
+    value = result;
+    return data;
+}
+
+/// Maps integer to unsigned varint payload: signed values are zigzag encoded
+/// so that small negative numbers stay small
+template<typename Integer>
+std::uint64_t to_varint(Integer value) {
+    if constexpr (std::is_signed_v<Integer>) {
+        const std::int64_t wide = value;
+        return (std::uint64_t(wide) << 1) ^ std::uint64_t(wide >> 63);
+    } else {
+        return value;
+    }
+}
+
+template<typename Integer>
+Integer from_varint(std::uint64_t value) {
+    if constexpr (std::is_signed_v<Integer>) {
+        return static_cast<Integer>(static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1));
+    } else {
+        return static_cast<Integer>(value);
+    }
+}
+
+/// Decodes up to `count` varints that start in [data, limit) calling `emit(Integer)` for each one,
+/// never reading at or past `end` (the end of the buffer, `limit <= end`).
+/// Fast path handles 8 bytes per iteration: all single-byte varints in a
+/// little-endian loaded word are emitted without per-byte branching. It runs while the longest
+/// varint after the word fits before `end`, the rest is decoded with bounds checks
+/// Returns pointer past the last decoded byte, `count` is decreased by number of decoded values
+template<typename Integer, typename Emit>
+const unsigned char* decode_varint_run(const unsigned char* data, const unsigned char* limit, const unsigned char* end, size_t& count, Emit&& emit) {
+    constexpr std::uint64_t continuation_bits = 0x8080808080808080ull;
+    while (count >= 8 && limit - data >= 8 && end - data >= std::ptrdiff_t(8 + max_varint_size)) {
+        const std::uint64_t word = load_little_u64(data);
+        const std::uint64_t continuation = word & continuation_bits;
+        if (continuation == 0) {
+            for (unsigned i = 0; i < 8; ++i) {
+                emit(from_varint<Integer>((word >> (8 * i)) & 0x7f));
+            }
+            data += 8;
+            count -= 8;
+            continue;
+        }
+        // emit leading single-byte values, then decode one multi-byte value
+        const unsigned single = count_trailing_zeros(continuation) / 8;
+        for (unsigned i = 0; i < single; ++i) {
+            emit(from_varint<Integer>((word >> (8 * i)) & 0x7f));
+        }
+        std::uint64_t value = 0;
+        data = decode_varint(data + single, value);
+        emit(from_varint<Integer>(value));
+        count -= single + 1;
+    }
+    while (count > 0 && data < limit) {
+        std::uint64_t value = 0;
+        data = decode_varint(data, end, value);
+        emit(from_varint<Integer>(value));
+        --count;
+    }
+    return data;
+}
+
+} // namespace details
+
+
+/// Storage policies for Archive
+namespace storage_policy {
+
+template<typename Storage>
+struct Parent : public Storage {
+    using Storage::Storage;
+    Storage& get_storage() { return *static_cast<Storage*>(this);}
+};
+
+template<typename Storage>
+struct Inline {
+    Inline() = default;
+
+    template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<Storage, Args&&...>>>
+    explicit Inline(Args&&... args)
+        : storage(std::forward<Args>(args)...)
+    {}
+
+    Storage storage {};
+    Storage& get_storage() { return storage;}
+};
+
+template<typename Storage>
+struct NotOwningPointer {
+    NotOwningPointer(Storage* storage_)
+        : storage(storage_)
+    {}
+
+    Storage* storage;
+    Storage& get_storage() { return *storage;}
+};
+
+} // namespace storage_policy
+
+
+/// Storages shipped with the library
+namespace storage {
+
+/// Storage that only counts bytes written into it. Used for size-only passes
+struct Counter {
+    usize size = 0;
+
+    size_t write(const unsigned char*, size_t size_) {
+        size += size_;
+        return size_;
+    }
+};
+
+/// Growable in-memory buffer. Reserve the exact size up front
+/// (see `serialize_to_buffer`) to allocate only once
+class Buffer {
+public:
+    Buffer() = default;
+    explicit Buffer(size_t capacity) { bytes.reserve(capacity); }
+
+    size_t write(const unsigned char* data, size_t size) {
+        bytes.insert(bytes.end(), data, data + size);
+        return size;
+    }
+
+    void read(unsigned char* data, size_t size) {
+        ARCHIVE_ASSERT(read_pos + size <= bytes.size());
+        std::memcpy(data, bytes.data() + read_pos, size);
+        read_pos += size;
+    }
+
+    void reserve(size_t capacity) { bytes.reserve(capacity); }
+    void clear() { bytes.clear(); read_pos = 0; }
+    /// Starts reading from the beginning again
+    void rewind() { read_pos = 0; }
+
+    const unsigned char* data() const { return bytes.data(); }
+    size_t size() const { return bytes.size(); }
+    size_t capacity() const { return bytes.capacity(); }
+
+    size_t read_position() const { return read_pos; }
+    void advance(size_t size) {
+        ARCHIVE_ASSERT(read_pos + size <= bytes.size());
+        read_pos += size;
+    }
+
+    std::vector<unsigned char>& get_bytes() { return bytes; }
+    const std::vector<unsigned char>& get_bytes() const { return bytes; }
+
+private:
+    std::vector<unsigned char> bytes;
+    size_t read_pos = 0;
+};
+
+/// Read-only storage over a memory block owned by someone else.
+/// The block must outlive the storage and any views deserialized from it
+class MemoryReader {
+public:
+    MemoryReader() = default;
+    MemoryReader(const void* data, size_t size)
+        : begin(static_cast<const unsigned char*>(data))
+        , length(size)
+    {}
+
+    void read(unsigned char* data, size_t size) {
+        ARCHIVE_ASSERT(read_pos + size <= length);
+        std::memcpy(data, begin + read_pos, size);
+        read_pos += size;
+    }
+
+    const unsigned char* data() const { return begin; }
+    size_t size() const { return length; }
+
+    size_t read_position() const { return read_pos; }
+    void advance(size_t size) {
+        ARCHIVE_ASSERT(read_pos + size <= length);
+        read_pos += size;
+    }
+
+private:
+    const unsigned char* begin = nullptr;
+    size_t length = 0;
+    size_t read_pos = 0;
+};
+
+} // namespace storage
+
+
+/// Read-only view over `size` primitives placed one after another in a buffer,
+/// usually deserialized without copying from a contiguous storage.
+/// Elements are read with memcpy, so the buffer does not have to be aligned for `T`
+template<typename T>
+class View {
+    static_assert(traits::is_primitive_v<T>, "View can only hold primitives");
+public:
+    using value_type = T;
+
+    class iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = T;
+
+        iterator() = default;
+        explicit iterator(const unsigned char* position_) : position(position_) {}
+
+        T operator*() const { return load(position); }
+        T operator[](difference_type i) const { return load(position + i * difference_type(sizeof(T))); }
+        iterator& operator++() { position += sizeof(T); return *this; }
+        iterator operator++(int) { iterator copy = *this; ++*this; return copy; }
+        iterator& operator--() { position -= sizeof(T); return *this; }
+        iterator operator--(int) { iterator copy = *this; --*this; return copy; }
+        iterator& operator+=(difference_type n) { position += n * difference_type(sizeof(T)); return *this; }
+        iterator& operator-=(difference_type n) { position -= n * difference_type(sizeof(T)); return *this; }
+        iterator operator+(difference_type n) const { return iterator(*this) += n; }
+        iterator operator-(difference_type n) const { return iterator(*this) -= n; }
+        difference_type operator-(const iterator& other) const { return (position - other.position) / difference_type(sizeof(T)); }
+        bool operator==(const iterator& other) const { return position == other.position; }
+        bool operator!=(const iterator& other) const { return position != other.position; }
+        bool operator<(const iterator& other) const { return position < other.position; }
+        bool operator>(const iterator& other) const { return position > other.position; }
+        bool operator<=(const iterator& other) const { return position <= other.position; }
+        bool operator>=(const iterator& other) const { return position >= other.position; }
+        friend iterator operator+(difference_type n, const iterator& it) { return it + n; }
+    private:
+        const unsigned char* position = nullptr;
+    };
+    using const_iterator = iterator;
+
+    View() = default;
+    View(const void* data, size_t size)
+        : bytes(static_cast<const unsigned char*>(data))
+        , length(size)
+    {}
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+
+    /// Raw bytes of the viewed elements
+    const unsigned char* data() const { return bytes; }
+
+    T operator[](size_t i) const { return load(bytes + i * sizeof(T)); }
+    T front() const { return (*this)[0]; }
+    T back() const { return (*this)[length - 1]; }
+
+    iterator begin() const { return iterator(bytes); }
+    iterator end() const { return iterator(bytes + length * sizeof(T)); }
+
+private:
+    static T load(const unsigned char* position) {
+        T value;
+        std::memcpy(&value, position, sizeof(T));
+        return value;
+    }
+
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+};
+
+
+/// Opt-in container encoding with an offset table every `stride` elements:
+///    [length][stride][chunk offsets: fixed 64-bit, one per chunk plus the total][elements]
+/// Chunks can be decoded independently: in parallel (see `archive_parallel.h`) or through
+/// `IndexedView` to get an element without decoding the chunks before it.
+///    archive.serialize(archive::Indexed(records));
+///    archive.deserialize(archive::Indexed(records1));
+/// Offsets are computed with an extra counting pass over the elements unless they have a static size.
+/// Every element is written as a standalone object, integers are not packed into varint runs
+template<typename Container>
+class Indexed {
+public:
+    static constexpr size_t default_stride = 1024;
+
+    explicit Indexed(Container& container_, size_t stride_ = default_stride)
+        : container(&container_)
+        , chunk_stride(std::max<size_t>(stride_, 1))
+    {}
+
+    Container& get() const { return *container; }
+    /// Elements per chunk used for writing, readers take it from the archive
+    size_t stride() const { return chunk_stride; }
+
+private:
+    Container* container;
+    size_t chunk_stride;
+};
+
+/// Opt-in encoding of integer containers as frame-of-reference bit-packed blocks of 256 values:
+///    [length][blocks: [reference: fixed][bit width: u8][packed values]]
+/// Every block stores its values minus the block minimum with just enough bits for the largest of them,
+/// so values in a narrow range take a few bits each whatever their magnitude.
+///    archive.serialize(archive::Packed(ids));
+///    archive.deserialize(archive::Packed(ids1));
+/// Full blocks are packed and unpacked with SSE2/AVX2 kernels when the CPU has them, the format
+/// does not depend on the kernel
+template<typename Container>
+class Packed {
+public:
+    using container_type = Container;
+
+    explicit Packed(Container& container_)
+        : container(&container_)
+    {}
+
+    Container& get() const { return *container; }
+
+private:
+    Container* container;
+};
+
+/// Opt-in encoding for sorted or slowly changing integer sequences (ids, timestamps, offsets):
+///    [length][first value: fixed][zigzag encoded differences as `Packed` blocks]
+/// Differences between neighbours are packed instead of the values, so an ascending sequence
+/// with small gaps takes a few bits per element
+///    archive.serialize(archive::Delta(timestamps));
+template<typename Container>
+class Delta {
+public:
+    using container_type = Container;
+
+    explicit Delta(Container& container_)
+        : container(&container_)
+    {}
+
+    Container& get() const { return *container; }
+
+private:
+    Container* container;
+};
+
+/// Opt-in struct-of-arrays encoding for containers of tuple-like elements or of user structs with a field list:
+///    [length][one column per field, encoded as a `std::vector` of that field]
+/// Columns of primitives are written and read with a single storage call (or as one varint run),
+/// and a reader may decode only some of them:
+///    archive.serialize(archive::Columnar(rows));
+///    archive.deserialize(archive::Columnar(rows1).only({0, 3}));   // other fields stay default
+/// User structs list their fields with a function found by ADL:
+///    constexpr auto columnar_fields(const Trade*) { return std::make_tuple(&Trade::time, &Trade::price); }
+/// Elements are decoded in place, so they must be default constructible
+template<typename Container>
+class Columnar {
+public:
+    using container_type = Container;
+
+    explicit Columnar(Container& container_)
+        : container(&container_)
+    {}
+
+    Container& get() const { return *container; }
+
+    /// Columns to decode by field index, the rest are skipped
+    Columnar& only(std::initializer_list<size_t> columns) {
+        selected = 0;
+        for (size_t column: columns) {
+            selected |= column < 64 ? std::uint64_t(1) << column : 0;
+        }
+        return *this;
+    }
+
+    bool is_selected(size_t column) const {
+        return column < 64 && (selected >> column & 1);
+    }
+
+private:
+    Container* container;
+    std::uint64_t selected = ~std::uint64_t(0);
+};
+
+namespace traits {
+
+template<typename T, typename = void>
+struct has_columnar_fields: std::false_type {};
+
+template<typename T>
+struct has_columnar_fields<T, std::void_t<decltype(columnar_fields(std::declval<const T*>()))>>: std::true_type {};
+
+template<typename T> inline constexpr bool has_columnar_fields_v = has_columnar_fields<T>::value;
+
+} // namespace traits
+
+namespace details {
+
+/// Column accessor of a tuple-like element
+template<size_t I>
+struct TupleField {
+    template<typename T>
+    decltype(auto) operator()(T& object) const {
+        return std::get<I>(object);
+    }
+};
+
+template<size_t... I>
+auto tuple_fields(std::index_sequence<I...>) {
+    return std::make_tuple(TupleField<I>{}...);
+}
+
+/// Tuple of column accessors of `T`: member pointers from `columnar_fields` or `std::get` for tuple-like types
+template<typename T>
+auto column_fields() {
+    if constexpr (traits::has_columnar_fields_v<T>) {
+        return columnar_fields(static_cast<const T*>(nullptr));
+    } else {
+        static_assert(traits::is_tuple_like_v<T>, "Columnar elements must be tuple-like or declare columnar_fields");
+        return tuple_fields(std::make_index_sequence<std::tuple_size<T>::value>{});
+    }
+}
+
+template<typename T>
+inline constexpr size_t column_count_v = std::tuple_size<decltype(column_fields<T>())>::value;
+
+/// Type of the column read by `Field` from `T`
+template<typename T, typename Field>
+using column_type_t = std::remove_cv_t<std::remove_reference_t<std::invoke_result_t<const Field&, T&>>>;
+
+} // namespace details
+
+namespace details {
+
+/// Strings of `char` that go through the string dictionary
+template<typename T>
+struct is_dictionary_string: std::false_type {};
+
+template<typename Traits, typename Allocator>
+struct is_dictionary_string<std::basic_string<char, Traits, Allocator>>: std::true_type {};
+
+template<typename T> inline constexpr bool is_dictionary_string_v = is_dictionary_string<std::remove_const_t<T>>::value;
+
+} // namespace details
+
+/// Session state of string dictionary encoding (see `BinaryArchive::set_string_dictionary`).
+/// A writer numbers strings in order of their first occurrence and a reader collects them in the same
+/// order, so a dictionary covers one write session and a fresh (or cleared) one is needed to read it back.
+/// Strings longer than `max_string_size` or arriving after `max_entries` are written in full every time
+class StringDictionary {
+public:
+    static constexpr size_t default_max_entries = size_t(1) << 16;
+    static constexpr size_t default_max_string_size = 256;
+
+    explicit StringDictionary(size_t max_entries_ = default_max_entries, size_t max_string_size_ = default_max_string_size)
+        : max_entries(max_entries_)
+        , max_string_size(max_string_size_)
+    {}
+
+    StringDictionary(const StringDictionary&) = delete;
+    StringDictionary& operator=(const StringDictionary&) = delete;
+
+    /// Number of interned strings
+    size_t size() const { return entries.size(); }
+
+    /// Interned string with `id`, valid until the dictionary is cleared or destroyed
+    std::string_view operator[](size_t id) const { return entries[id]; }
+
+    void clear() {
+        ids.clear();
+        entries.clear();
+    }
+
+private:
+    template<typename, template<typename> class, typename, typename>
+    friend struct BinaryArchive;
+
+    enum Code : std::uint64_t {
+        Literal = 0,
+        Added = 1,
+        /// Codes from `First` on are references: `First + id`
+        First = 2,
+    };
+
+    /// Code of `value` for the writer: a reference if it was seen, `Added` if it is interned now, `Literal` otherwise
+    std::uint64_t encode(std::string_view value) {
+        const auto it = ids.find(value);
+        if (it != ids.end()) {
+            return First + it->second;
+        }
+        if (value.size() > max_string_size || entries.size() >= max_entries) {
+            return Literal;
+        }
+        const size_t id = entries.size();
+        ids.emplace(entries.emplace_back(value), id);
+        return Added;
+    }
+
+    /// New entry of `size` characters for the reader to fill
+    char* add(size_t size) {
+        return entries.emplace_back(size, '\0').data();
+    }
+
+    std::string_view find(std::uint64_t code) const {
+        ARCHIVE_ASSERT(code >= First && code - First < entries.size());
+        return code >= First && code - First < entries.size() ? std::string_view(entries[static_cast<size_t>(code - First)]) : std::string_view();
+    }
+
+    size_t max_entries;
+    size_t max_string_size;
+    /// Deques keep strings in place, so views of them stay valid as the dictionary grows
+    std::deque<std::string> entries;
+    std::unordered_map<std::string_view, size_t> ids;
+};
+
+namespace details {
+
+/// Unique address per type, tells objects apart from their members at the same address
+template<typename T>
+inline constexpr char type_tag = 0;
+
+/// Object type a pointer refers to
+template<typename Pointer>
+struct pointee {
+    using type = typename Pointer::element_type;
+};
+
+template<typename T>
+struct pointee<T*> {
+    using type = T;
+};
+template<typename Pointer> using pointee_t = typename pointee<Pointer>::type;
+
+[[noreturn]] inline void throw_pointer_error(std::errc code, const char* what) {
+    throw std::system_error(std::make_error_code(code), what);
+}
+
+} // namespace details
+
+/// Session state of pointer encoding (see `BinaryArchive::set_object_table`).
+/// A writer numbers objects in order of their first occurrence, keyed by address and static type in an
+/// open-addressing hash, and a reader collects them in the same order, so a table covers one write session
+/// and a fresh (or cleared) one is needed to read it back. A writing table keeps objects written through
+/// `std::shared_ptr` and `std::weak_ptr` alive until it is cleared, so their addresses are not reused within
+/// the session. A reading table owns the objects read through them, so weak-only objects and cycles stay alive
+class ObjectTable {
+public:
+    ObjectTable() = default;
+
+    ObjectTable(const ObjectTable&) = delete;
+    ObjectTable& operator=(const ObjectTable&) = delete;
+
+    /// Number of objects written or read
+    size_t size() const { return count + objects.size(); }
+
+    void clear() {
+        slots.clear();
+        count = 0;
+        objects.clear();
+    }
+
+private:
+    template<typename, template<typename> class, typename, typename>
+    friend struct BinaryArchive;
+
+    enum Code : std::uint64_t {
+        Null = 0,
+        New = 1,
+        /// Codes from `First` on are back-references: `First + id`
+        First = 2,
+    };
+
+    static constexpr size_t npos = ~size_t(0);
+
+    struct Slot {
+        const void* address = nullptr;
+        const void* type = nullptr;
+        size_t id = 0;
+        /// Set for objects written through shared pointers
+        std::shared_ptr<const void> owner;
+    };
+
+    struct Object {
+        void* address = nullptr;
+        const void* type = nullptr;
+        /// Set for objects read through shared pointers
+        std::shared_ptr<void> owner;
+    };
+
+    /// Id of the object for the writer if it was seen, otherwise numbers it, keeps `owner` (a shared pointer
+    /// or nullptr) and returns `npos`
+    template<typename Owner>
+    size_t find_or_add(const void* address, const void* type, const Owner& owner) {
+        if (2 * (count + 1) > slots.size()) {
+            grow();
+        }
+        for (size_t i = slot_of(address);; i = (i + 1) & (slots.size() - 1)) {
+            Slot& slot = slots[i];
+            if (!slot.address) {
+                slot = {address, type, count++, std::shared_ptr<const void>(owner)};
+                return npos;
+            }
+            if (slot.address == address && slot.type == type) {
+                return slot.id;
+            }
+        }
+    }
+
+    /// Keeps the load factor at most 1/2, so probe sequences stay short
+    void grow() {
+        std::vector<Slot> old(std::max<size_t>(64, slots.size() * 2));
+        old.swap(slots);
+        for (Slot& slot: old) {
+            if (slot.address) {
+                size_t i = slot_of(slot.address);
+                while (slots[i].address) {
+                    i = (i + 1) & (slots.size() - 1);
+                }
+                slots[i] = std::move(slot);
+            }
+        }
+    }
+
+    /// Fibonacci hashing: allocations are aligned, so the high bits of the product are used
+    size_t slot_of(const void* address) const {
+        const std::uint64_t hash = static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(address)) * 0x9E3779B97F4A7C15ull;
+        return static_cast<size_t>(hash >> 32) & (slots.size() - 1);
+    }
+
+    /// Numbers a new object for the reader, it is filled by `set` once created
+    size_t reserve(const void* type) {
+        objects.push_back({nullptr, type, {}});
+        return objects.size() - 1;
+    }
+
+    void set(size_t id, void* address, std::shared_ptr<void> owner) {
+        objects[id].address = address;
+        objects[id].owner = std::move(owner);
+    }
+
+    /// Object a back-reference `code` points to, throws if it is unknown, of another type or not created yet
+    const Object& find(std::uint64_t code, const void* type) const {
+        if (code < First || code - First >= objects.size() || objects[static_cast<size_t>(code - First)].type != type) {
+            details::throw_pointer_error(std::errc::illegal_byte_sequence, "archive: unknown pointer back-reference");
+        }
+        const Object& object = objects[static_cast<size_t>(code - First)];
+        if (!object.address) {
+            // types constructed from the archive are registered once read
+            details::throw_pointer_error(std::errc::illegal_byte_sequence, "archive: pointer back-reference to an object being constructed");
+        }
+        return object;
+    }
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    std::vector<Object> objects;
+};
+
+template<typename T, typename Encoding, typename ByteOrder>
+class IndexedView;
+
+template<typename T>
+class Lazy;
+
+enum class Direction {
+    Deserialize,
+    Serialize,
+    Bidirectional,
+};
+
+template<typename Archive, Direction policy>
+class ArchiveStream;
+
+
+/// Encoding policies for Archive: how lengths and integers are laid out
+namespace encoding {
+
+template<bool VarintLengths, bool VarintIntegers>
+struct Policy {
+    /// container/string lengths are written as LEB128 instead of fixed `usize`
+    static constexpr bool varint_lengths = VarintLengths;
+    /// integers wider than a byte are written as LEB128, signed ones are zigzag encoded first
+    static constexpr bool varint_integers = VarintIntegers;
+};
+
+/// Every length is a fixed `usize`, every primitive takes its sizeof (default)
+using Fixed = Policy<false, false>;
+/// Varint lengths, fixed-width primitives
+using VarintLengths = Policy<true, false>;
+/// Varint lengths and integers.
+/// Runs of integers in containers are prefixed with their encoded byte size
+using Varint = Policy<true, true>;
+
+} // namespace encoding
+
+
+/// Byte order of fixed-width primitives, enums and lengths in the archive.
+/// Varints are byte-oriented and are not affected
+namespace byte_order {
+
+/// Host byte order, no conversion (default)
+struct Native {
+    static constexpr bool swap = false;
+};
+
+struct Little {
+    static constexpr bool swap = !details::host_is_little_endian;
+};
+
+struct Big {
+    static constexpr bool swap = details::host_is_little_endian;
+};
+
+} // namespace byte_order
+
+
+// TODO:? move all members to archive ns and rename as *_object, leave only template<T> members
+// calling *_object template, so that latter will be found via ADL.
+// this will enable behavoiur specializations for specific types
+/// BinaryArchive with `serialize(const T& t)` / `deserialize(T& t)` API
+/// to make custom type serializable add pair of functions:
+///    serialize_object(T object, BinaryArchive&);
+///    deserialize_object(T object, BinaryArchive&);
+template<
+        typename Storage,
+        template<typename S>class StoragePolicy = storage_policy::Parent,
+        typename Encoding = encoding::Fixed,
+        typename ByteOrder = byte_order::Native
+>
+struct BinaryArchive : public StoragePolicy<Storage> {
+    using StoragePolicy<Storage>::get_storage;
+    using encoding_type = Encoding;
+    using byte_order_type = ByteOrder;
+
+    /// Non-primitive trivially serializable types are written as raw memory blocks
+    /// when the archive stores their primitives as is. Only trivially copyable types laid out in
+    /// encoding order are copied as bytes (see `details::has_block_layout`)
+    template<typename T>
+    static constexpr bool is_block_v = traits::is_trivially_serializable_v<std::remove_const_t<T>>
+            && std::is_trivially_copyable_v<std::remove_const_t<T>>
+            && details::has_block_layout<std::remove_const_t<T>>::value
+            && !traits::is_primitive_v<std::remove_const_t<T>>
+            && !ByteOrder::swap
+            && !Encoding::varint_integers;
+
+    /// Other trivially serializable tuple-like types, such as `std::pair` and `std::tuple` of primitives,
+    /// are gathered field by field into stack chunks that are written with one storage call each
+    template<typename T>
+    static constexpr bool is_gathered_v = traits::is_trivially_serializable_v<std::remove_const_t<T>>
+            && traits::is_tuple_like_v<std::remove_const_t<T>>
+            && !traits::is_primitive_v<std::remove_const_t<T>>
+            && !is_block_v<T>
+            && details::has_copyable_fields<std::remove_const_t<T>>()
+            && sizeof(T) <= details::chunk_size
+            && !ByteOrder::swap
+            && !Encoding::varint_integers;
+
+    template<typename... Args>
+    BinaryArchive(Args... args)
+        : StoragePolicy<Storage> (std::forward<Args>(args)...)
+    {}
+
+    /// Memory resource for objects created during deserialization that cannot take
+    /// an allocator from their container: values of optionals, elements of containers
+    /// that are not allocator-aware and objects returned by `deserialize<T>()`.
+    /// Elements of allocator-aware containers always use the container allocator,
+    /// so a whole `std::pmr` object graph ends up in one resource
+    void set_memory_resource(std::pmr::memory_resource* resource) { memory_resource = resource; }
+    std::pmr::memory_resource* get_memory_resource() const { return memory_resource; }
+
+    /// Writes and reads `char` strings and string views through `dictionary`: the first occurrence of
+    /// a string is written in full, later ones as a varint id. Views read from the archive point into
+    /// the dictionary, so repeated strings share its storage. Both sides must use a dictionary for the
+    /// whole session. `Indexed` and `Lazy` contents are encoded without it, as they are decoded by other
+    /// archives, and `serialized_size` does not account for it
+    void set_string_dictionary(StringDictionary* dictionary) { string_dictionary = dictionary; }
+    StringDictionary* get_string_dictionary() const { return string_dictionary; }
+
+    /// Tracks object identity through `table`: an object reached by several pointers is written once
+    /// and later pointers to it as back-reference ids, so a reader restores the sharing and cycles.
+    /// Without a table every non-null pointer writes its object, which recurses forever on cycles.
+    /// Both sides must use a table for the whole session; `Indexed` and `Lazy` contents are encoded
+    /// without it and `serialized_size` does not account for it. Objects written through raw pointers and
+    /// `std::unique_ptr` must stay alive for the whole session, a new object at the address of a freed one
+    /// would be written as a back-reference to it. The table keeps objects of shared pointers alive itself
+    void set_object_table(ObjectTable* table) { object_table = table; }
+    ObjectTable* get_object_table() const { return object_table; }
+
+    /// Exact number of bytes `serialize(object)` writes, computed without writing anything.
+    /// Known at compile time for types with `traits::static_size`, otherwise computed
+    /// by serializing into a counting storage
+    template<typename T>
+    static usize serialized_size(const T& object) {
+        if constexpr (traits::has_static_size_v<T> && !Encoding::varint_integers) {
+            return traits::static_size<T>::value;
+        } else {
+            BinaryArchive<storage::Counter, storage_policy::Inline, Encoding, ByteOrder> counter;
+            counter.serialize(object);
+            return counter.get_storage().size;
+        }
+    }
+
+    /// ===== Serialize =====
+
+    template<typename Empty>
+    std::enable_if_t<std::is_empty_v<Empty>, usize> serialize(Empty) {
+        return 0;
+    }
+
+    template<typename Primitive>
+    std::enable_if_t<traits::is_primitive_v<Primitive>, usize> serialize(const Primitive primitive) {
+        if constexpr (Encoding::varint_integers && traits::is_varint_integer_v<Primitive>) {
+            return serialize_varint(details::to_varint(primitive));
+        } else {
+            return serialize_fixed(primitive);
+        }
+    }
+
+    template<typename Container>
+    std::enable_if_t<traits::is_container_v<Container> || std::is_array<Container>::value, usize> serialize(const Container& container) {
+        if constexpr (details::is_dictionary_string_v<Container>) {
+            if (string_dictionary) {
+                return serialize_interned(std::string_view(container.data(), container.size()));
+            }
+        }
+        const size_t length = std::size(container);
+        usize size = serialize_length(length);
+        if constexpr (is_varint_run_v<traits::element_type_t<Container>>) {
+            size += serialize_varint_run(std::begin(container), length);
+        } else if constexpr (traits::is_contiguous_primitive_v<Container>) {
+            size += serialize_contiguous(std::data(container), length);
+        } else {
+            if constexpr (is_block_v<traits::element_type_t<Container>> && traits::is_contiguous_v<Container>) {
+                return size + serialize_block(std::data(container), length);
+            } else if constexpr (is_gathered_v<traits::element_type_t<Container>>) {
+                return size + serialize_gathered(std::begin(container), length);
+            }
+            for (auto&& e: container) {
+                size += serialize(e);
+            }
+        }
+        return size;
+    }
+
+    /// Writes the same bytes as `serialize(container)`, with elements serialized by an execution
+    /// policy such as `archive::parallel` from `archive_parallel.h`.
+    /// Containers written with a single storage call (primitives, blocks, varint runs) are written as usual
+    template<typename Container, typename ExecutionPolicy>
+    std::enable_if_t<traits::is_container_v<Container> && traits::is_execution_policy_v<ExecutionPolicy>, usize>
+    serialize(const Container& container, const ExecutionPolicy& policy) {
+        if (string_dictionary || object_table) {
+            // ids depend on the order strings and objects are written in
+            return serialize(container);
+        }
+        using Element = traits::element_type_t<Container>;
+        if constexpr (is_varint_run_v<Element> || traits::is_contiguous_primitive_v<Container>
+                || (is_block_v<Element> && traits::is_contiguous_v<Container>) || is_gathered_v<Element>) {
+            return serialize(container);
+        } else {
+            const size_t length = std::size(container);
+            return serialize_length(length) + policy.serialize_elements(*this, std::begin(container), length);
+        }
+    }
+
+    template<typename Gettable>
+    std::enable_if_t<
+            traits::is_tuple_like_v<Gettable>
+            && !traits::is_primitive_v<Gettable>
+    , usize> serialize(const Gettable& object) {
+        constexpr size_t N = std::tuple_size<Gettable>::value;
+        if constexpr (Encoding::varint_integers && traits::is_contiguous_varint_integer_v<Gettable>) {
+            return serialize_varint_run(std::begin(object), N);
+        } else if constexpr (traits::is_contiguous_primitive_v<Gettable>) {
+            return serialize_contiguous(std::data(object), N);
+        } else {
+            if constexpr (is_block_v<Gettable>) {
+                return serialize_block(&object, 1);
+            } else if constexpr (is_gathered_v<Gettable>) {
+                return serialize_gathered(&object, 1);
+            }
+            usize size = 0;
+            details::for_each_tuple_element<0, N>(object, [&size, this] (auto&& element) {
+                size += this->serialize(element);
+            });
+            return size;
+        }
+    }
+
+    template<typename Serializable>
+    std::enable_if_t<details::external_serialize_exists_v<Serializable, BinaryArchive<Storage, StoragePolicy, Encoding, ByteOrder>>, usize> serialize(const Serializable& object) {
+        if constexpr (is_block_v<Serializable>) {
+            return serialize_block(&object, 1);
+        } else {
+            return serialize_object(object, *this);
+        }
+    }
+
+    /// Opted-in trivially serializable types that only provide `stream_serialization`
+    template<typename Block>
+    std::enable_if_t<
+            is_block_v<Block>
+            && !traits::is_tuple_like_v<Block>
+            && !details::external_serialize_exists_v<Block, BinaryArchive<Storage, StoragePolicy, Encoding, ByteOrder>>
+    , usize> serialize(const Block& object) {
+        return serialize_block(&object, 1);
+    }
+
+    template<typename Char, typename Traits>
+    usize serialize(const std::basic_string_view<Char, Traits> view) {
+        if constexpr (std::is_same_v<Char, char>) {
+            if (string_dictionary) {
+                return serialize_interned(std::string_view(view.data(), view.size()));
+            }
+        }
+        const usize size = serialize_length(view.size());
+        if constexpr (is_varint_run_v<Char>) {
+            return size + serialize_varint_run(view.begin(), view.size());
+        } else {
+            return size + serialize_contiguous(view.data(), view.size());
+        }
+    }
+
+    template<typename T>
+    usize serialize(const View<T>& view) {
+        static_assert(is_viewable_v<T>, "View elements must be stored as is by this archive");
+        return serialize_length(view.size()) + get_storage().write(view.data(), view.size() * sizeof(T));
+    }
+
+    template<typename Container>
+    usize serialize(const Indexed<Container>& indexed) {
+        using Element = traits::remove_const_element_type_t<std::remove_const_t<Container>>;
+        const SessionPause pause(*this);
+        const auto& container = indexed.get();
+        const size_t length = std::size(container);
+        const size_t stride = indexed.stride();
+        const size_t chunks = (length + stride - 1) / stride;
+        usize size = serialize_length(length) + serialize_length(stride);
+        if constexpr (traits::has_static_size_v<Element> && !Encoding::varint_integers) {
+            for (size_t chunk = 0; chunk <= chunks; ++chunk) {
+                size += serialize_fixed(std::uint64_t(std::min(chunk * stride, length) * traits::static_size<Element>::value));
+            }
+        } else {
+            BinaryArchive<storage::Counter, storage_policy::Inline, Encoding, ByteOrder> counter;
+            size_t index = 0;
+            for (auto&& e: container) {
+                if (index++ % stride == 0) {
+                    size += serialize_fixed(std::uint64_t(counter.get_storage().size));
+                }
+                counter.serialize(e);
+            }
+            size += serialize_fixed(std::uint64_t(counter.get_storage().size));
+        }
+        return size + serialize_each(container);
+    }
+
+    template<typename Container>
+    usize serialize(const Packed<Container>& packed) {
+        using Element = traits::remove_const_element_type_t<std::remove_const_t<Container>>;
+        static_assert(std::is_integral_v<Element> && !std::is_same_v<Element, bool>, "Packed elements must be integers");
+        using Unsigned = std::make_unsigned_t<Element>;
+        const auto& container = packed.get();
+        usize size = serialize_length(std::size(container));
+        Unsigned block[details::packed_block_size];
+        size_t used = 0;
+        for (const auto& e: container) {
+            block[used++] = details::to_ordered(e);
+            if (used == details::packed_block_size) {
+                size += serialize_packed_block(block, used);
+                used = 0;
+            }
+        }
+        return used > 0 ? size + serialize_packed_block(block, used) : size;
+    }
+
+    template<typename Container>
+    usize serialize(const Delta<Container>& delta) {
+        using Element = traits::remove_const_element_type_t<std::remove_const_t<Container>>;
+        static_assert(std::is_integral_v<Element> && !std::is_same_v<Element, bool>, "Delta elements must be integers");
+        using Unsigned = std::make_unsigned_t<Element>;
+        const auto& container = delta.get();
+        const size_t length = std::size(container);
+        usize size = serialize_length(length);
+        if (length == 0) {
+            return size;
+        }
+        auto it = std::begin(container);
+        Unsigned previous = static_cast<Unsigned>(*it);
+        size += serialize_fixed(previous);
+        Unsigned block[details::packed_block_size];
+        size_t used = 0;
+        for (size_t i = 1; i < length; ++i) {
+            const Unsigned value = static_cast<Unsigned>(*++it);
+            block[used++] = details::to_zigzag(static_cast<Unsigned>(value - previous));
+            previous = value;
+            if (used == details::packed_block_size) {
+                size += serialize_packed_block(block, used);
+                used = 0;
+            }
+        }
+        return used > 0 ? size + serialize_packed_block(block, used) : size;
+    }
+
+    template<typename Container>
+    usize serialize(const Columnar<Container>& columnar) {
+        using Element = traits::remove_const_element_type_t<std::remove_const_t<Container>>;
+        const auto& container = columnar.get();
+        const size_t length = std::size(container);
+        usize size = serialize_length(length);
+        details::for_each_tuple_element<0, details::column_count_v<Element>>(details::column_fields<Element>(), [&] (const auto& field) {
+            size += serialize_column(container, length, field);
         });
+        return size;
+    }
+
+    /// Untouched values read by an archive with the same encoding and byte order are copied as is
+    template<typename T>
+    usize serialize(const Lazy<T>& lazy) {
+        if (!lazy.is_loaded() && lazy.decoder == &Lazy<T>::template decode<Encoding, ByteOrder>) {
+            const usize size = serialize_length(lazy.length);
+            return lazy.length > 0 ? size + get_storage().write(lazy.encoded(), lazy.length) : size;
+        }
+        const T& value = lazy.get();
+        const SessionPause pause(*this);
+        if constexpr (details::external_stream_serialization_exists_v<ArchiveStream<BinaryArchive, Direction::Serialize>, const T>) {
+            // types with only `stream_serialization` are written as `ArchiveStream` writes them
+            ArchiveStream<BinaryArchive<storage::Counter, storage_policy::Inline, Encoding, ByteOrder>, Direction::Serialize> counter;
+            counter << value;
+            const usize size = counter.getArchive().get_storage().size;
+            const usize length_size = serialize_length(size);
+            ArchiveStream<BinaryArchive<Storage, storage_policy::NotOwningPointer, Encoding, ByteOrder>, Direction::Serialize> writer(&get_storage());
+            writer << value;
+            return length_size + size;
+        } else {
+            return serialize_length(serialized_size(value)) + serialize(value);
+        }
+    }
+
+#if defined(ARCHIVE_HAS_SPAN)
+    template<typename T, size_t Extent>
+    std::enable_if_t<traits::is_primitive_v<std::remove_const_t<T>>, usize> serialize(const std::span<T, Extent> span) {
+        const usize size = serialize_length(span.size());
+        if constexpr (Encoding::varint_integers && traits::is_varint_integer_v<std::remove_const_t<T>>) {
+            return size + serialize_varint_run(span.begin(), span.size());
+        } else {
+            return size + serialize_contiguous(span.data(), span.size());
+        }
+    }
+#endif
+
+    template<typename Optional>
+    std::enable_if_t<traits::is_optional_v<Optional>, usize> serialize(const Optional& optional) {
+        usize size = serialize(optional.has_value());
+        if (optional.has_value()) {
+            size += serialize(*optional);
+        }
+        return size;
+    }
+
+    /// Writes a pointer as a varint code: null, a new object followed by it, or a back-reference
+    template<typename Pointer>
+    std::enable_if_t<traits::is_pointer_v<Pointer>, usize> serialize(const Pointer& pointer) {
+        return serialize_pointer(pointer, [this] (const auto& object) { return serialize(object); });
+    }
+
+    /// Pointer encoding with the object written by `write(object)`, which returns its size or nothing.
+    /// `ArchiveStream` writes objects with `stream_serialization` through it. Throws `std::system_error`
+    /// for a `std::unique_ptr` to an object written before, which could not own it when read back
+    template<typename Pointer, typename Write>
+    usize serialize_pointer(const Pointer& pointer, Write&& write) {
+        using Object = details::pointee_t<std::remove_const_t<Pointer>>;
+        if constexpr (details::is_instance_of_v<std::remove_const_t<Pointer>, std::weak_ptr>) {
+            return serialize_pointer(pointer.lock(), write);
+        } else {
+            const Object* object = pointer ? &*pointer : nullptr;
+            if (!object) {
+                return serialize_varint(ObjectTable::Null);
+            }
+            if (object_table) {
+                size_t id = ObjectTable::npos;
+                if constexpr (details::is_instance_of_v<std::remove_const_t<Pointer>, std::shared_ptr>) {
+                    id = object_table->find_or_add(object, &details::type_tag<std::remove_const_t<Object>>, pointer);
+                } else {
+                    id = object_table->find_or_add(object, &details::type_tag<std::remove_const_t<Object>>, nullptr);
+                }
+                if (id != ObjectTable::npos) {
+                    if constexpr (details::is_instance_of_v<std::remove_const_t<Pointer>, std::unique_ptr>) {
+                        details::throw_pointer_error(std::errc::invalid_argument, "archive: std::unique_ptr to an object written before");
+                    }
+                    return serialize_varint(ObjectTable::First + id);
+                }
+            }
+            const usize size = serialize_varint(ObjectTable::New);
+            if constexpr (std::is_void_v<decltype(write(*object))>) {
+                write(*object);
+                return size;
+            } else {
+                return size + write(*object);
+            }
+        }
+    }
+
+    /// ===== Deserialize =====
+
+    template<typename Empty>
+    std::enable_if_t<std::is_empty_v<Empty>> deserialize(Empty&) {}
+
+    template<typename Primitive>
+    std::enable_if_t<traits::is_primitive_v<Primitive>> deserialize(Primitive& primitive) {
+        if constexpr (Encoding::varint_integers && traits::is_varint_integer_v<Primitive>) {
+            primitive = details::from_varint<Primitive>(deserialize_varint());
+        } else {
+            deserialize_fixed(primitive);
+        }
+    }
+
+    template<typename Container>
+    std::enable_if_t<traits::is_container_v<Container>> deserialize(Container& container) {
+        if constexpr (details::is_dictionary_string_v<Container>) {
+            if (string_dictionary) {
+                const std::uint64_t code = deserialize_varint();
+                if (code != StringDictionary::Literal) {
+                    const std::string_view value = deserialize_interned(code);
+                    container.assign(value.data(), value.size());
+                    return;
+                }
+            }
+        }
+        const usize size = deserialize_length();
+        using Element = traits::remove_const_element_type_t<Container>;
+        if constexpr (is_varint_run_v<Element>) {
+            if constexpr (traits::is_contiguous_v<Container> && traits::has_resize_v<Container>) {
+                container.resize(static_cast<size_t>(size));
+                Element* out = std::data(container);
+                deserialize_varint_run<Element>(static_cast<size_t>(size), [&out] (Element value) { *out++ = value; });
+            } else {
+                details::reserve_silent(container, static_cast<size_t>(size));
+                deserialize_varint_run<Element>(static_cast<size_t>(size), [&container] (Element value) {
+                    details::insert(container, value);
+                });
+            }
+        } else if constexpr (traits::is_contiguous_primitive_v<Container> && traits::has_resize_v<Container>) {
+            container.resize(static_cast<size_t>(size));
+            deserialize_contiguous(std::data(container), static_cast<size_t>(size));
+        } else {
+            if constexpr (is_block_v<Element> && traits::is_contiguous_v<Container> && traits::has_resize_v<Container>
+                    && std::is_default_constructible_v<Element>) {
+                container.resize(static_cast<size_t>(size));
+                deserialize_block(std::data(container), static_cast<size_t>(size));
+                return;
+            } else if constexpr (is_gathered_v<Element> && std::is_default_constructible_v<Element>) {
+                deserialize_gathered(container, static_cast<size_t>(size));
+                return;
+            }
+            details::reserve_silent(container, static_cast<size_t>(size));
+            deserialize_elements(container, static_cast<size_t>(size));
+        }
+    }
+
+    template<typename Gettable>
+    std::enable_if_t<
+            traits::is_tuple_like_v<Gettable>
+            && !traits::is_primitive_v<Gettable>
+    > deserialize(Gettable& object) {
+        constexpr size_t N = std::tuple_size<Gettable>::value;
+        if constexpr (Encoding::varint_integers && traits::is_contiguous_varint_integer_v<Gettable>) {
+            auto* out = std::data(object);
+            deserialize_varint_run<traits::element_type_t<Gettable>>(N, [&out] (auto value) { *out++ = value; });
+        } else if constexpr (traits::is_contiguous_primitive_v<Gettable>) {
+            deserialize_contiguous(std::data(object), N);
+        } else {
+            if constexpr (is_block_v<Gettable>) {
+                deserialize_block(&object, 1);
+                return;
+            } else if constexpr (is_gathered_v<Gettable>) {
+                unsigned char fields[sizeof(Gettable)];
+                get_storage().read(fields, sizeof(Gettable));
+                details::load_fields(object, fields);
+                return;
+            }
+            details::for_each_tuple_element<0, N>(object, [this] (auto&& element) {
+                this->deserialize(element);
+            });
+        }
     }
 
     template<typename Deserializable>
-    std::enable_if_t<details::external_deserialize_exists_v<Deserializable, BinaryArchive<Storage, StoragePolicy>>> deserialize(Deserializable& object) {
-        deserialize_object(object, *this);
+    std::enable_if_t<details::external_deserialize_exists_v<Deserializable, BinaryArchive<Storage, StoragePolicy, Encoding, ByteOrder>>> deserialize(Deserializable& object) {
+        if constexpr (is_block_v<Deserializable>) {
+            deserialize_block(&object, 1);
+        } else {
+            deserialize_object(object, *this);
+        }
+    }
+
+    template<typename Block>
+    std::enable_if_t<
+            is_block_v<Block>
+            && !traits::is_tuple_like_v<Block>
+            && !details::external_deserialize_exists_v<Block, BinaryArchive<Storage, StoragePolicy, Encoding, ByteOrder>>
+    > deserialize(Block& object) {
+        deserialize_block(&object, 1);
+    }
+
+    /// Zero-copy deserialization: views point into the storage memory, which must
+    /// outlive them. Only available for contiguous storages (see `traits::is_contiguous_storage`)
+    template<typename Char, typename Traits>
+    void deserialize(std::basic_string_view<Char, Traits>& view) {
+        static_assert(is_viewable_v<Char>, "String characters must be stored as is by this archive");
+        if constexpr (std::is_same_v<Char, char>) {
+            if (string_dictionary) {
+                const std::uint64_t code = deserialize_varint();
+                if (code != StringDictionary::Literal) {
+                    const std::string_view value = deserialize_interned(code);
+                    view = std::basic_string_view<Char, Traits>(value.data(), value.size());
+                    return;
+                }
+            }
+        }
+        const size_t size = static_cast<size_t>(deserialize_length());
+        view = std::basic_string_view<Char, Traits>(reinterpret_cast<const Char*>(deserialize_view(size * sizeof(Char))), size);
+    }
+
+    template<typename T>
+    void deserialize(View<T>& view) {
+        static_assert(is_viewable_v<T>, "View elements must be stored as is by this archive");
+        const size_t size = static_cast<size_t>(deserialize_length());
+        view = View<T>(deserialize_view(size * sizeof(T)), size);
+    }
+
+    /// Reads the header of an `Indexed` container and skips its elements, which are decoded later
+    /// on demand from the storage memory
+    template<typename T>
+    void deserialize(IndexedView<T, Encoding, ByteOrder>& view) {
+        static_assert(traits::is_contiguous_storage_v<Storage>, "IndexedView requires a contiguous storage");
+        view.length = static_cast<size_t>(deserialize_length());
+        view.chunk_stride = static_cast<size_t>(deserialize_length());
+        ARCHIVE_ASSERT(view.chunk_stride > 0);
+        view.chunks = (view.length + view.chunk_stride - 1) / view.chunk_stride;
+        view.table = deserialize_view((view.chunks + 1) * sizeof(std::uint64_t));
+        view.memory_resource = memory_resource;
+        view.elements = deserialize_view(view.offset(view.chunks));
+    }
+
+#if defined(ARCHIVE_HAS_SPAN)
+    /// `data` has to be aligned for `T` in the storage memory, use `View<T>` if it is not guaranteed
+    template<typename T>
+    void deserialize(std::span<const T>& span) {
+        static_assert(is_viewable_v<T>, "Span elements must be stored as is by this archive");
+        const size_t size = static_cast<size_t>(deserialize_length());
+        const unsigned char* data = deserialize_view(size * sizeof(T));
+        ARCHIVE_ASSERT(reinterpret_cast<std::uintptr_t>(data) % alignof(T) == 0);
+        span = std::span<const T>(reinterpret_cast<const T*>(data), size);
+    }
+#endif
+
+    /// Only remembers where the value is, it is decoded on first access. Contiguous storages are referenced
+    /// like views, so their memory must outlive the value until it is accessed or serialized again;
+    /// bytes from other storages are copied
+    template<typename T>
+    void deserialize(Lazy<T>& lazy) {
+        const size_t size = static_cast<size_t>(deserialize_length());
+        lazy.value.reset();
+        lazy.owned.clear();
+        lazy.length = size;
+        if constexpr (traits::is_contiguous_storage_v<Storage>) {
+            lazy.bytes = deserialize_view(size);
+        } else {
+            lazy.bytes = nullptr;
+            lazy.owned.resize(size);
+            if (size > 0) {
+                get_storage().read(lazy.owned.data(), size);
+            }
+        }
+        lazy.decoder = &Lazy<T>::template decode<Encoding, ByteOrder>;
+        lazy.memory_resource = memory_resource;
+    }
+
+    /// Elements are appended to the wrapped container
+    template<typename Container>
+    void deserialize(Indexed<Container> indexed) {
+        const SessionPause pause(*this);
+        const size_t length = static_cast<size_t>(deserialize_length());
+        const size_t stride = static_cast<size_t>(deserialize_length());
+        ARCHIVE_ASSERT(stride > 0);
+        skip_bytes(((length + stride - 1) / stride + 1) * sizeof(std::uint64_t));
+        deserialize_each(indexed.get(), length);
+    }
+
+    /// Elements are appended to the wrapped container
+    template<typename Container>
+    void deserialize(Packed<Container> packed) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        using Unsigned = std::make_unsigned_t<Element>;
+        deserialize_packed(packed.get(), static_cast<size_t>(deserialize_length()), [] (Unsigned* values, size_t count) {
+            if constexpr (std::is_signed_v<Element>) {
+                for (size_t i = 0; i < count; ++i) {
+                    values[i] = details::to_ordered(static_cast<Element>(values[i]));
+                }
+            }
+        });
+    }
+
+    /// Elements are appended to the wrapped container
+    template<typename Container>
+    void deserialize(Delta<Container> delta) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        using Unsigned = std::make_unsigned_t<Element>;
+        const size_t length = static_cast<size_t>(deserialize_length());
+        if (length == 0) {
+            return;
+        }
+        Container& container = delta.get();
+        Unsigned previous = 0;
+        deserialize_fixed(previous);
+        details::reserve_silent(container, std::size(container) + length);
+        details::insert(container, static_cast<Element>(previous));
+        deserialize_packed(container, length - 1, [&previous] (Unsigned* values, size_t count) {
+            if constexpr (sizeof(Unsigned) == sizeof(std::uint32_t)) {
+                previous = details::bit_pack_kernels().delta_decode32(reinterpret_cast<unsigned char*>(values), count, previous);
+            } else if constexpr (sizeof(Unsigned) == sizeof(std::uint64_t)) {
+                previous = details::bit_pack_kernels().delta_decode64(reinterpret_cast<unsigned char*>(values), count, previous);
+            } else {
+                // a local sum, as `values` could alias `previous` and force a store per element
+                Unsigned sum = previous;
+                for (size_t i = 0; i < count; ++i) {
+                    sum = static_cast<Unsigned>(sum + details::from_zigzag(values[i]));
+                    values[i] = sum;
+                }
+                previous = sum;
+            }
+        });
+    }
+
+    /// Elements are appended to the wrapped container, fields of columns left out by `only` keep default values
+    template<typename Container>
+    void deserialize(Columnar<Container> columnar) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        static_assert(std::is_default_constructible_v<Element> && traits::has_resize_v<Container>,
+                      "Columnar elements are decoded in place into a resized container");
+        Container& container = columnar.get();
+        const size_t length = static_cast<size_t>(deserialize_length());
+        const size_t first = std::size(container);
+        container.resize(first + length);
+        const auto begin = std::next(std::begin(container), static_cast<std::ptrdiff_t>(first));
+        size_t column = 0;
+        details::for_each_tuple_element<0, details::column_count_v<Element>>(details::column_fields<Element>(), [&] (const auto& field) {
+            if (columnar.is_selected(column++)) {
+                deserialize_column(begin, length, field);
+            } else {
+                skip<std::vector<details::column_type_t<Element, std::decay_t<decltype(field)>>>>();
+            }
+        });
+    }
+
+    /// Decodes an `Indexed` container with an execution policy such as `archive::parallel`.
+    /// Chunks are decoded concurrently straight from the storage memory, so other storages are read sequentially
+    template<typename Container, typename ExecutionPolicy>
+    std::enable_if_t<traits::is_execution_policy_v<ExecutionPolicy>> deserialize(Indexed<Container> indexed, const ExecutionPolicy& policy) {
+        if constexpr (traits::is_contiguous_storage_v<Storage>) {
+            IndexedView<traits::remove_const_element_type_t<Container>, Encoding, ByteOrder> view;
+            deserialize(view);
+            policy.deserialize_chunks(view, indexed.get());
+        } else {
+            deserialize(indexed);
+        }
     }
 
     template<typename Optional>
@@ -421,33 +2753,995 @@ struct BinaryArchive : public StoragePolicy<Storage> {
         deserialize(has_value);
 
         if (has_value) {
-            std::remove_reference_t<decltype(*optional)> value;
-            deserialize(value);
-            optional = std::move(value);
+            using Value = std::remove_reference_t<decltype(*optional)>;
+            if constexpr (details::is_archive_constructible_v<Value, BinaryArchive>) {
+                optional.emplace(from_archive, *this);
+            } else {
+                auto value = make_value<Value>();
+                deserialize(value);
+                optional = std::move(value);
+            }
         } else {
             optional.reset();
         }
     }
 
 
+    /// Reads a pointer, creating new objects. Objects read through raw pointers are owned by the object
+    /// table, or by the caller without one. Throws `std::system_error` for back-references that cannot
+    /// be resolved: read without a table, unknown or of another type, from a `std::unique_ptr`, or from
+    /// a `std::shared_ptr` to an object owned by a `std::unique_ptr`
+    template<typename Pointer>
+    std::enable_if_t<traits::is_pointer_v<Pointer>> deserialize(Pointer& pointer) {
+        deserialize_pointer(pointer, [this] (auto& object) { deserialize(object); });
+    }
+
+    /// Pointer decoding with the object read by `read(object)`, see `serialize_pointer`
+    template<typename Pointer, typename Read>
+    void deserialize_pointer(Pointer& pointer, Read&& read) {
+        using Object = std::remove_const_t<details::pointee_t<Pointer>>;
+        if constexpr (details::is_instance_of_v<Pointer, std::weak_ptr>) {
+            std::shared_ptr<details::pointee_t<Pointer>> shared;
+            deserialize_pointer(shared, read);
+            pointer = shared;
+            return;
+        } else {
+            const std::uint64_t code = deserialize_varint();
+            if (code == ObjectTable::Null) {
+                pointer = nullptr;
+            } else if (code != ObjectTable::New) {
+                if (!object_table) {
+                    details::throw_pointer_error(std::errc::illegal_byte_sequence, "archive: pointer back-reference without an object table");
+                }
+                const ObjectTable::Object& object = object_table->find(code, &details::type_tag<Object>);
+                Object* address = static_cast<Object*>(object.address);
+                if constexpr (details::is_instance_of_v<Pointer, std::shared_ptr>) {
+                    if (!object.owner) {
+                        details::throw_pointer_error(std::errc::illegal_byte_sequence, "archive: std::shared_ptr to an object owned by a std::unique_ptr");
+                    }
+                    pointer = std::shared_ptr<Object>(object.owner, address);
+                } else if constexpr (details::is_instance_of_v<Pointer, std::unique_ptr>) {
+                    details::throw_pointer_error(std::errc::illegal_byte_sequence, "archive: std::unique_ptr to an object read before");
+                } else {
+                    pointer = address;
+                }
+            } else {
+                const size_t id = object_table ? object_table->reserve(&details::type_tag<Object>) : ObjectTable::npos;
+                if constexpr (details::is_instance_of_v<Pointer, std::shared_ptr>) {
+                    pointer = create_pointee<std::shared_ptr<Object>>(id, read);
+                } else if constexpr (details::is_instance_of_v<Pointer, std::unique_ptr>) {
+                    pointer = create_pointee<std::unique_ptr<Object>>(id, read);
+                } else if (object_table) {
+                    pointer = create_pointee<std::shared_ptr<Object>>(id, read).get();
+                } else {
+                    pointer = create_pointee<std::unique_ptr<Object>>(id, read).release();
+                }
+            }
+        }
+    }
+
+    /// Returns deserialized object, created with the archive memory resource if it is allocator-aware
+    /// or by its `from_archive_t` constructor
+    template<typename T>
+    T deserialize() {
+        if constexpr (details::is_archive_constructible_v<T, BinaryArchive>) {
+            return T(from_archive, *this);
+        } else {
+            T object = make_value<T>();
+            deserialize(object);
+            return object;
+        }
+    }
+
     template<typename T, size_t N>
     void deserialize(T(&array)[N]) {
-        usize size = 0;
-        deserialize(size);
+        const usize size = deserialize_length();
 		ARCHIVE_ASSERT(size == N);
-        for (usize i = 0; i < N; ++i) {
-            deserialize(array[i]);
+        (void)(size);
+        if constexpr (is_varint_run_v<T>) {
+            T* out = array;
+            deserialize_varint_run<T>(N, [&out] (T value) { *out++ = value; });
+        } else if constexpr (traits::is_primitive_v<T>) {
+            deserialize_contiguous(array, N);
+        } else {
+            for (usize i = 0; i < N; ++i) {
+                deserialize(array[i]);
+            }
+        }
+    }
+
+    /// ===== Skip =====
+
+    /// Moves past a value of type `T` without creating it. Its extent comes from the type and length
+    /// prefixes: fixed-size values and containers of primitives or fixed-size elements are skipped at once,
+    /// other nested types are walked through their lengths. Storages with `advance` are not read at all.
+    /// Types with user-defined serialization are decoded into a temporary, as their layout is unknown
+    template<typename T>
+    void skip() {
+        using Type = std::remove_cv_t<T>;
+        if constexpr (traits::is_primitive_v<Type>) {
+            if constexpr (Encoding::varint_integers && traits::is_varint_integer_v<Type>) {
+                skip_varint();
+            } else {
+                skip_bytes(sizeof(Type));
+            }
+        } else if constexpr (traits::has_static_size_v<Type> && !Encoding::varint_integers) {
+            skip_bytes(traits::static_size<Type>::value);
+        } else if constexpr (traits::is_container_v<Type>) {
+            if constexpr (details::is_dictionary_string_v<Type>) {
+                if (string_dictionary) {
+                    const std::uint64_t code = deserialize_varint();
+                    if (code == StringDictionary::Added) {
+                        deserialize_interned(code);  // later references need the entry
+                    }
+                    if (code != StringDictionary::Literal) {
+                        return;
+                    }
+                }
+            }
+            skip_sequence<traits::remove_const_element_type_t<Type>>();
+        } else if constexpr (std::is_array_v<Type>) {
+            skip_sequence<std::remove_cv_t<std::remove_extent_t<Type>>>();
+        } else if constexpr (traits::is_tuple_like_v<Type>) {
+            if constexpr (Encoding::varint_integers && traits::is_contiguous_varint_integer_v<Type>) {
+                skip_bytes(static_cast<size_t>(deserialize_varint()));
+            } else {
+                skip_elements<Type>(std::make_index_sequence<std::tuple_size<Type>::value>{});
+            }
+        } else if constexpr (traits::is_optional_v<Type>) {
+            bool has_value = false;
+            deserialize(has_value);
+            if (has_value) {
+                skip<typename Type::value_type>();
+            }
+        } else if constexpr (traits::is_pointer_v<Type>) {
+            using Object = std::remove_const_t<details::pointee_t<Type>>;
+            if (object_table) {
+                // read to keep ids in sync, the table owns the object and a raw pointer refers back to any owner
+                Object* skipped = nullptr;
+                deserialize(skipped);
+            } else if (const std::uint64_t code = deserialize_varint(); code == ObjectTable::New) {
+                skip<Object>();
+            } else if (code != ObjectTable::Null) {
+                details::throw_pointer_error(std::errc::illegal_byte_sequence, "archive: pointer back-reference without an object table");
+            }
+        } else if constexpr (details::is_instance_of_v<Type, Lazy>) {
+            skip_bytes(static_cast<size_t>(deserialize_length()));
+        } else if constexpr (details::is_instance_of_v<Type, Indexed>) {
+            const size_t length = static_cast<size_t>(deserialize_length());
+            const size_t stride = static_cast<size_t>(deserialize_length());
+            ARCHIVE_ASSERT(stride > 0);
+            skip_bytes((length + stride - 1) / stride * sizeof(std::uint64_t));
+            std::uint64_t elements = 0;
+            deserialize_fixed(elements);
+            skip_bytes(static_cast<size_t>(elements));
+        } else if constexpr (details::is_instance_of_v<Type, Packed> || details::is_instance_of_v<Type, Delta>) {
+            using Unsigned = std::make_unsigned_t<traits::remove_const_element_type_t<typename Type::container_type>>;
+            size_t length = static_cast<size_t>(deserialize_length());
+            if constexpr (details::is_instance_of_v<Type, Delta>) {
+                if (length == 0) {
+                    return;
+                }
+                skip_bytes(sizeof(Unsigned));
+                --length;
+            }
+            for (size_t done = 0; done < length; done += details::packed_block_size) {
+                Unsigned reference = 0;
+                std::uint8_t width = 0;
+                deserialize_fixed(reference);
+                deserialize_fixed(width);
+                skip_bytes(details::packed_bytes(std::min(length - done, details::packed_block_size), std::min<unsigned>(width, 8 * sizeof(Unsigned))));
+            }
+        } else if constexpr (details::is_instance_of_v<Type, Columnar>) {
+            using Element = traits::remove_const_element_type_t<typename Type::container_type>;
+            deserialize_length();
+            details::for_each_tuple_element<0, details::column_count_v<Element>>(details::column_fields<Element>(), [this] (const auto& field) {
+                skip<std::vector<details::column_type_t<Element, std::decay_t<decltype(field)>>>>();
+            });
+        } else if constexpr (details::is_instance_of_v<Type, std::basic_string_view>) {
+            skip<std::basic_string<typename Type::value_type, typename Type::traits_type>>();
+        } else if constexpr (details::is_instance_of_v<Type, View>) {
+            skip_sequence<typename Type::value_type>();
+        } else {
+            [[maybe_unused]] Type skipped = deserialize<Type>();
+        }
+    }
+
+private:
+    template<typename, typename, typename>
+    friend class IndexedView;
+
+    std::pmr::memory_resource* memory_resource = nullptr;
+    StringDictionary* string_dictionary = nullptr;
+    ObjectTable* object_table = nullptr;
+
+    /// Detaches the string dictionary and the object table while nested encodings decoded by other
+    /// archives are written or read
+    class SessionPause {
+    public:
+        explicit SessionPause(BinaryArchive& archive_)
+            : archive(archive_)
+            , dictionary(archive_.string_dictionary)
+            , table(archive_.object_table)
+        {
+            archive.string_dictionary = nullptr;
+            archive.object_table = nullptr;
+        }
+
+        ~SessionPause() {
+            archive.string_dictionary = dictionary;
+            archive.object_table = table;
+        }
+
+        SessionPause(const SessionPause&) = delete;
+        SessionPause& operator=(const SessionPause&) = delete;
+
+    private:
+        BinaryArchive& archive;
+        StringDictionary* dictionary;
+        ObjectTable* table;
+    };
+
+    /// Creates the object of a new pointer and registers it under `id` before reading its fields, so
+    /// pointers back to it inside resolve. Types constructed from the archive are registered once read
+    template<typename Owner, typename Read>
+    Owner create_pointee(size_t id, Read& read) {
+        using Object = typename Owner::element_type;
+        constexpr bool shared = details::is_instance_of_v<Owner, std::shared_ptr>;
+        Owner object;
+        constexpr bool constructible = details::is_archive_constructible_v<Object, BinaryArchive>;
+        if constexpr (shared && constructible) {
+            object = std::make_shared<Object>(from_archive, *this);
+        } else if constexpr (constructible) {
+            object = std::make_unique<Object>(from_archive, *this);
+        } else if constexpr (shared) {
+            object = std::make_shared<Object>();
+        } else {
+            object = std::make_unique<Object>();
+        }
+        if (id != ObjectTable::npos) {
+            if constexpr (shared) {
+                object_table->set(id, object.get(), object);
+            } else {
+                object_table->set(id, object.get(), nullptr);
+            }
+        }
+        if constexpr (!constructible) {
+            read(*object);
+        }
+        return object;
+    }
+
+    /// Writes a varint code from the dictionary, followed by the characters unless it is a reference
+    usize serialize_interned(std::string_view value) {
+        const std::uint64_t code = string_dictionary->encode(value);
+        usize size = serialize_varint(code);
+        if (code < StringDictionary::First) {
+            size += serialize_length(value.size()) + serialize_contiguous(value.data(), value.size());
+        }
+        return size;
+    }
+
+    /// Reads the string of a non-literal `code`: a new entry is read into the dictionary, a reference is looked up
+    std::string_view deserialize_interned(std::uint64_t code) {
+        if (code != StringDictionary::Added) {
+            return string_dictionary->find(code);
+        }
+        const size_t size = static_cast<size_t>(deserialize_length());
+        char* data = string_dictionary->add(size);
+        deserialize_contiguous(data, size);
+        return std::string_view(data, size);
+    }
+
+    /// Creates an object using archive memory resource if it is set and the type supports it
+    template<typename T>
+    T make_value() {
+        return details::make_value<T>(memory_resource);
+    }
+
+    /// Creates an element of `container` propagating container allocator into it
+    template<typename T, typename Container>
+    T make_element(Container& container) {
+        return details::make_element<T>(container, memory_resource);
+    }
+
+    /// Primitives that are stored in the archive exactly as in memory, so they can be viewed in place
+    template<typename T>
+    static constexpr bool is_viewable_v = traits::is_primitive_v<T>
+            && (sizeof(T) == 1 || (!ByteOrder::swap && !(Encoding::varint_integers && traits::is_varint_integer_v<T>)));
+
+    /// Returns pointer to the next `size` bytes of a contiguous storage and skips them
+    const unsigned char* deserialize_view(size_t size) {
+        static_assert(traits::is_contiguous_storage_v<Storage>, "Zero-copy deserialization requires a contiguous storage");
+        Storage& storage = get_storage();
+        const unsigned char* data = storage.data() + storage.read_position();
+        storage.advance(size);
+        return data;
+    }
+
+    /// Skips `size` bytes, reading them into a scratch chunk if the storage cannot advance
+    void skip_bytes(size_t size) {
+        if constexpr (traits::has_advance_v<Storage>) {
+            get_storage().advance(size);
+        } else {
+            unsigned char chunk[details::chunk_size];
+            while (size > 0) {
+                const size_t count = std::min(size, sizeof(chunk));
+                get_storage().read(chunk, count);
+                size -= count;
+            }
+        }
+    }
+
+    void skip_varint() {
+        unsigned char byte = 0x80;
+        for (size_t i = 0; i < details::max_varint_size && (byte & 0x80); ++i) {
+            get_storage().read(&byte, 1);
+        }
+    }
+
+    /// Skips a length-prefixed sequence of `Element`, as written for containers
+    template<typename Element>
+    void skip_sequence() {
+        const size_t length = static_cast<size_t>(deserialize_length());
+        if constexpr (is_varint_run_v<Element>) {
+            skip_bytes(static_cast<size_t>(deserialize_varint()));
+        } else if constexpr (traits::is_primitive_v<Element>) {
+            skip_bytes(length * sizeof(Element));
+        } else if constexpr (traits::has_static_size_v<Element> && !Encoding::varint_integers) {
+            skip_bytes(length * traits::static_size<Element>::value);
+        } else {
+            for (size_t i = 0; i < length; ++i) {
+                skip<Element>();
+            }
+        }
+    }
+
+    template<typename Gettable, size_t... I>
+    void skip_elements(std::index_sequence<I...>) {
+        (skip<std::tuple_element_t<I, Gettable>>(), ...);
+    }
+
+    /// Writes elements one after another as standalone objects, without a length
+    template<typename Container>
+    usize serialize_each(const Container& container) {
+        using Element = traits::element_type_t<Container>;
+        if constexpr (traits::is_contiguous_primitive_v<Container> && !is_varint_run_v<Element>) {
+            return serialize_contiguous(std::data(container), std::size(container));
+        } else {
+            if constexpr (is_block_v<Element> && traits::is_contiguous_v<Container>) {
+                return serialize_block(std::data(container), std::size(container));
+            } else if constexpr (is_gathered_v<Element>) {
+                return serialize_gathered(std::begin(container), std::size(container));
+            }
+            usize size = 0;
+            for (auto&& e: container) {
+                size += serialize(e);
+            }
+            return size;
+        }
+    }
+
+    /// Appends `count` elements written by `serialize_each` to `container`
+    template<typename Container>
+    void deserialize_each(Container& container, size_t count) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        if constexpr (traits::is_contiguous_primitive_v<Container> && traits::has_resize_v<Container> && !is_varint_run_v<Element>) {
+            const size_t first = std::size(container);
+            container.resize(first + count);
+            deserialize_contiguous(std::data(container) + first, count);
+        } else {
+            if constexpr (is_block_v<Element> && traits::is_contiguous_v<Container> && traits::has_resize_v<Container>
+                    && std::is_default_constructible_v<Element>) {
+                const size_t first = std::size(container);
+                container.resize(first + count);
+                deserialize_block(std::data(container) + first, count);
+                return;
+            } else if constexpr (is_gathered_v<Element> && std::is_default_constructible_v<Element>) {
+                deserialize_gathered(container, count);
+                return;
+            }
+            details::reserve_silent(container, std::size(container) + count);
+            deserialize_elements(container, count);
+        }
+    }
+
+    /// Appends `count` elements to `container` constructing them in place: sequences decode into
+    /// `emplace_back`-ed elements, maps decode the key and then the value inside the new node,
+    /// types with the `from_archive_t` constructor are built by it. Other elements (set keys,
+    /// containers without emplace) are decoded into a temporary that is moved in
+    template<typename Container>
+    void deserialize_elements(Container& container, size_t count) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        for (size_t i = 0; i < count; ++i) {
+            if constexpr (traits::is_key_value_v<Container> && traits::has_emplace_hint_v<Container>) {
+                using Mapped = typename Container::mapped_type;
+                auto key = construct_value<std::remove_const_t<typename Container::key_type>>(container);
+                if constexpr (details::is_archive_constructible_v<Mapped, BinaryArchive>) {
+                    container.emplace_hint(container.end(), std::piecewise_construct,
+                                           std::forward_as_tuple(std::move(key)), std::forward_as_tuple(from_archive, *this));
+                } else {
+                    auto it = container.emplace_hint(container.end(), std::piecewise_construct,
+                                                     std::forward_as_tuple(std::move(key)), std::forward_as_tuple());
+                    deserialize(it->second);
+                }
+            } else if constexpr (details::is_archive_constructible_v<Element, BinaryArchive>) {
+                details::emplace(container, from_archive, *this);
+            } else if constexpr (details::emplaces_default_element_v<Container>) {
+                // the container allocator reaches the element through `emplace_back`,
+                // the archive memory resource has to be passed explicitly
+                using Allocator = decltype(container.get_allocator());
+                if constexpr (!std::uses_allocator_v<Element, Allocator> && !traits::is_pair_v<Element>
+                        && std::uses_allocator_v<Element, std::pmr::polymorphic_allocator<std::byte>>) {
+                    if (memory_resource) {
+                        deserialize(container.emplace_back(make_value<Element>()));
+                        continue;
+                    }
+                }
+                deserialize(container.emplace_back());
+            } else {
+                auto e = make_element<Element>(container);
+                deserialize(e);
+                details::emplace(container, std::move(e));
+            }
+        }
+    }
+
+    /// Decodes a standalone object for `container`, by the `from_archive_t` constructor if `T` has one
+    template<typename T, typename Container>
+    T construct_value(Container& container) {
+        if constexpr (details::is_archive_constructible_v<T, BinaryArchive>) {
+            (void)(container);
+            return T(from_archive, *this);
+        } else {
+            T value = make_element<T>(container);
+            deserialize(value);
+            return value;
+        }
+    }
+
+    template<typename T>
+    usize serialize_block(const T* data, size_t length) {
+        if (length == 0) {
+            return 0;
+        }
+        return get_storage().write(reinterpret_cast<const unsigned char*>(data), length * sizeof(T));
+    }
+
+    template<typename T>
+    void deserialize_block(T* data, size_t length) {
+        if (length == 0) {
+            return;
+        }
+        get_storage().read(reinterpret_cast<unsigned char*>(data), length * sizeof(T));
+    }
+
+    /// Integers in containers are written as a run of varints
+    template<typename T>
+    static constexpr bool is_varint_run_v = Encoding::varint_integers && traits::is_varint_integer_v<std::remove_const_t<T>>;
+
+    /// Writes primitive as is, converting it to archive byte order
+    template<typename Primitive>
+    usize serialize_fixed(Primitive primitive) {
+        if constexpr (ByteOrder::swap && sizeof(Primitive) > 1) {
+            primitive = details::byteswap(primitive);
+        }
+        return get_storage().write(reinterpret_cast<const unsigned char*>(&primitive), sizeof(Primitive));
+    }
+
+    template<typename Primitive>
+    void deserialize_fixed(Primitive& primitive) {
+        get_storage().read(reinterpret_cast<unsigned char*>(&primitive), sizeof(Primitive));
+        if constexpr (ByteOrder::swap && sizeof(Primitive) > 1) {
+            primitive = details::byteswap(primitive);
+        }
+    }
+
+    usize serialize_varint(std::uint64_t value) {
+        unsigned char buffer[details::max_varint_size];
+        return get_storage().write(buffer, details::encode_varint(value, buffer));
+    }
+
+    std::uint64_t deserialize_varint() {
+        std::uint64_t value = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7) {
+            unsigned char byte = 0;
+            get_storage().read(&byte, 1);
+            value |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+
+    usize serialize_length(usize length) {
+        if constexpr (Encoding::varint_lengths) {
+            return serialize_varint(length);
+        } else {
+            return serialize_fixed(length);
+        }
+    }
+
+    usize deserialize_length() {
+        if constexpr (Encoding::varint_lengths) {
+            return deserialize_varint();
+        } else {
+            usize length = 0;
+            deserialize_fixed(length);
+            return length;
+        }
+    }
+
+    /// Writes `length` integers starting at `it` as varints prefixed by their total byte size,
+    /// so that reader can fetch them in large chunks
+    template<typename Iterator>
+    usize serialize_varint_run(Iterator it, size_t length) {
+        usize bytes = 0;
+        Iterator counter = it;
+        for (size_t i = 0; i < length; ++i, ++counter) {
+            bytes += details::varint_size(details::to_varint(*counter));
+        }
+        const usize size = serialize_varint(bytes) + bytes;
+
+        unsigned char chunk[details::chunk_size + details::max_varint_size];
+        size_t used = 0;
+        for (size_t i = 0; i < length; ++i, ++it) {
+            used += details::encode_varint(details::to_varint(*it), chunk + used);
+            if (used >= details::chunk_size) {
+                get_storage().write(chunk, used);
+                used = 0;
+            }
+        }
+        if (used) {
+            get_storage().write(chunk, used);
+        }
+        return size;
+    }
+
+    /// Reads a run written by `serialize_varint_run` chunk by chunk, calling `emit(Integer)` for each value
+    template<typename Integer, typename Emit>
+    void deserialize_varint_run(size_t count, Emit&& emit) {
+        usize remaining = deserialize_varint();
+
+        unsigned char chunk[details::chunk_size + details::max_varint_size];
+        size_t pending = 0;
+        while (count > 0 && (remaining > 0 || pending > 0)) {
+            const size_t to_read = static_cast<size_t>(std::min<usize>(remaining, details::chunk_size));
+            get_storage().read(chunk + pending, to_read);
+            remaining -= to_read;
+
+            const unsigned char* end = chunk + pending + to_read;
+            // unless this is the last chunk, the varint at the end may be cut, leave it for the next chunk
+            const unsigned char* limit = remaining ? end - details::max_varint_size : end;
+            const unsigned char* data = details::decode_varint_run<Integer>(chunk, limit, end, count, emit);
+
+            pending = static_cast<size_t>(end - data);
+            std::memmove(chunk, data, pending);
+            if (!remaining) {
+                break;
+            }
+        }
+        ARCHIVE_ASSERT(count == 0);
+    }
+
+    /// Writes `length` elements starting at `it` field by field, gathered into stack chunks
+    template<typename Iterator>
+    usize serialize_gathered(Iterator it, size_t length) {
+        using Element = std::remove_const_t<std::remove_reference_t<decltype(*it)>>;
+        constexpr size_t chunk_length = details::chunk_size / sizeof(Element);
+        unsigned char chunk[chunk_length * sizeof(Element)];
+        usize size = 0;
+        for (size_t done = 0; done < length; done += chunk_length) {
+            const size_t count = std::min(chunk_length, length - done);
+            for (size_t i = 0; i < count; ++i, ++it) {
+                details::store_fields(*it, chunk + i * sizeof(Element));
+            }
+            size += get_storage().write(chunk, count * sizeof(Element));
+        }
+        return size;
+    }
+
+    /// Appends `count` elements written by `serialize_gathered` to `container`, reading a chunk at a time
+    template<typename Container>
+    void deserialize_gathered(Container& container, size_t count) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        constexpr bool resizable = traits::is_contiguous_v<Container> && traits::has_resize_v<Container>;
+        constexpr size_t chunk_length = details::chunk_size / sizeof(Element);
+        unsigned char chunk[chunk_length * sizeof(Element)];
+        size_t first = std::size(container);
+        if constexpr (resizable) {
+            container.resize(first + count);
+        } else {
+            details::reserve_silent(container, first + count);
+        }
+        for (size_t done = 0; done < count; done += chunk_length) {
+            const size_t size = std::min(chunk_length, count - done);
+            get_storage().read(chunk, size * sizeof(Element));
+            for (size_t i = 0; i < size; ++i) {
+                if constexpr (resizable) {
+                    details::load_fields(std::data(container)[first + done + i], chunk + i * sizeof(Element));
+                } else {
+                    Element element {};
+                    details::load_fields(element, chunk + i * sizeof(Element));
+                    details::insert(container, element);
+                }
+            }
+        }
+    }
+
+    /// Writes `field` of every element exactly as a `std::vector` of the field would be written.
+    /// Primitives are gathered into stack chunks written with one storage call each, or into a varint run
+    template<typename Container, typename Field>
+    usize serialize_column(const Container& container, size_t length, const Field& field) {
+        using Value = details::column_type_t<const traits::remove_const_element_type_t<Container>, Field>;
+        if constexpr (traits::is_primitive_v<Value> && !is_varint_run_v<Value>) {
+            constexpr size_t chunk_length = details::chunk_size / sizeof(Value);
+            Value chunk[chunk_length];
+            usize size = serialize_length(length);
+            size_t used = 0;
+            for (const auto& e: container) {
+                chunk[used++] = std::invoke(field, e);
+                if (used == chunk_length) {
+                    size += serialize_contiguous(chunk, used);
+                    used = 0;
+                }
+            }
+            return size + serialize_contiguous(chunk, used);
+        } else if constexpr (traits::is_primitive_v<Value>) {
+            std::vector<Value> column;
+            column.reserve(length);
+            for (const auto& e: container) {
+                column.push_back(std::invoke(field, e));
+            }
+            return serialize(column);
+        } else {
+            usize size = serialize_length(length);
+            for (const auto& e: container) {
+                size += serialize(std::invoke(field, e));
+            }
+            return size;
+        }
+    }
+
+    /// Reads a column written by `serialize_column` into `field` of `length` elements starting at `it`
+    template<typename Iterator, typename Field>
+    void deserialize_column(Iterator it, size_t length, const Field& field) {
+        using Value = details::column_type_t<std::remove_reference_t<decltype(*it)>, Field>;
+        if constexpr (is_viewable_v<Value> && traits::is_contiguous_storage_v<Storage>) {
+            const size_t count = std::min(length, static_cast<size_t>(deserialize_length()));
+            const unsigned char* data = deserialize_view(count * sizeof(Value));
+            for (size_t i = 0; i < count; ++i, ++it) {
+                std::memcpy(&std::invoke(field, *it), data + i * sizeof(Value), sizeof(Value));
+            }
+        } else if constexpr (traits::is_primitive_v<Value>) {
+            std::vector<Value> column;
+            deserialize(column);
+            ARCHIVE_ASSERT(column.size() == length);
+            for (size_t i = 0; i < std::min(length, column.size()); ++i, ++it) {
+                std::invoke(field, *it) = column[i];
+            }
+        } else {
+            const size_t count = static_cast<size_t>(deserialize_length());
+            ARCHIVE_ASSERT(count == length);
+            for (size_t i = 0; i < std::min(length, count); ++i, ++it) {
+                deserialize(std::invoke(field, *it));
+            }
+        }
+    }
+
+    /// Writes up to 256 unsigned values as one frame-of-reference block: the minimum, the bit width
+    /// of the largest offset from it and the offsets packed with that width
+    template<typename Unsigned>
+    usize serialize_packed_block(const Unsigned* values, size_t count) {
+        Unsigned reference = values[0];
+        Unsigned top = values[0];
+        for (size_t i = 1; i < count; ++i) {
+            reference = std::min(reference, values[i]);
+            top = std::max(top, values[i]);
+        }
+        const unsigned bits = details::bit_width(static_cast<Unsigned>(top - reference));
+        const usize size = serialize_fixed(reference) + serialize_fixed(static_cast<std::uint8_t>(bits));
+
+        unsigned char packed[details::packed_block_size * sizeof(std::uint64_t) + 8];
+        const size_t bytes = details::packed_bytes(count, bits);
+        if (count == details::packed_block_size) {
+            const details::BitPackKernels& kernels = details::bit_pack_kernels();
+            std::uint32_t words[details::packed_block_size];
+            for (size_t i = 0; i < count; ++i) {
+                words[i] = static_cast<std::uint32_t>(static_cast<Unsigned>(values[i] - reference));
+            }
+            kernels.pack[std::min(bits, 32u)](reinterpret_cast<const unsigned char*>(words), packed);
+            if constexpr (sizeof(Unsigned) == sizeof(std::uint64_t)) {
+                // wider offsets are split into a plane of low words and a plane of high ones
+                if (bits > 32) {
+                    for (size_t i = 0; i < count; ++i) {
+                        words[i] = static_cast<std::uint32_t>((values[i] - reference) >> 32);
+                    }
+                    kernels.pack[bits - 32](reinterpret_cast<const unsigned char*>(words), packed + details::packed_bytes(count, 32));
+                }
+            }
+        } else {
+            std::uint64_t offsets[details::packed_block_size];
+            for (size_t i = 0; i < count; ++i) {
+                offsets[i] = static_cast<Unsigned>(values[i] - reference);
+            }
+            std::memset(packed, 0, bytes + 8);
+            details::pack_bits(offsets, count, bits, packed);
+        }
+        return bytes > 0 ? size + get_storage().write(packed, bytes) : size;
+    }
+
+    /// Reads a block written by `serialize_packed_block` into `out`. Full blocks of a contiguous storage
+    /// are unpacked straight from its memory
+    template<typename Unsigned>
+    void deserialize_packed_block(size_t count, Unsigned* out) {
+        Unsigned reference = 0;
+        std::uint8_t width = 0;
+        deserialize_fixed(reference);
+        deserialize_fixed(width);
+        ARCHIVE_ASSERT(width <= 8 * sizeof(Unsigned));
+        const unsigned bits = std::min<unsigned>(width, 8 * sizeof(Unsigned));
+        const size_t bytes = details::packed_bytes(count, bits);
+
+        unsigned char buffer[details::packed_block_size * sizeof(std::uint64_t) + 8];
+        const unsigned char* packed = buffer;
+        if (count == details::packed_block_size) {
+            if constexpr (traits::is_contiguous_storage_v<Storage>) {
+                packed = deserialize_view(bytes);
+            } else if (bytes > 0) {
+                get_storage().read(buffer, bytes);
+            }
+            const details::BitPackKernels& kernels = details::bit_pack_kernels();
+            if constexpr (sizeof(Unsigned) == sizeof(std::uint32_t)) {
+                kernels.unpack[bits](packed, reinterpret_cast<unsigned char*>(out));
+                if (reference != 0) {
+                    for (size_t i = 0; i < count; ++i) {
+                        out[i] += reference;
+                    }
+                }
+            } else {
+                std::uint32_t words[details::packed_block_size];
+                kernels.unpack[std::min(bits, 32u)](packed, reinterpret_cast<unsigned char*>(words));
+                if constexpr (sizeof(Unsigned) == sizeof(std::uint64_t)) {
+                    if (bits > 32) {
+                        std::uint32_t high[details::packed_block_size];
+                        kernels.unpack[bits - 32](packed + details::packed_bytes(count, 32), reinterpret_cast<unsigned char*>(high));
+                        for (size_t i = 0; i < count; ++i) {
+                            out[i] = reference + (std::uint64_t(high[i]) << 32 | words[i]);
+                        }
+                        return;
+                    }
+                }
+                for (size_t i = 0; i < count; ++i) {
+                    out[i] = static_cast<Unsigned>(reference + words[i]);
+                }
+            }
+        } else {
+            if (bytes > 0) {
+                get_storage().read(buffer, bytes);
+            }
+            std::memset(buffer + bytes, 0, 8);
+            std::uint64_t offsets[details::packed_block_size];
+            details::unpack_bits(buffer, count, bits, offsets);
+            for (size_t i = 0; i < count; ++i) {
+                out[i] = static_cast<Unsigned>(reference + offsets[i]);
+            }
+        }
+    }
+
+    /// Appends `count` values written as packed blocks to `container`. `convert(values, size)` maps
+    /// the unsigned values of each block to the bits of the elements in place
+    template<typename Container, typename Convert>
+    void deserialize_packed(Container& container, size_t count, Convert&& convert) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        using Unsigned = std::make_unsigned_t<Element>;
+        if constexpr (traits::is_contiguous_v<Container> && traits::has_resize_v<Container>) {
+            const size_t first = std::size(container);
+            container.resize(first + count);
+            // signed and unsigned variants of an integer may alias
+            auto* out = reinterpret_cast<Unsigned*>(std::data(container) + first);
+            for (size_t done = 0; done < count; done += details::packed_block_size) {
+                const size_t size = std::min(count - done, details::packed_block_size);
+                deserialize_packed_block(size, out + done);
+                convert(out + done, size);
+            }
+        } else {
+            details::reserve_silent(container, std::size(container) + count);
+            Unsigned block[details::packed_block_size];
+            for (size_t done = 0; done < count; done += details::packed_block_size) {
+                const size_t size = std::min(count - done, details::packed_block_size);
+                deserialize_packed_block(size, block);
+                convert(block, size);
+                for (size_t i = 0; i < size; ++i) {
+                    details::insert(container, static_cast<Element>(block[i]));
+                }
+            }
+        }
+    }
+
+    /// Writes `length` primitives stored contiguously at `data` with a single storage call.
+    /// If byte order has to be converted, elements are swapped into a stack chunk first
+    template<typename Primitive>
+    usize serialize_contiguous(const Primitive* data, size_t length) {
+        if (length == 0) {
+            return 0;
+        }
+        const auto* bytes = reinterpret_cast<const unsigned char*>(data);
+        if constexpr (ByteOrder::swap && sizeof(Primitive) > 1) {
+            constexpr size_t chunk_length = details::chunk_size / sizeof(Primitive);
+            unsigned char chunk[chunk_length * sizeof(Primitive)];
+            usize size = 0;
+            for (size_t done = 0; done < length; done += chunk_length) {
+                const size_t count = std::min(chunk_length, length - done);
+                details::byteswap_elements<sizeof(Primitive)>(chunk, bytes + done * sizeof(Primitive), count);
+                size += get_storage().write(chunk, count * sizeof(Primitive));
+            }
+            return size;
+        } else {
+            return get_storage().write(bytes, length * sizeof(Primitive));
+        }
+    }
+
+    /// Reads `length` primitives straight into contiguous memory at `data` with a single storage call
+    /// and converts their byte order in place if needed
+    template<typename Primitive>
+    void deserialize_contiguous(Primitive* data, size_t length) {
+        if (length == 0) {
+            return;
+        }
+        auto* bytes = reinterpret_cast<unsigned char*>(data);
+        get_storage().read(bytes, length * sizeof(Primitive));
+        if constexpr (ByteOrder::swap && sizeof(Primitive) > 1) {
+            details::byteswap_elements<sizeof(Primitive)>(bytes, bytes, length);
         }
     }
 };
 
 
-enum class Direction {
-    Deserialize,
-    Serialize,
-    Bidirectional,
+/// Random access to an `Indexed` container in a contiguous storage. `archive.deserialize(view)`
+/// only reads the header, elements are decoded on demand from the storage memory, which must outlive the view.
+/// Encoding and byte order have to match the archive it is read from
+template<typename T, typename Encoding = encoding::Fixed, typename ByteOrder = byte_order::Native>
+class IndexedView {
+public:
+    using value_type = T;
+    /// Archive reading elements starting at a chunk
+    using ChunkArchive = BinaryArchive<storage::MemoryReader, storage_policy::Inline, Encoding, ByteOrder>;
+
+    size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    size_t stride() const { return chunk_stride; }
+    size_t chunk_count() const { return chunks; }
+    /// Number of elements in `chunk`
+    size_t chunk_length(size_t chunk) const { return std::min(chunk_stride, length - chunk * chunk_stride); }
+
+    /// Archive positioned at the first element of `chunk`, using the memory resource of the source archive
+    ChunkArchive chunk_archive(size_t chunk) const {
+        const size_t begin = offset(chunk);
+        ChunkArchive archive(elements + begin, offset(chunks) - begin);
+        archive.set_memory_resource(memory_resource);
+        return archive;
+    }
+
+    /// Appends elements of `chunk` to `container`
+    template<typename Container>
+    void read_chunk(size_t chunk, Container& container) const {
+        chunk_archive(chunk).deserialize_each(container, chunk_length(chunk));
+    }
+
+    /// Decodes element `index`, the elements before it in its chunk are skipped
+    T at(size_t index) const {
+        ARCHIVE_ASSERT(index < length);
+        ChunkArchive archive = chunk_archive(index / chunk_stride);
+        for (size_t i = index % chunk_stride; i > 0; --i) {
+            archive.template skip<T>();
+        }
+        return archive.template deserialize<T>();
+    }
+    T operator[](size_t index) const { return at(index); }
+
+private:
+    template<typename S, template<typename> class P, typename E, typename B>
+    friend struct BinaryArchive;
+
+    /// Byte offset of `chunk` from the first element
+    size_t offset(size_t chunk) const {
+        std::uint64_t value;
+        std::memcpy(&value, table + chunk * sizeof(value), sizeof(value));
+        if constexpr (ByteOrder::swap) {
+            value = details::byteswap(value);
+        }
+        return static_cast<size_t>(value);
+    }
+
+    const unsigned char* table = nullptr;
+    const unsigned char* elements = nullptr;
+    size_t length = 0;
+    size_t chunk_stride = 1;
+    size_t chunks = 0;
+    std::pmr::memory_resource* memory_resource = nullptr;
+};
+
+
+/// Value that is decoded on first access. Written as [byte size][value], so readers skip it
+/// without decoding and untouched values are re-serialized by copying their bytes.
+///    struct Message { int id; archive::Lazy<std::vector<Attachment>> attachments; };
+///    if (wanted(message.id)) use(*message.attachments);
+/// Decoding happens in `get()`, so a `Lazy` must not be accessed from several threads at once
+template<typename T>
+class Lazy {
+public:
+    using value_type = T;
+
+    Lazy() : value(std::in_place) {}
+    Lazy(T value_) : value(std::move(value_)) {}
+
+    Lazy& operator=(T value_) {
+        value = std::move(value_);
+        release();
+        return *this;
+    }
+
+    bool is_loaded() const { return value.has_value(); }
+    /// Size of the encoded value waiting to be decoded, 0 once it is loaded
+    size_t encoded_size() const { return is_loaded() ? 0 : length; }
+
+    const T& get() const { load(); return *value; }
+    T& get() { load(); return *value; }
+    const T& operator*() const { return get(); }
+    T& operator*() { return get(); }
+    const T* operator->() const { return &get(); }
+    T* operator->() { return &get(); }
+
+private:
+    template<typename S, template<typename> class P, typename E, typename B>
+    friend struct BinaryArchive;
+
+    using Decoder = void (*)(const Lazy&);
+
+    template<typename Encoding, typename ByteOrder>
+    static void decode(const Lazy& lazy) {
+        using Archive = BinaryArchive<storage::MemoryReader, storage_policy::Inline, Encoding, ByteOrder>;
+        if constexpr (details::external_stream_serialization_exists_v<ArchiveStream<Archive, Direction::Deserialize>, T>) {
+            ArchiveStream<Archive, Direction::Deserialize> reader(lazy.encoded(), lazy.length);
+            reader.getArchive().set_memory_resource(lazy.memory_resource);
+            T object {};
+            reader >> object;
+            lazy.value.emplace(std::move(object));
+        } else {
+            Archive archive(lazy.encoded(), lazy.length);
+            archive.set_memory_resource(lazy.memory_resource);
+            lazy.value.emplace(archive.template deserialize<T>());
+        }
+    }
+
+    void load() const {
+        if (!value) {
+            decoder(*this);
+            release();
+        }
+    }
+
+    void release() const {
+        bytes = nullptr;
+        owned = {};
+        length = 0;
+        decoder = nullptr;
+    }
+
+    const unsigned char* encoded() const { return owned.empty() ? bytes : owned.data(); }
+
+    mutable std::optional<T> value;
+    /// Encoded value: referenced in a contiguous storage or copied into `owned`
+    mutable const unsigned char* bytes = nullptr;
+    mutable std::vector<unsigned char> owned;
+    mutable size_t length = 0;
+    mutable Decoder decoder = nullptr;
+    std::pmr::memory_resource* memory_resource = nullptr;
 };
 
+
 /// Helper to make maintain const-correctness while using single template function for both
 /// serialization and deserialization
 /// * cast to int to avoid strange MVSC compilation error about enum class `operator ==`
@@ -475,6 +3769,8 @@ public:
         auto* this_deserializer = as<Direction::Deserialize>();
         if constexpr (details::external_stream_serialization_exists_v<ArchiveStream, T>) {
             stream_serialization(*this_deserializer, t);
+        } else if constexpr (traits::is_pointer_v<T>) {
+            this_deserializer->archive.deserialize_pointer(t, [this_deserializer] (auto& object) { *this_deserializer >> object; });
         } else {
             this_deserializer->archive.deserialize(t);
         }
@@ -488,6 +3784,8 @@ public:
         auto* this_serializer = as<Direction::Serialize>();
         if constexpr (details::external_stream_serialization_exists_v<ArchiveStream, T>) {
             stream_serialization(*this_serializer, t);
+        } else if constexpr (traits::is_pointer_v<T>) {
+            this_serializer->archive.serialize_pointer(t, [this_serializer] (const auto& object) { *this_serializer << object; });
         } else {
             this_serializer->archive.serialize(t);
         }
@@ -501,6 +3799,10 @@ public:
 
         if constexpr (details::external_stream_serialization_exists_v<ArchiveStream, T>) {
             stream_serialization(*this, t);
+        } else if constexpr (traits::is_pointer_v<T> && policy == Direction::Deserialize) {
+            archive.deserialize_pointer(t, [this] (auto& object) { *this & object; });
+        } else if constexpr (traits::is_pointer_v<T>) {
+            archive.serialize_pointer(t, [this] (const auto& object) { *this & object; });
         } else if constexpr (policy == Direction::Deserialize) {
             archive.deserialize(t);
         } else {
@@ -509,6 +3811,31 @@ public:
         return *this;
     }
 
+    /// Moves past a value of type `T`, see `BinaryArchive::skip`.
+    /// Types with `stream_serialization` are read into a temporary, pointers into a raw pointer owned by
+    /// the object table or into a `std::shared_ptr` without one
+    template<typename T>
+    ArchiveStream& skip() {
+        static_assert (policy != Direction::Serialize, "Invalid use of skip for Serialize Archive");
+
+        if constexpr (details::external_stream_serialization_exists_v<ArchiveStream, T>) {
+            T skipped {};
+            *this >> skipped;
+        } else if constexpr (traits::is_pointer_v<T>) {
+            using Object = std::remove_const_t<details::pointee_t<std::remove_const_t<T>>>;
+            if (archive.get_object_table()) {
+                Object* skipped = nullptr;
+                *this >> skipped;
+            } else {
+                std::shared_ptr<Object> skipped;
+                *this >> skipped;
+            }
+        } else {
+            archive.template skip<T>();
+        }
+        return *this;
+    }
+
     constexpr static Direction get_policy() { return policy; }
 
     Archive& getArchive() { return archive; }
@@ -527,6 +3854,23 @@ protected:
     friend class ArchiveStream<Archive, Direction::Bidirectional>;
 };
 
+/// Exact number of bytes `BinaryArchive::serialize(object)` writes
+template<typename T>
+usize serialized_size(const T& object) {
+    return BinaryArchive<storage::Counter, storage_policy::Inline>::serialized_size(object);
+}
+
+/// Serializes `objects` one after another into a buffer that is allocated exactly once
+template<typename... Objects>
+storage::Buffer serialize_to_buffer(const Objects&... objects) {
+    using Archive = BinaryArchive<storage::Buffer, storage_policy::Inline>;
+    Archive archive;
+    archive.get_storage().reserve(static_cast<size_t>((Archive::serialized_size(objects) + ... + 0)));
+    (archive.serialize(objects), ...);
+    return std::move(archive.get_storage());
+}
+
+
 namespace stream {
 template<typename T>
 using Reader = ArchiveStream<T, Direction::Deserialize>;
@@ -538,4 +3882,5 @@ using Writer = ArchiveStream<T, Direction::Serialize>;
 
 } // namespace archive
 
+#undef ARCHIVE_HAS_SPAN
 #undef ARCHIVE_ASSERT
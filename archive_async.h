@@ -0,0 +1,207 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/// Asynchronous write-behind storage:
+///    archive::BinaryArchive<archive::storage::AsyncWriter<archive::storage::GatherWriter>> archive(
+///            archive::storage::GatherWriter("checkpoint.bin"));
+///    archive.serialize(state);             // encoding overlaps with disk writes
+///    archive.get_storage().close();        // waits for the data to reach the file
+/// Errors of the sink are reported by the next `write()`, `flush()` or `close()`
+namespace archive::storage {
+
+/// Wraps a sink storage: writes are copied into one of `buffer_count` fixed-size buffers and full
+/// buffers are written to the sink by a background thread, while the caller fills the next one.
+/// When every buffer is waiting for the sink, `write()` blocks until one is free.
+/// Sinks with `flush()` are flushed after each buffer, so they may reference the written memory
+/// until then (e.g. `GatherWriter`)
+template<typename Sink>
+class AsyncWriter {
+public:
+    static constexpr size_t default_buffer_size = size_t(1) << 20;
+    static constexpr size_t default_buffer_count = 2;
+
+    explicit AsyncWriter(Sink sink_,
+                         size_t buffer_size_ = default_buffer_size,
+                         size_t buffer_count = default_buffer_count)
+        : sink(std::move(sink_))
+        , buffer_size(std::max<size_t>(buffer_size_, 1))
+    {
+        buffer_count = std::max<size_t>(buffer_count, 2);
+        buffers.reserve(buffer_count);
+        for (size_t i = 0; i < buffer_count; ++i) {
+            buffers.emplace_back(new unsigned char[buffer_size]);
+            free_buffers.push_back(i);
+        }
+        current = free_buffers.back();
+        free_buffers.pop_back();
+        worker = std::thread([this] { work(); });
+    }
+
+    AsyncWriter(const AsyncWriter&) = delete;
+    AsyncWriter& operator=(const AsyncWriter&) = delete;
+
+    ~AsyncWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    size_t write(const unsigned char* data, size_t size) {
+        const size_t total = size;
+        while (size > 0) {
+            if (used == buffer_size) {
+                submit();
+            }
+            const size_t count = std::min(size, buffer_size - used);
+            std::memcpy(buffers[current].get() + used, data, count);
+            used += count;
+            data += count;
+            size -= count;
+        }
+        return total;
+    }
+
+    /// Waits until everything written so far reached the sink, rethrows the sink error if there was one
+    void flush() {
+        if (used > 0) {
+            submit();
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        idle.wait(lock, [this] { return queue.empty() && !busy; });
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    /// Flushes, stops the background thread and closes the sink if it can be closed
+    void close() {
+        if (!worker.joinable()) {
+            return;
+        }
+        std::exception_ptr failure;
+        try {
+            flush();
+        } catch (...) {
+            failure = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+        if constexpr (traits::has_close_v<Sink>) {
+            sink.close();
+        }
+    }
+
+    bool is_open() const { return worker.joinable(); }
+
+    /// Number of bytes that reached the sink
+    usize size() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return written;
+    }
+
+    /// The sink is used by the background thread, access it only after `flush()` or `close()`
+    Sink& get_sink() { return sink; }
+    const Sink& get_sink() const { return sink; }
+
+private:
+    /// Queues the current buffer and takes a free one, waiting for it if all buffers are queued
+    void submit() {
+        if (!worker.joinable()) {
+            throw std::system_error(std::make_error_code(std::errc::bad_file_descriptor), "archive: write to a closed AsyncWriter");
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        queue.push_back({current, used});
+        wake.notify_one();
+        idle.wait(lock, [this] { return !free_buffers.empty(); });
+        current = free_buffers.back();
+        free_buffers.pop_back();
+        used = 0;
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    void work() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            const auto [index, size] = queue.front();
+            queue.pop_front();
+            // after an error buffers are only recycled, the data is lost anyway
+            if (!error) {
+                busy = true;
+                lock.unlock();
+                std::exception_ptr failure;
+                try {
+                    write_to_sink(buffers[index].get(), size);
+                } catch (...) {
+                    failure = std::current_exception();
+                }
+                lock.lock();
+                busy = false;
+                if (failure) {
+                    error = failure;
+                } else {
+                    written += size;
+                }
+            }
+            free_buffers.push_back(index);
+            idle.notify_all();
+        }
+    }
+
+    void write_to_sink(const unsigned char* data, size_t size) {
+        sink.write(data, size);
+        if constexpr (traits::has_flush_v<Sink>) {
+            sink.flush();
+        }
+    }
+
+    Sink sink;
+    const size_t buffer_size;
+    std::vector<std::unique_ptr<unsigned char[]>> buffers;
+    /// Buffer filled by `write()`, touched only by the writing thread
+    size_t current = 0;
+    size_t used = 0;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    /// Full buffers in write order: index and number of bytes
+    std::deque<std::pair<size_t, size_t>> queue;
+    std::vector<size_t> free_buffers;
+    bool busy = false;
+    bool stopping = false;
+    std::exception_ptr error;
+    usize written = 0;
+
+    std::thread worker;
+};
+
+} // namespace archive::storage
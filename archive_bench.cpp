@@ -0,0 +1,504 @@
+#include "archive.h"
+#include "archive_parallel.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+
+/// Serialize/deserialize benchmark for every type category `archive.h` supports,
+/// across payload sizes and storage policies.
+///
+/// Usage: archive_bench [--min-time-ms N] [--sizes a,b,c] [--filter substring]
+///                      [--format csv|json] [--out file]
+/// Every row reports time per operation (one operation serializes or deserializes
+/// the whole payload) and throughput over the serialized bytes
+
+namespace {
+
+template<typename T>
+void do_not_optimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+enum class Level { Low, High };
+
+struct Record {
+    int id;
+    double value;
+    std::string name;
+    bool operator == (const Record& other) const { return id == other.id && value == other.value && name == other.name; }
+};
+
+template<typename Archive>
+archive::usize serialize_object(const Record& r, Archive& a) {
+    return a.serialize(r.id) + a.serialize(r.value) + a.serialize(r.name);
+}
+
+template<typename Archive>
+void deserialize_object(Record& r, Archive& a) {
+    a.deserialize(r.id);
+    a.deserialize(r.value);
+    a.deserialize(r.name);
+}
+
+struct StreamRecord {
+    int id;
+    double value;
+    std::string name;
+};
+
+template<typename Stream>
+void stream_serialization(Stream& stream, archive::ArgumentRef<StreamRecord, Stream::get_policy()>& t) {
+    stream & t.id & t.value & t.name;
+}
+
+std::string make_string(size_t i) {
+    return "string-" + std::to_string(i * 7919);
+}
+
+/// Every category provides a payload of `n` elements and how to write/read it.
+/// `write`/`read` are generic over the archive so all storage policies share them
+
+struct Primitives {
+    static constexpr const char* name = "primitives";
+    using Payload = std::vector<std::int64_t>;
+    static Payload make(size_t n) {
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) p[i] = static_cast<std::int64_t>(i * 31);
+        return p;
+    }
+    // one value at a time to measure per-primitive overhead
+    template<typename A> static void write(A& a, const Payload& p) { for (auto v: p) a.serialize(v); }
+    template<typename A> static void read(A& a, Payload& p) { for (auto& v: p) a.deserialize(v); }
+};
+
+struct Enums {
+    static constexpr const char* name = "enums";
+    using Payload = std::vector<Level>;
+    static Payload make(size_t n) {
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) p[i] = i % 2 ? Level::High : Level::Low;
+        return p;
+    }
+    template<typename A> static void write(A& a, const Payload& p) { for (auto v: p) a.serialize(v); }
+    template<typename A> static void read(A& a, Payload& p) { for (auto& v: p) a.deserialize(v); }
+};
+
+template<typename PayloadType>
+struct WholeObject {
+    using Payload = PayloadType;
+    template<typename A> static void write(A& a, const Payload& p) { a.serialize(p); }
+    template<typename A> static void read(A& a, Payload& p) { p = Payload(); a.deserialize(p); }
+};
+
+struct PrimitiveVector : WholeObject<std::vector<float>> {
+    static constexpr const char* name = "vector<float>";
+    static Payload make(size_t n) {
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) p[i] = static_cast<float>(i) * 0.5f;
+        return p;
+    }
+};
+
+struct String : WholeObject<std::string> {
+    static constexpr const char* name = "string";
+    static Payload make(size_t n) { return std::string(n, 'a'); }
+};
+
+struct Map : WholeObject<std::map<int, std::string>> {
+    static constexpr const char* name = "map<int,string>";
+    static Payload make(size_t n) {
+        Payload p;
+        for (size_t i = 0; i < n; ++i) p.emplace(static_cast<int>(i), make_string(i));
+        return p;
+    }
+};
+
+struct Tuples : WholeObject<std::vector<std::tuple<int, double, std::string>>> {
+    static constexpr const char* name = "vector<tuple>";
+    static Payload make(size_t n) {
+        Payload p;
+        for (size_t i = 0; i < n; ++i) p.emplace_back(static_cast<int>(i), i * 0.25, make_string(i));
+        return p;
+    }
+};
+
+struct AnalyticsRows : WholeObject<std::vector<std::tuple<std::int64_t, double, std::uint32_t, std::int32_t, float>>> {
+    static constexpr const char* name = "vector<5-field row>";
+    static Payload make(size_t n) {
+        Payload p;
+        for (size_t i = 0; i < n; ++i) {
+            p.emplace_back(static_cast<std::int64_t>(i) * 1000, i * 0.5, static_cast<std::uint32_t>(i % 97),
+                           static_cast<std::int32_t>(i) - 50, static_cast<float>(i) * 0.25f);
+        }
+        return p;
+    }
+};
+
+struct AnalyticsColumns : AnalyticsRows {
+    static constexpr const char* name = "vector<5-field row> (Columnar)";
+    template<typename A> static void write(A& a, const Payload& p) { a.serialize(archive::Columnar(p)); }
+    template<typename A> static void read(A& a, Payload& p) { p.clear(); a.deserialize(archive::Columnar(p)); }
+};
+
+struct RepeatedStrings : WholeObject<std::vector<std::string>> {
+    static constexpr const char* name = "vector<repeated string>";
+    static Payload make(size_t n) {
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) p[i] = "instrument-" + std::to_string(i * 7919 % 64);
+        return p;
+    }
+};
+
+struct DictionaryStrings : RepeatedStrings {
+    static constexpr const char* name = "vector<repeated string> (StringDictionary)";
+    // every write and read is a session of its own
+    template<typename A> static void write(A& a, const Payload& p) {
+        archive::StringDictionary dictionary;
+        a.set_string_dictionary(&dictionary);
+        a.serialize(p);
+        a.set_string_dictionary(nullptr);
+    }
+    template<typename A> static void read(A& a, Payload& p) {
+        archive::StringDictionary dictionary;
+        a.set_string_dictionary(&dictionary);
+        p.clear();
+        a.deserialize(p);
+        a.set_string_dictionary(nullptr);
+    }
+};
+
+struct SharedRecords : WholeObject<std::vector<std::shared_ptr<Record>>> {
+    static constexpr const char* name = "vector<shared_ptr> (16 per object)";
+    static Payload make(size_t n) {
+        std::vector<std::shared_ptr<Record>> objects;
+        for (size_t i = 0; i < n / 16 + 1; ++i) {
+            objects.push_back(std::make_shared<Record>(Record{static_cast<int>(i), i * 0.5, make_string(i)}));
+        }
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) p[i] = objects[i * 7919 % objects.size()];
+        return p;
+    }
+};
+
+struct SharedRecordsTable : SharedRecords {
+    static constexpr const char* name = "vector<shared_ptr> (16 per object, ObjectTable)";
+    // every write and read is a session of its own
+    template<typename A> static void write(A& a, const Payload& p) {
+        archive::ObjectTable table;
+        a.set_object_table(&table);
+        a.serialize(p);
+        a.set_object_table(nullptr);
+    }
+    template<typename A> static void read(A& a, Payload& p) {
+        archive::ObjectTable table;
+        a.set_object_table(&table);
+        p = Payload();
+        a.deserialize(p);
+        a.set_object_table(nullptr);
+    }
+};
+
+struct Optionals : WholeObject<std::vector<std::optional<int>>> {
+    static constexpr const char* name = "vector<optional>";
+    static Payload make(size_t n) {
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) if (i % 3) p[i] = static_cast<int>(i);
+        return p;
+    }
+};
+
+struct Nested : WholeObject<std::vector<std::vector<int>>> {
+    static constexpr const char* name = "nested vector";
+    static Payload make(size_t n) {
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) p[i].assign(i % 16, static_cast<int>(i));
+        return p;
+    }
+};
+
+struct PackedIds {
+    static constexpr const char* name = "vector<uint32> (Packed)";
+    using Payload = std::vector<std::uint32_t>;
+    static Payload make(size_t n) {
+        Payload p(n);
+        for (size_t i = 0; i < n; ++i) p[i] = static_cast<std::uint32_t>(1000000 + i * 7919 % 4096);
+        return p;
+    }
+    template<typename A> static void write(A& a, const Payload& p) { a.serialize(archive::Packed(p)); }
+    template<typename A> static void read(A& a, Payload& p) { p.clear(); a.deserialize(archive::Packed(p)); }
+};
+
+struct DeltaTimestamps {
+    static constexpr const char* name = "vector<uint64> (Delta)";
+    using Payload = std::vector<std::uint64_t>;
+    static Payload make(size_t n) {
+        Payload p(n);
+        std::uint64_t now = std::uint64_t(1) << 40;
+        for (size_t i = 0; i < n; ++i) p[i] = now += i * 7919 % 64;
+        return p;
+    }
+    template<typename A> static void write(A& a, const Payload& p) { a.serialize(archive::Delta(p)); }
+    template<typename A> static void read(A& a, Payload& p) { p.clear(); a.deserialize(archive::Delta(p)); }
+};
+
+struct UserType : WholeObject<std::vector<Record>> {
+    static constexpr const char* name = "user type (serialize_object)";
+    static Payload make(size_t n) {
+        Payload p;
+        for (size_t i = 0; i < n; ++i) p.push_back({static_cast<int>(i), i * 0.5, make_string(i)});
+        return p;
+    }
+};
+
+struct UserTypeParallel : UserType {
+    static constexpr const char* name = "user type (parallel)";
+    template<typename A> static void write(A& a, const Payload& p) { a.serialize(p, archive::parallel); }
+};
+
+struct StreamType {
+    static constexpr const char* name = "user type (stream_serialization)";
+    using Payload = std::vector<StreamRecord>;
+    static Payload make(size_t n) {
+        Payload p;
+        for (size_t i = 0; i < n; ++i) p.push_back({static_cast<int>(i), i * 0.5, make_string(i)});
+        return p;
+    }
+    // streams hold their archive by value, so they share the storage of the measured archive through
+    // a NotOwningPointer archive whatever its policy: only that row is reported
+    static constexpr bool single_policy = true;
+    using Stream = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::NotOwningPointer>;
+    template<typename A> static void write(A& a, const Payload& p) {
+        archive::stream::Writer<Stream> writer(&a.get_storage());
+        for (const auto& r: p) writer & r;
+    }
+    template<typename A> static void read(A& a, Payload& p) {
+        archive::stream::Reader<Stream> reader(&a.get_storage());
+        for (auto& r: p) reader & r;
+    }
+};
+
+struct Result {
+    std::string category;
+    std::string policy;
+    size_t elements = 0;
+    size_t bytes = 0;
+    double serialize_ns = 0;
+    double deserialize_ns = 0;
+};
+
+struct Options {
+    double min_time_ms = 100;
+    std::vector<size_t> sizes {16, 1024, 65536};
+    std::string filter;
+    std::string format = "csv";
+    std::string out;
+};
+
+/// Runs `operation` until at least `min_time_ms` passed, returns ns per call
+template<typename Operation>
+double measure(const Options& options, Operation&& operation) {
+    using clock = std::chrono::steady_clock;
+    operation(); // warm up
+    size_t iterations = 0;
+    const auto start = clock::now();
+    auto now = start;
+    do {
+        operation();
+        ++iterations;
+        now = clock::now();
+    } while (std::chrono::duration<double, std::milli>(now - start).count() < options.min_time_ms);
+    return std::chrono::duration<double, std::nano>(now - start).count() / static_cast<double>(iterations);
+}
+
+template<typename Category, typename Archive>
+Result run(const Options& options, const char* policy_name, Archive& archive, size_t n) {
+    const typename Category::Payload payload = Category::make(n);
+    typename Category::Payload result = payload;
+
+    Result r;
+    r.category = Category::name;
+    r.policy = policy_name;
+    r.elements = n;
+
+    archive::storage::Buffer& buffer = archive.get_storage();
+    buffer.clear();
+    Category::write(archive, payload);
+    r.bytes = buffer.size();
+
+    r.serialize_ns = measure(options, [&] {
+        buffer.clear();
+        Category::write(archive, payload);
+        do_not_optimize(buffer.data());
+    });
+    r.deserialize_ns = measure(options, [&] {
+        buffer.rewind();
+        Category::read(archive, result);
+        do_not_optimize(result);
+    });
+    return r;
+}
+
+/// Categories whose measured code does not depend on the archive storage policy
+template<typename Category, typename = void>
+struct is_single_policy : std::false_type {};
+
+template<typename Category>
+struct is_single_policy<Category, std::void_t<decltype(Category::single_policy)>> : std::bool_constant<Category::single_policy> {};
+
+template<typename Category>
+void run_category(const Options& options, std::vector<Result>& results) {
+    if (!options.filter.empty() && std::string(Category::name).find(options.filter) == std::string::npos) {
+        return;
+    }
+    using Storage = archive::storage::Buffer;
+    for (size_t n: options.sizes) {
+        if constexpr (is_single_policy<Category>::value) {
+            Storage storage;
+            archive::BinaryArchive<Storage, archive::storage_policy::NotOwningPointer> archive(&storage);
+            results.push_back(run<Category>(options, "NotOwningPointer", archive, n));
+            continue;
+        }
+        {
+            archive::BinaryArchive<Storage, archive::storage_policy::Parent> archive;
+            results.push_back(run<Category>(options, "Parent", archive, n));
+        }
+        {
+            archive::BinaryArchive<Storage, archive::storage_policy::Inline> archive;
+            results.push_back(run<Category>(options, "Inline", archive, n));
+        }
+        {
+            Storage storage;
+            archive::BinaryArchive<Storage, archive::storage_policy::NotOwningPointer> archive(&storage);
+            results.push_back(run<Category>(options, "NotOwningPointer", archive, n));
+        }
+    }
+}
+
+double gigabytes_per_second(size_t bytes, double ns) {
+    return ns > 0 ? static_cast<double>(bytes) / ns : 0;
+}
+
+/// Billions of elements per second, the natural unit for integer codecs
+double giga_elements_per_second(size_t elements, double ns) {
+    return ns > 0 ? static_cast<double>(elements) / ns : 0;
+}
+
+void write_csv(std::ostream& out, const std::vector<Result>& results) {
+    out << "category,policy,elements,bytes,serialize_ns_per_op,serialize_gb_per_s,deserialize_ns_per_op,deserialize_gb_per_s,deserialize_g_elements_per_s\n";
+    for (const Result& r: results) {
+        out << '"' << r.category << "\"," << r.policy << ',' << r.elements << ',' << r.bytes << ','
+            << r.serialize_ns << ',' << gigabytes_per_second(r.bytes, r.serialize_ns) << ','
+            << r.deserialize_ns << ',' << gigabytes_per_second(r.bytes, r.deserialize_ns) << ','
+            << giga_elements_per_second(r.elements, r.deserialize_ns) << '\n';
+    }
+}
+
+void write_json(std::ostream& out, const std::vector<Result>& results) {
+    out << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "  {\"category\": \"" << r.category << "\", \"policy\": \"" << r.policy
+            << "\", \"elements\": " << r.elements << ", \"bytes\": " << r.bytes
+            << ", \"serialize_ns_per_op\": " << r.serialize_ns
+            << ", \"serialize_gb_per_s\": " << gigabytes_per_second(r.bytes, r.serialize_ns)
+            << ", \"deserialize_ns_per_op\": " << r.deserialize_ns
+            << ", \"deserialize_gb_per_s\": " << gigabytes_per_second(r.bytes, r.deserialize_ns)
+            << ", \"deserialize_g_elements_per_s\": " << giga_elements_per_second(r.elements, r.deserialize_ns)
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "]\n";
+}
+
+std::vector<size_t> parse_sizes(const std::string& list) {
+    std::vector<size_t> sizes;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        sizes.push_back(static_cast<size_t>(std::strtoull(item.c_str(), nullptr, 10)));
+    }
+    return sizes;
+}
+
+bool parse_options(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--min-time-ms" && has_value) {
+            options.min_time_ms = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--sizes" && has_value) {
+            options.sizes = parse_sizes(argv[++i]);
+        } else if (arg == "--filter" && has_value) {
+            options.filter = argv[++i];
+        } else if (arg == "--format" && has_value) {
+            options.format = argv[++i];
+        } else if (arg == "--out" && has_value) {
+            options.out = argv[++i];
+        } else {
+            std::cerr << "usage: archive_bench [--min-time-ms N] [--sizes a,b,c] [--filter substring]"
+                         " [--format csv|json] [--out file]\n";
+            return false;
+        }
+    }
+    return options.format == "csv" || options.format == "json";
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        return 1;
+    }
+
+    std::vector<Result> results;
+    run_category<Primitives>(options, results);
+    run_category<Enums>(options, results);
+    run_category<PrimitiveVector>(options, results);
+    run_category<String>(options, results);
+    run_category<Map>(options, results);
+    run_category<Tuples>(options, results);
+    run_category<AnalyticsRows>(options, results);
+    run_category<AnalyticsColumns>(options, results);
+    run_category<RepeatedStrings>(options, results);
+    run_category<DictionaryStrings>(options, results);
+    run_category<SharedRecords>(options, results);
+    run_category<SharedRecordsTable>(options, results);
+    run_category<Optionals>(options, results);
+    run_category<Nested>(options, results);
+    run_category<PackedIds>(options, results);
+    run_category<DeltaTimestamps>(options, results);
+    run_category<UserType>(options, results);
+    run_category<UserTypeParallel>(options, results);
+    run_category<StreamType>(options, results);
+
+    std::ofstream file;
+    if (!options.out.empty()) {
+        file.open(options.out);
+        if (!file) {
+            std::cerr << "cannot open " << options.out << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.out.empty() ? std::cout : file;
+    if (options.format == "json") {
+        write_json(out, results);
+    } else {
+        write_csv(out, results);
+    }
+    return 0;
+}
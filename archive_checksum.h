@@ -0,0 +1,447 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Integrity checks for archives:
+///    archive::BinaryArchive<archive::storage::ChecksumWriter<archive::storage::GatherWriter>> archive(
+///            archive::storage::GatherWriter("state.bin"));
+///    archive.serialize(state);
+///    archive.get_storage().close();
+///    archive::BinaryArchive<archive::storage::ChecksumReader<archive::storage::MmapReader>> reader(
+///            archive::storage::MmapReader("state.bin"));
+///    reader.deserialize(state);            // throws as soon as a block does not match its checksum
+///    reader.get_storage().verify_end();    // throws if the file was cut at a block boundary
+///
+/// Data is written in blocks, each one preceded by [size: u32][crc32c of the block bytes: u32],
+/// both little-endian. `close()` ends the stream with an empty block.
+/// CRC32C uses SSE4.2 `crc32` instructions when the CPU has them, a table-driven loop otherwise.
+/// Errors are reported with `std::system_error`
+namespace archive::checksum {
+
+namespace details {
+
+/// Reflected Castagnoli polynomial
+inline constexpr std::uint32_t polynomial = 0x82f63b78;
+
+/// Slicing-by-8 tables: `tables[k][b]` is the register after byte `b` followed by `k` zero bytes
+inline const std::array<std::array<std::uint32_t, 256>, 8>& crc_tables() {
+    static const auto tables = [] {
+        std::array<std::array<std::uint32_t, 256>, 8> result {};
+        for (std::uint32_t b = 0; b < 256; ++b) {
+            std::uint32_t crc = b;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ (polynomial & (0u - (crc & 1)));
+            }
+            result[0][b] = crc;
+        }
+        for (std::uint32_t b = 0; b < 256; ++b) {
+            for (size_t k = 1; k < 8; ++k) {
+                result[k][b] = (result[k - 1][b] >> 8) ^ result[0][result[k - 1][b] & 0xff];
+            }
+        }
+        return result;
+    }();
+    return tables;
+}
+
+/// Updates the raw CRC register (no pre/post inversion) with `size` bytes
+inline std::uint32_t crc32c_scalar(std::uint32_t crc, const unsigned char* data, size_t size) {
+    const auto& t = crc_tables();
+    for (; size >= 8; size -= 8, data += 8) {
+        const std::uint32_t low = crc ^ (std::uint32_t(data[0]) | std::uint32_t(data[1]) << 8
+                                         | std::uint32_t(data[2]) << 16 | std::uint32_t(data[3]) << 24);
+        crc = t[7][low & 0xff] ^ t[6][(low >> 8) & 0xff] ^ t[5][(low >> 16) & 0xff] ^ t[4][low >> 24]
+            ^ t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+    }
+    for (; size > 0; --size, ++data) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+    }
+    return crc;
+}
+
+#if defined(ARCHIVE_X86)
+/// Bytes per lane of the interleaved loop. `crc32` has a latency of 3 cycles and a throughput of 1,
+/// so three independent lanes keep the unit busy and are merged with `ShiftTable`
+inline constexpr size_t lane_size = 4096;
+
+/// Linear map advancing a raw CRC register over `lane_size` zero bytes, applied a byte at a time
+struct ShiftTable {
+    std::uint32_t bytes[4][256];
+
+    std::uint32_t operator()(std::uint32_t crc) const {
+        return bytes[0][crc & 0xff] ^ bytes[1][(crc >> 8) & 0xff] ^ bytes[2][(crc >> 16) & 0xff] ^ bytes[3][crc >> 24];
+    }
+};
+
+inline const ShiftTable& lane_shift() {
+    static const ShiftTable table = [] {
+        ShiftTable result {};
+        const unsigned char zeros[lane_size] = {};
+        std::uint32_t bits[32];
+        for (int bit = 0; bit < 32; ++bit) {
+            bits[bit] = crc32c_scalar(std::uint32_t(1) << bit, zeros, lane_size);
+        }
+        for (int byte = 0; byte < 4; ++byte) {
+            for (std::uint32_t value = 0; value < 256; ++value) {
+                std::uint32_t crc = 0;
+                for (int bit = 0; bit < 8; ++bit) {
+                    if (value & (1u << bit)) {
+                        crc ^= bits[byte * 8 + bit];
+                    }
+                }
+                result.bytes[byte][value] = crc;
+            }
+        }
+        return result;
+    }();
+    return table;
+}
+
+ARCHIVE_TARGET("sse4.2")
+inline std::uint32_t crc32c_sse42_tail(std::uint32_t crc, const unsigned char* data, size_t size) {
+#if defined(__x86_64__) || defined(_M_X64)
+    std::uint64_t crc64 = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        std::uint64_t word;
+        std::memcpy(&word, data, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+#endif
+    for (; size >= 4; size -= 4, data += 4) {
+        std::uint32_t word;
+        std::memcpy(&word, data, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    for (; size > 0; --size, ++data) {
+        crc = _mm_crc32_u8(crc, *data);
+    }
+    return crc;
+}
+
+ARCHIVE_TARGET("sse4.2")
+inline std::uint32_t crc32c_sse42(std::uint32_t crc, const unsigned char* data, size_t size) {
+#if defined(__x86_64__) || defined(_M_X64)
+    if (size >= 3 * lane_size) {
+        const ShiftTable& shift = lane_shift();
+        do {
+            std::uint64_t a = crc;
+            std::uint64_t b = 0;
+            std::uint64_t c = 0;
+            for (size_t i = 0; i < lane_size; i += 8) {
+                std::uint64_t wa, wb, wc;
+                std::memcpy(&wa, data + i, 8);
+                std::memcpy(&wb, data + lane_size + i, 8);
+                std::memcpy(&wc, data + 2 * lane_size + i, 8);
+                a = _mm_crc32_u64(a, wa);
+                b = _mm_crc32_u64(b, wb);
+                c = _mm_crc32_u64(c, wc);
+            }
+            crc = shift(shift(static_cast<std::uint32_t>(a)) ^ static_cast<std::uint32_t>(b)) ^ static_cast<std::uint32_t>(c);
+            data += 3 * lane_size;
+            size -= 3 * lane_size;
+        } while (size >= 3 * lane_size);
+    }
+#endif
+    return crc32c_sse42_tail(crc, data, size);
+}
+#endif
+
+using Crc32cFunction = std::uint32_t (*)(std::uint32_t, const unsigned char*, size_t);
+
+inline Crc32cFunction select_crc32c() {
+#if defined(ARCHIVE_X86)
+    if (archive::details::cpu_features().sse42) {
+        return crc32c_sse42;
+    }
+#endif
+    return crc32c_scalar;
+}
+
+} // namespace details
+
+/// CRC32C (Castagnoli) of `size` bytes. Pass the previous result as `crc` to continue a checksum
+inline std::uint32_t crc32c(const void* data, size_t size, std::uint32_t crc = 0) {
+    static const details::Crc32cFunction function = details::select_crc32c();
+    return ~function(~crc, static_cast<const unsigned char*>(data), size);
+}
+
+} // namespace archive::checksum
+
+
+namespace archive::storage {
+
+namespace details {
+
+inline constexpr size_t checksum_header_size = 8;
+inline constexpr size_t max_checksum_block_size = size_t(1) << 30;
+
+[[noreturn]] inline void throw_checksum_error(const char* what) {
+    throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), what);
+}
+
+inline void store_checksum_header(unsigned char* header, std::uint32_t size, std::uint32_t crc) {
+    for (int i = 0; i < 4; ++i) {
+        header[i] = static_cast<unsigned char>(size >> (8 * i));
+        header[4 + i] = static_cast<unsigned char>(crc >> (8 * i));
+    }
+}
+
+inline std::pair<std::uint32_t, std::uint32_t> load_checksum_header(const unsigned char* header) {
+    std::uint32_t size = 0;
+    std::uint32_t crc = 0;
+    for (int i = 0; i < 4; ++i) {
+        size |= std::uint32_t(header[i]) << (8 * i);
+        crc |= std::uint32_t(header[4 + i]) << (8 * i);
+    }
+    return {size, crc};
+}
+
+template<typename Storage, typename = void>
+struct has_size : std::false_type {};
+
+template<typename Storage>
+struct has_size<Storage, std::void_t<decltype(static_cast<size_t>(std::declval<const Storage&>().size()))>> : std::true_type {};
+
+} // namespace details
+
+
+/// Writes bytes to a sink in checksummed blocks of at most `block_size` bytes.
+/// The checksum is updated as bytes are copied into the block, `flush()` ends a block early.
+/// Writes covering whole blocks are passed to the sink without copying. Sinks that keep references to written
+/// memory, such as `GatherWriter`, are flushed after each block and after writes passed through, so the
+/// writer itself never references memory of its callers
+template<typename Sink>
+class ChecksumWriter {
+public:
+    static constexpr size_t default_block_size = size_t(64) << 10;
+    static constexpr size_t max_block_size = details::max_checksum_block_size;
+
+    explicit ChecksumWriter(Sink sink_, size_t block_size_ = default_block_size)
+        : sink(std::move(sink_))
+        , block_size(std::clamp<size_t>(block_size_, 1, max_block_size))
+        , block(details::checksum_header_size + block_size)
+    {}
+
+    /// Constructs the sink in place from `sink_args`, for sinks that cannot be moved (e.g. `AsyncWriter`)
+    template<typename... SinkArgs>
+    ChecksumWriter(std::in_place_t, size_t block_size_, SinkArgs&&... sink_args)
+        : sink(std::forward<SinkArgs>(sink_args)...)
+        , block_size(std::clamp<size_t>(block_size_, 1, max_block_size))
+        , block(details::checksum_header_size + block_size)
+    {}
+
+    ChecksumWriter(ChecksumWriter&& other)
+        : sink(std::move(other.sink))
+        , block_size(other.block_size)
+        , block(std::move(other.block))
+        , used(other.used)
+        , crc(other.crc)
+        , raw_bytes(other.raw_bytes)
+        , closed(std::exchange(other.closed, true))
+    {}
+
+    ChecksumWriter(const ChecksumWriter&) = delete;
+    ChecksumWriter& operator=(const ChecksumWriter&) = delete;
+
+    ~ChecksumWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    size_t write(const unsigned char* data, size_t size) {
+        const size_t total = size;
+        bool passed = false;
+        while (size > 0) {
+            if (used == 0 && size >= block_size) {
+                // whole blocks go to the sink from the caller memory, only the header is copied
+                unsigned char header[details::checksum_header_size];
+                details::store_checksum_header(header, static_cast<std::uint32_t>(block_size), checksum::crc32c(data, block_size));
+                sink.write(header, sizeof(header));
+                sink.write(data, block_size);
+                data += block_size;
+                size -= block_size;
+                passed = true;
+                continue;
+            }
+            const size_t count = std::min(size, block_size - used);
+            unsigned char* out = block.data() + details::checksum_header_size + used;
+            std::memcpy(out, data, count);
+            crc = checksum::crc32c(out, count, crc);
+            used += count;
+            data += count;
+            size -= count;
+            if (used == block_size) {
+                write_block();
+            }
+        }
+        if constexpr (traits::references_writes_v<Sink>) {
+            // the caller may reuse its memory once the write returns
+            if (passed) {
+                sink.flush();
+            }
+        }
+        raw_bytes += total;
+        return total;
+    }
+
+    /// Writes the current block and flushes the sink if it can be flushed
+    void flush() {
+        if (used > 0) {
+            write_block();
+        }
+        if constexpr (traits::has_flush_v<Sink>) {
+            sink.flush();
+        }
+    }
+
+    /// Flushes, writes the end marker and closes the sink if it can be closed
+    void close() {
+        if (closed) {
+            return;
+        }
+        if (used > 0) {
+            write_block();
+        }
+        write_block();
+        closed = true;
+        if constexpr (traits::has_flush_v<Sink>) {
+            sink.flush();
+        }
+        if constexpr (traits::has_close_v<Sink>) {
+            sink.close();
+        }
+    }
+
+    /// Bytes written to the adapter
+    usize size() const { return raw_bytes; }
+
+    Sink& get_sink() { return sink; }
+    const Sink& get_sink() const { return sink; }
+
+private:
+    void write_block() {
+        details::store_checksum_header(block.data(), static_cast<std::uint32_t>(used), crc);
+        sink.write(block.data(), details::checksum_header_size + used);
+        if constexpr (traits::references_writes_v<Sink>) {
+            sink.flush();
+        }
+        used = 0;
+        crc = 0;
+    }
+
+    Sink sink;
+    const size_t block_size;
+    std::vector<unsigned char> block;
+    size_t used = 0;
+    std::uint32_t crc = 0;
+    usize raw_bytes = 0;
+    bool closed = false;
+};
+
+
+/// Reads bytes written by `ChecksumWriter`, verifying every block before any of its bytes are returned.
+/// Contiguous sources are verified and read in place, others are read a block at a time into a buffer
+template<typename Source>
+class ChecksumReader {
+public:
+    explicit ChecksumReader(Source source_, size_t max_block_size_ = details::max_checksum_block_size)
+        : source(std::move(source_))
+        , max_block_size(max_block_size_)
+    {}
+
+    void read(unsigned char* data, size_t size) {
+        while (size > 0) {
+            if (position == length) {
+                next_block();
+            }
+            const size_t count = std::min(size, length - position);
+            std::memcpy(data, current + position, count);
+            position += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    void advance(size_t size) {
+        while (size > 0) {
+            if (position == length) {
+                next_block();
+            }
+            const size_t count = std::min(size, length - position);
+            position += count;
+            size -= count;
+        }
+    }
+
+    /// Checks that everything was read and the stream ends with the end marker written by `close()`
+    void verify_end() {
+        if (position != length || read_header().first != 0) {
+            details::throw_checksum_error("archive: checksummed stream has unread data");
+        }
+    }
+
+    Source& get_source() { return source; }
+    const Source& get_source() const { return source; }
+
+private:
+    static constexpr bool in_place = traits::is_contiguous_storage_v<Source> && details::has_size<Source>::value;
+
+    void require(size_t size) {
+        if constexpr (in_place) {
+            if (source.size() - source.read_position() < size) {
+                details::throw_checksum_error("archive: truncated checksummed stream");
+            }
+        }
+    }
+
+    std::pair<std::uint32_t, std::uint32_t> read_header() {
+        unsigned char header[details::checksum_header_size];
+        require(sizeof(header));
+        source.read(header, sizeof(header));
+        return details::load_checksum_header(header);
+    }
+
+    void next_block() {
+        const auto [size, crc] = read_header();
+        if (size == 0) {
+            details::throw_checksum_error("archive: read past the end of a checksummed stream");
+        }
+        if (size > max_block_size) {
+            details::throw_checksum_error("archive: corrupted checksummed block header");
+        }
+        require(size);
+        if constexpr (in_place) {
+            current = static_cast<const unsigned char*>(source.data()) + source.read_position();
+            source.advance(size);
+        } else {
+            buffer.resize(size);
+            source.read(buffer.data(), size);
+            current = buffer.data();
+        }
+        if (checksum::crc32c(current, size) != crc) {
+            details::throw_checksum_error("archive: checksum mismatch");
+        }
+        length = size;
+        position = 0;
+    }
+
+    Source source;
+    const size_t max_block_size;
+    std::vector<unsigned char> buffer;
+    const unsigned char* current = nullptr;
+    size_t length = 0;
+    size_t position = 0;
+};
+
+} // namespace archive::storage
@@ -0,0 +1,506 @@
+#pragma once
+#include "archive.h"
+#include "archive_parallel.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#define ARCHIVE_ASSERT(x)
+
+/// Transparent block compression:
+///    archive::BinaryArchive<archive::storage::CompressWriter<archive::storage::GatherWriter>> archive(
+///            archive::storage::GatherWriter("state.bin.lz"));
+///    archive.serialize(state);
+///    archive.get_storage().close();
+///    archive::BinaryArchive<archive::storage::DecompressReader<archive::storage::MmapReader>> reader(
+///            archive::storage::MmapReader("state.bin.lz"));
+///
+/// Written bytes are cut into blocks of `block_size`, every block is compressed on its own and stored as
+///    [codec: u8][raw size: u32][stored size: u32][stored size bytes]
+/// with little-endian sizes. Codec 0 means the block is stored as is, it is used for incompressible data.
+/// Errors are reported with `std::system_error`
+namespace archive::compression {
+
+inline constexpr size_t block_header_size = 9;
+/// Codec id of blocks stored without compression
+inline constexpr std::uint8_t stored_id = 0;
+
+/// Codecs are plain classes with const, thread-safe members:
+///    static constexpr std::uint8_t id;    // non-zero, written to block headers
+///    size_t max_compressed_size(size_t size) const;
+///    size_t compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity) const;
+///    void decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t original_size) const;
+/// `compress` returns 0 when the output does not fit `capacity`, `decompress` throws on malformed input
+
+namespace details {
+
+[[noreturn]] inline void throw_corrupted() {
+    throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence), "archive: corrupted compressed block");
+}
+
+inline void store_u32(unsigned char* out, std::uint32_t value) {
+    out[0] = static_cast<unsigned char>(value);
+    out[1] = static_cast<unsigned char>(value >> 8);
+    out[2] = static_cast<unsigned char>(value >> 16);
+    out[3] = static_cast<unsigned char>(value >> 24);
+}
+
+inline std::uint32_t load_u32(const unsigned char* in) {
+    return std::uint32_t(in[0]) | std::uint32_t(in[1]) << 8 | std::uint32_t(in[2]) << 16 | std::uint32_t(in[3]) << 24;
+}
+
+struct BlockHeader {
+    std::uint8_t codec;
+    std::uint32_t raw_size;
+    std::uint32_t stored_size;
+};
+
+inline BlockHeader decode_block_header(const unsigned char* header) {
+    return {header[0], load_u32(header + 1), load_u32(header + 5)};
+}
+
+/// Appends an encoded block of `size` bytes at `raw` to `out`
+template<typename Codec>
+void encode_block(const Codec& codec, const unsigned char* raw, size_t size, std::vector<unsigned char>& out) {
+    const size_t first = out.size();
+    out.resize(first + block_header_size + std::max(codec.max_compressed_size(size), size));
+    unsigned char* header = out.data() + first;
+    size_t stored = codec.compress(raw, size, header + block_header_size, out.size() - first - block_header_size);
+    header[0] = Codec::id;
+    if (stored == 0 || stored >= size) {
+        stored = size;
+        header[0] = stored_id;
+        std::memcpy(header + block_header_size, raw, size);
+    }
+    store_u32(header + 1, static_cast<std::uint32_t>(size));
+    store_u32(header + 5, static_cast<std::uint32_t>(stored));
+    out.resize(first + block_header_size + stored);
+}
+
+} // namespace details
+
+
+/// Byte-oriented LZ77 codec with LZ4-style sequences, fast on both ends and needing no dependencies.
+/// A sequence is [token][literal length extension][literals][offset: u16][match length extension],
+/// token holds 4 bits of literal length and 4 bits of match length minus 4, a nibble of 15 is continued
+/// with bytes that are added up to the first one below 255. The last sequence has literals only
+struct Lz {
+    static constexpr std::uint8_t id = 1;
+
+    size_t max_compressed_size(size_t size) const { return size + size / 255 + 16; }
+
+    size_t compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity) const {
+        std::uint32_t table[hash_size] = {};
+        size_t ip = 0;
+        size_t anchor = 0;
+        size_t op = 0;
+        while (ip + min_match + last_literals <= size) {
+            const std::uint32_t sequence = load(src + ip);
+            std::uint32_t& slot = table[hash(sequence)];
+            size_t candidate = slot;
+            slot = static_cast<std::uint32_t>(ip);
+            if (candidate >= ip || ip - candidate > max_offset || load(src + candidate) != sequence) {
+                // step faster over data that does not compress
+                ip += 1 + ((ip - anchor) >> skip_strength);
+                continue;
+            }
+            size_t length = min_match;
+            while (ip + length < size - last_literals && src[candidate + length] == src[ip + length]) {
+                ++length;
+            }
+            while (ip > anchor && candidate > 0 && src[ip - 1] == src[candidate - 1]) {
+                --ip;
+                --candidate;
+                ++length;
+            }
+            if (!emit(dst, capacity, op, src + anchor, ip - anchor, ip - candidate, length)) {
+                return 0;
+            }
+            ip += length;
+            anchor = ip;
+        }
+        if (!emit(dst, capacity, op, src + anchor, size - anchor, 0, 0)) {
+            return 0;
+        }
+        return op;
+    }
+
+    void decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t original_size) const {
+        size_t ip = 0;
+        size_t op = 0;
+        for (;;) {
+            if (ip >= size) {
+                details::throw_corrupted();
+            }
+            const unsigned char token = src[ip++];
+            const size_t literals = read_length(src, size, ip, token >> 4);
+            if (literals > size - ip || literals > original_size - op) {
+                details::throw_corrupted();
+            }
+            if (literals > 0) {
+                std::memcpy(dst + op, src + ip, literals);
+                ip += literals;
+                op += literals;
+            }
+            if (ip == size) {
+                if (op != original_size) {
+                    details::throw_corrupted();
+                }
+                return;
+            }
+
+            if (size - ip < 2) {
+                details::throw_corrupted();
+            }
+            const size_t offset = size_t(src[ip]) | size_t(src[ip + 1]) << 8;
+            ip += 2;
+            const size_t length = read_length(src, size, ip, token & 15) + min_match;
+            if (offset == 0 || offset > op || length > original_size - op) {
+                details::throw_corrupted();
+            }
+            const unsigned char* from = dst + op - offset;
+            if (offset >= length) {
+                std::memcpy(dst + op, from, length);
+            } else {
+                // overlapping match repeats the last `offset` bytes
+                for (size_t i = 0; i < length; ++i) {
+                    dst[op + i] = from[i];
+                }
+            }
+            op += length;
+        }
+    }
+
+private:
+    static constexpr size_t hash_bits = 12;
+    static constexpr size_t hash_size = size_t(1) << hash_bits;
+    static constexpr size_t min_match = 4;
+    /// The input always ends with literals, which keeps match extension within bounds
+    static constexpr size_t last_literals = 5;
+    static constexpr size_t max_offset = 65535;
+    static constexpr size_t skip_strength = 6;
+
+    static std::uint32_t load(const unsigned char* p) {
+        std::uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    }
+
+    static size_t hash(std::uint32_t sequence) {
+        return static_cast<size_t>((sequence * 2654435761u) >> (32 - hash_bits));
+    }
+
+    static void write_length(unsigned char* dst, size_t& op, size_t length) {
+        for (; length >= 255; length -= 255) {
+            dst[op++] = 255;
+        }
+        dst[op++] = static_cast<unsigned char>(length);
+    }
+
+    static size_t read_length(const unsigned char* src, size_t size, size_t& ip, size_t nibble) {
+        size_t length = nibble;
+        if (nibble == 15) {
+            unsigned char byte;
+            do {
+                if (ip >= size) {
+                    details::throw_corrupted();
+                }
+                byte = src[ip++];
+                length += byte;
+            } while (byte == 255);
+        }
+        return length;
+    }
+
+    /// Writes a sequence, `match_length` of 0 marks the last one. False if `dst` is too small
+    static bool emit(unsigned char* dst, size_t capacity, size_t& op,
+                     const unsigned char* literals, size_t literal_length, size_t offset, size_t match_length) {
+        if (op + 1 + literal_length / 255 + 1 + literal_length + 2 + match_length / 255 + 1 > capacity) {
+            return false;
+        }
+        const size_t token = op++;
+        const size_t literal_nibble = std::min<size_t>(literal_length, 15);
+        if (literal_nibble == 15) {
+            write_length(dst, op, literal_length - 15);
+        }
+        if (literal_length > 0) {
+            std::memcpy(dst + op, literals, literal_length);
+            op += literal_length;
+        }
+        if (match_length == 0) {
+            dst[token] = static_cast<unsigned char>(literal_nibble << 4);
+            return true;
+        }
+
+        dst[op++] = static_cast<unsigned char>(offset);
+        dst[op++] = static_cast<unsigned char>(offset >> 8);
+        const size_t match_nibble = std::min<size_t>(match_length - min_match, 15);
+        if (match_nibble == 15) {
+            write_length(dst, op, match_length - min_match - 15);
+        }
+        dst[token] = static_cast<unsigned char>(literal_nibble << 4 | match_nibble);
+        return true;
+    }
+};
+
+} // namespace archive::compression
+
+
+namespace archive::storage {
+
+/// Compresses written bytes block by block into a sink storage. `flush()` ends the current block early,
+/// so blocks are at most `block_size` bytes. With `compress_on(pool)` full blocks are compressed
+/// concurrently and written in order, the output does not change. Sinks that keep references to written
+/// memory, such as `GatherWriter`, are flushed after each block because block buffers are reused
+template<typename Sink, typename Codec = compression::Lz>
+class CompressWriter {
+public:
+    static constexpr size_t default_block_size = size_t(64) << 10;
+    static constexpr size_t max_block_size = size_t(1) << 30;
+
+    explicit CompressWriter(Sink sink_, size_t block_size_ = default_block_size, Codec codec_ = {})
+        : sink(std::move(sink_))
+        , codec(std::move(codec_))
+        , block_size(std::clamp<size_t>(block_size_, 1, max_block_size))
+    {
+        block.reserve(block_size);
+    }
+
+    /// Constructs the sink in place from `sink_args`, for sinks that cannot be moved (e.g. `AsyncWriter`)
+    template<typename... SinkArgs>
+    CompressWriter(std::in_place_t, size_t block_size_, SinkArgs&&... sink_args)
+        : sink(std::forward<SinkArgs>(sink_args)...)
+        , codec()
+        , block_size(std::clamp<size_t>(block_size_, 1, max_block_size))
+    {
+        block.reserve(block_size);
+    }
+
+    /// Only valid while no block is being compressed, e.g. before anything is written or after `flush()`
+    CompressWriter(CompressWriter&& other)
+        : sink(std::move(other.sink))
+        , codec(other.codec)
+        , block_size(other.block_size)
+        , block(std::move(other.block))
+        , pool(other.pool)
+        , raw_bytes(other.raw_bytes)
+        , stored_bytes(other.stored_bytes)
+        , closed(std::exchange(other.closed, true))
+    {
+        ARCHIVE_ASSERT(other.in_flight.empty());
+    }
+
+    CompressWriter(const CompressWriter&) = delete;
+    CompressWriter& operator=(const CompressWriter&) = delete;
+
+    ~CompressWriter() {
+        try {
+            close();
+        } catch (...) {
+        }
+        // tasks reference the codec
+        for (auto& task: in_flight) {
+            task.wait();
+        }
+    }
+
+    /// Compresses blocks on `pool`, which must outlive the writer. Pools with one thread compress inline
+    void compress_on(ThreadPool& pool_) { pool = &pool_; }
+
+    size_t write(const unsigned char* data, size_t size) {
+        const size_t total = size;
+        while (size > 0) {
+            const size_t count = std::min(size, block_size - block.size());
+            block.insert(block.end(), data, data + count);
+            data += count;
+            size -= count;
+            if (block.size() == block_size) {
+                submit_block();
+            }
+        }
+        raw_bytes += total;
+        return total;
+    }
+
+    /// Writes the current block and all blocks being compressed, then flushes the sink if it can be flushed
+    void flush() {
+        if (!block.empty()) {
+            submit_block();
+        }
+        while (!in_flight.empty()) {
+            write_front();
+        }
+        if constexpr (traits::has_flush_v<Sink>) {
+            sink.flush();
+        }
+    }
+
+    /// Flushes and closes the sink if it can be closed
+    void close() {
+        if (closed) {
+            return;
+        }
+        flush();
+        closed = true;
+        if constexpr (traits::has_close_v<Sink>) {
+            sink.close();
+        }
+    }
+
+    /// Bytes written to the adapter
+    usize size() const { return raw_bytes; }
+    /// Bytes written to the sink
+    usize compressed_size() const { return stored_bytes; }
+
+    Sink& get_sink() { return sink; }
+    const Sink& get_sink() const { return sink; }
+
+private:
+    struct Block {
+        std::vector<unsigned char> raw;
+        std::vector<unsigned char> encoded;
+    };
+
+    void submit_block() {
+        if (!pool || pool->size() < 2 || pool->is_worker()) {
+            encoded.clear();
+            compression::details::encode_block(codec, block.data(), block.size(), encoded);
+            block.clear();
+            write_encoded(encoded);
+            return;
+        }
+
+        // bounds memory held by compressed blocks that wait for their turn to be written
+        if (in_flight.size() >= 2 * pool->size()) {
+            write_front();
+        }
+        Block task;
+        if (!spare.empty()) {
+            task = std::move(spare.back());
+            spare.pop_back();
+        }
+        std::swap(task.raw, block);
+        block.clear();
+        block.reserve(block_size);
+        in_flight.push_back(pool->submit([this, task = std::move(task)] () mutable {
+            task.encoded.clear();
+            compression::details::encode_block(codec, task.raw.data(), task.raw.size(), task.encoded);
+            return std::move(task);
+        }));
+    }
+
+    void write_front() {
+        Block done = in_flight.front().get();
+        in_flight.pop_front();
+        write_encoded(done.encoded);
+        done.raw.clear();
+        spare.push_back(std::move(done));
+    }
+
+    void write_encoded(const std::vector<unsigned char>& bytes) {
+        sink.write(bytes.data(), bytes.size());
+        stored_bytes += bytes.size();
+        if constexpr (traits::references_writes_v<Sink>) {
+            sink.flush();
+        }
+    }
+
+    Sink sink;
+    const Codec codec;
+    const size_t block_size;
+    std::vector<unsigned char> block;
+    std::vector<unsigned char> encoded;
+    ThreadPool* pool = nullptr;
+    std::deque<std::future<Block>> in_flight;
+    std::vector<Block> spare;
+    usize raw_bytes = 0;
+    usize stored_bytes = 0;
+    bool closed = false;
+};
+
+
+/// Reads bytes written by `CompressWriter` from a source storage, decompressing a block at a time.
+/// Skipped blocks are not decompressed when the source can `advance`
+template<typename Source, typename Codec = compression::Lz>
+class DecompressReader {
+public:
+    explicit DecompressReader(Source source_, Codec codec_ = {})
+        : source(std::move(source_))
+        , codec(std::move(codec_))
+    {}
+
+    void read(unsigned char* data, size_t size) {
+        while (size > 0) {
+            if (position == block.size()) {
+                load_block(read_header());
+            }
+            const size_t count = std::min(size, block.size() - position);
+            std::memcpy(data, block.data() + position, count);
+            position += count;
+            data += count;
+            size -= count;
+        }
+    }
+
+    void advance(size_t size) {
+        while (size > 0) {
+            if (position == block.size()) {
+                const compression::details::BlockHeader header = read_header();
+                if constexpr (traits::has_advance_v<Source>) {
+                    if (header.raw_size <= size) {
+                        source.advance(header.stored_size);
+                        size -= header.raw_size;
+                        continue;
+                    }
+                }
+                load_block(header);
+            }
+            const size_t count = std::min(size, block.size() - position);
+            position += count;
+            size -= count;
+        }
+    }
+
+    Source& get_source() { return source; }
+    const Source& get_source() const { return source; }
+
+private:
+    compression::details::BlockHeader read_header() {
+        unsigned char bytes[compression::block_header_size];
+        source.read(bytes, sizeof(bytes));
+        const compression::details::BlockHeader header = compression::details::decode_block_header(bytes);
+        if (header.raw_size == 0 || (header.codec != compression::stored_id && header.codec != Codec::id)
+                || (header.codec == compression::stored_id && header.stored_size != header.raw_size)) {
+            compression::details::throw_corrupted();
+        }
+        return header;
+    }
+
+    void load_block(const compression::details::BlockHeader& header) {
+        block.resize(header.raw_size);
+        position = 0;
+        if (header.codec == compression::stored_id) {
+            source.read(block.data(), block.size());
+        } else {
+            stored.resize(header.stored_size);
+            source.read(stored.data(), stored.size());
+            codec.decompress(stored.data(), stored.size(), block.data(), block.size());
+        }
+    }
+
+    Source source;
+    const Codec codec;
+    std::vector<unsigned char> block;
+    std::vector<unsigned char> stored;
+    size_t position = 0;
+};
+
+} // namespace archive::storage
+
+#undef ARCHIVE_ASSERT
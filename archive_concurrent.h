@@ -0,0 +1,249 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/// Lock-free multi-producer log over a shared ring buffer:
+///    archive::ConcurrentLog<> log(size_t(64) << 20);
+///    log.write(event, timestamp);                                  // from any number of threads
+///    log.poll([] (const auto& record) { handle(record.get<Event>()); });   // from one consumer thread
+///
+/// A producer measures its record with a counting pass, reserves `header + record` bytes with one
+/// `fetch_add` on the shared head and serializes straight into its slot, no lock is taken.
+/// The slot header is published last, so the consumer only sees fully written records, in reservation
+/// order. Records may wrap around the end of the ring. When the ring is full producers wait for
+/// the consumer to release space.
+/// Errors are reported with `std::system_error`
+namespace archive {
+
+namespace details {
+
+/// Storage writing into a reserved slot of a ring, wrapping around its end
+class RingSlot {
+public:
+    RingSlot(unsigned char* ring_, size_t capacity_, size_t offset_, size_t length_)
+        : ring(ring_), capacity(capacity_), offset(offset_), left(length_)
+    {}
+
+    size_t write(const unsigned char* data, size_t size) {
+        if (size > left) {
+            // the counting pass and the real one disagree, don't touch neighbouring slots
+            throw std::system_error(std::make_error_code(std::errc::message_size), "archive: record is larger than measured");
+        }
+        const size_t first = std::min(size, capacity - offset);
+        std::memcpy(ring + offset, data, first);
+        std::memcpy(ring, data + first, size - first);
+        offset = offset + size < capacity ? offset + size : offset + size - capacity;
+        left -= size;
+        return size;
+    }
+
+private:
+    unsigned char* ring;
+    size_t capacity;
+    size_t offset;
+    size_t left;
+};
+
+} // namespace details
+
+
+/// Bounded ring of records written concurrently by many producers and read by a single consumer
+template<typename Encoding = encoding::Fixed, typename ByteOrder = byte_order::Native>
+class ConcurrentLog {
+public:
+    using Archive = BinaryArchive<storage::MemoryReader, storage_policy::Inline, Encoding, ByteOrder>;
+
+    /// Slot header: 0 while the slot is being written, `length << 2 | state` once it is published
+    static constexpr size_t header_size = sizeof(std::uint64_t);
+    static constexpr size_t alignment = sizeof(std::uint64_t);
+
+    static_assert(std::atomic<std::uint64_t>::is_always_lock_free && sizeof(std::atomic<std::uint64_t>) == header_size,
+                  "slot headers are atomics placed in the ring");
+
+    /// Record passed to `poll` handlers, its bytes are valid until the handler returns
+    class Record {
+    public:
+        const unsigned char* data() const { return bytes; }
+        size_t size() const { return length; }
+
+        /// Archive reading the record bytes
+        Archive archive() const { return Archive(bytes, length); }
+
+        template<typename T>
+        T get() const {
+            T value {};
+            read(value);
+            return value;
+        }
+
+        /// Reads objects in the order they were written, objects with `stream_serialization` are supported
+        template<typename... Objects>
+        void read(Objects&... objects) const {
+            stream::Reader<Archive> reader(bytes, length);
+            (reader >> ... >> objects);
+        }
+
+    private:
+        friend class ConcurrentLog;
+
+        const unsigned char* bytes = nullptr;
+        size_t length = 0;
+    };
+
+    /// Ring of `capacity` bytes (rounded down to a multiple of 8) owned by the log
+    explicit ConcurrentLog(size_t capacity_)
+        : capacity(checked_capacity(capacity_))
+        , owned(new std::uint64_t[capacity / alignment]())
+        , ring(reinterpret_cast<unsigned char*>(owned.get()))
+    {}
+
+    /// Ring in external memory, e.g. an anonymous mapping. `memory` must be 8-byte aligned, zero-filled
+    /// and outlive the log
+    ConcurrentLog(void* memory, size_t size)
+        : capacity(checked_capacity(size))
+        , ring(static_cast<unsigned char*>(memory))
+    {
+        if (reinterpret_cast<std::uintptr_t>(memory) % alignment != 0) {
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument), "archive: ring memory is not aligned");
+        }
+    }
+
+    ConcurrentLog(const ConcurrentLog&) = delete;
+    ConcurrentLog& operator=(const ConcurrentLog&) = delete;
+
+    size_t get_capacity() const { return capacity; }
+
+    /// Bytes reserved by producers and not yet released by the consumer
+    usize pending_bytes() const {
+        // tail first: both only grow, and the acquire keeps the head load from seeing an older value
+        // than the records the consumer released, so the difference cannot wrap
+        const usize released = tail.load(std::memory_order_acquire);
+        return head.load(std::memory_order_relaxed) - released;
+    }
+
+    /// Appends one record holding `objects` serialized one after another. Safe to call from any thread.
+    /// A record that throws while being serialized into its slot is skipped by the consumer
+    template<typename... Objects>
+    void write(const Objects&... objects) {
+        storage::Counter counter;
+        {
+            stream::Writer<BinaryArchive<storage::Counter, storage_policy::NotOwningPointer, Encoding, ByteOrder>> measure(&counter);
+            (measure << ... << objects);
+        }
+        const usize length = counter.size;
+        const usize slot = aligned(header_size + length);
+        if (slot > capacity || length > max_length) {
+            throw std::system_error(std::make_error_code(std::errc::message_size), "archive: record does not fit the ring");
+        }
+
+        const usize position = head.fetch_add(slot, std::memory_order_relaxed);
+        while (position + slot - tail.load(std::memory_order_acquire) > capacity) {
+            std::this_thread::yield();
+        }
+
+        try {
+            details::RingSlot storage(ring, capacity, offset(position + header_size), static_cast<size_t>(length));
+            stream::Writer<BinaryArchive<details::RingSlot, storage_policy::NotOwningPointer, Encoding, ByteOrder>> writer(&storage);
+            (writer << ... << objects);
+        } catch (...) {
+            header_at(position).store(length << 2 | Discarded, std::memory_order_release);
+            throw;
+        }
+        header_at(position).store(length << 2 | Committed, std::memory_order_release);
+    }
+
+    /// Calls `handler(record)` for published records in reservation order, at most `max_records` of them,
+    /// and releases their space. Stops at the first slot still being written. Must be called from
+    /// one thread at a time. If the handler throws, its record stays in the log
+    template<typename Handler>
+    size_t poll(Handler&& handler, size_t max_records = size_t(-1)) {
+        size_t count = 0;
+        usize position = tail.load(std::memory_order_relaxed);
+        while (count < max_records) {
+            std::atomic<std::uint64_t>& header = header_at(position);
+            const std::uint64_t value = header.load(std::memory_order_acquire);
+            if (value == 0) {
+                break;
+            }
+            const size_t length = static_cast<size_t>(value >> 2);
+            const size_t slot = static_cast<size_t>(aligned(header_size + length));
+            const size_t first = offset(position + header_size);
+
+            if ((value & 3) == Committed) {
+                Record record;
+                record.length = length;
+                if (first + length <= capacity) {
+                    record.bytes = ring + first;
+                } else {
+                    scratch.resize(length);
+                    const size_t head_part = capacity - first;
+                    std::memcpy(scratch.data(), ring + first, head_part);
+                    std::memcpy(scratch.data() + head_part, ring, length - head_part);
+                    record.bytes = scratch.data();
+                }
+                handler(static_cast<const Record&>(record));
+                ++count;
+            }
+
+            // slots of the next lap start anywhere, so released bytes must read as unpublished headers
+            zero(first, slot - header_size);
+            header.store(0, std::memory_order_relaxed);
+            position += slot;
+            tail.store(position, std::memory_order_release);
+        }
+        return count;
+    }
+
+private:
+    enum : std::uint64_t {
+        Committed = 1,
+        Discarded = 2,
+    };
+    static constexpr usize max_length = usize(-1) >> 2;
+
+    static size_t checked_capacity(size_t size) {
+        const size_t result = size - size % alignment;
+        if (result < 2 * header_size) {
+            throw std::system_error(std::make_error_code(std::errc::invalid_argument), "archive: ring is too small");
+        }
+        return result;
+    }
+
+    static usize aligned(usize size) {
+        return (size + alignment - 1) / alignment * alignment;
+    }
+
+    size_t offset(usize position) const {
+        return static_cast<size_t>(position % capacity);
+    }
+
+    /// Headers are 8-byte aligned and never wrap: slots and the capacity are multiples of 8
+    std::atomic<std::uint64_t>& header_at(usize position) const {
+        return *reinterpret_cast<std::atomic<std::uint64_t>*>(ring + offset(position));
+    }
+
+    void zero(size_t first, size_t size) {
+        const size_t head_part = std::min(size, capacity - first);
+        std::memset(ring + first, 0, head_part);
+        std::memset(ring, 0, size - head_part);
+    }
+
+    const size_t capacity;
+    std::unique_ptr<std::uint64_t[]> owned;
+    unsigned char* const ring;
+    /// Producers and the consumer touch different counters, keep them on separate cache lines
+    alignas(64) std::atomic<usize> head {0};
+    alignas(64) std::atomic<usize> tail {0};
+    std::vector<unsigned char> scratch;
+};
+
+} // namespace archive
@@ -0,0 +1,200 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/// File descriptor storages (POSIX only).
+/// Errors are reported with `std::system_error`
+namespace archive::storage {
+
+/// Buffered file writer that avoids copying large blobs.
+/// Small writes are coalesced into a staging buffer. Writes of at least `reference_threshold`
+/// bytes are not copied: they are recorded as `iovec` entries pointing at the caller memory
+/// and everything goes out in order with `writev` on `flush()`.
+///
+/// LIFETIME CONTRACT: memory passed to a `write()` of `reference_threshold` bytes or more
+/// must stay alive and unchanged until the next `flush()`/`close()` returns.
+/// Archive itself only writes from stack temporaries smaller than `min_reference_threshold`
+class GatherWriter {
+public:
+    static constexpr size_t default_staging_size = size_t(64) << 10;
+    static constexpr size_t default_reference_threshold = size_t(16) << 10;
+    /// Stack chunks used by `BinaryArchive` (byte swapping, varint runs) are always copied
+    static constexpr size_t min_reference_threshold = archive::details::chunk_size + archive::details::max_varint_size + 1;
+    /// Writes of `reference_threshold` bytes or more are referenced until `flush()`, see `traits::references_writes`
+    static constexpr bool references_writes = true;
+
+    GatherWriter() = default;
+
+    explicit GatherWriter(const std::string& path,
+                          size_t staging_size = default_staging_size,
+                          size_t reference_threshold_ = default_reference_threshold) {
+        open(path, staging_size, reference_threshold_);
+    }
+
+    /// Writes to an already open descriptor, which is not closed by the writer
+    explicit GatherWriter(int fd_,
+                          size_t staging_size = default_staging_size,
+                          size_t reference_threshold_ = default_reference_threshold) {
+        attach(fd_, false, staging_size, reference_threshold_);
+    }
+
+    GatherWriter(GatherWriter&& other) noexcept { *this = std::move(other); }
+
+    GatherWriter& operator=(GatherWriter&& other) noexcept {
+        if (this != &other) {
+            close_silent();
+            fd = std::exchange(other.fd, -1);
+            owns_fd = other.owns_fd;
+            staging = std::move(other.staging);
+            staging_capacity = other.staging_capacity;
+            staging_used = std::exchange(other.staging_used, 0);
+            staging_sealed = std::exchange(other.staging_sealed, 0);
+            reference_threshold = other.reference_threshold;
+            pending = std::move(other.pending);
+            written = std::exchange(other.written, 0);
+        }
+        return *this;
+    }
+
+    ~GatherWriter() { close_silent(); }
+
+    /// Creates or truncates file at `path`
+    void open(const std::string& path,
+              size_t staging_size = default_staging_size,
+              size_t reference_threshold_ = default_reference_threshold) {
+        close();
+        const int new_fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (new_fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "archive: cannot open file for writing");
+        }
+        attach(new_fd, true, staging_size, reference_threshold_);
+    }
+
+    /// Flushes pending data and closes the descriptor if it is owned by the writer
+    void close() {
+        if (fd < 0) {
+            return;
+        }
+        flush();
+        if (owns_fd && ::close(fd) != 0) {
+            fd = -1;
+            throw std::system_error(errno, std::generic_category(), "archive: cannot close file");
+        }
+        fd = -1;
+    }
+
+    bool is_open() const { return fd >= 0; }
+
+    size_t write(const unsigned char* data, size_t size) {
+        if (size >= reference_threshold) {
+            seal_staging();
+            if (pending.size() + 1 > max_pending) {
+                flush();
+            }
+            pending.push_back({const_cast<unsigned char*>(data), size});
+        } else {
+            if (staging_used + size > staging_capacity) {
+                flush();
+            }
+            std::memcpy(staging.get() + staging_used, data, size);
+            staging_used += size;
+        }
+        return size;
+    }
+
+    /// Writes staged and referenced data with `writev`.
+    /// After it returns, memory passed to `write()` may be released
+    void flush() {
+        seal_staging();
+        size_t first = 0;
+        while (first < pending.size()) {
+            const int count = static_cast<int>(std::min<size_t>(pending.size() - first, max_iov));
+            const ssize_t result = ::writev(fd, pending.data() + first, count);
+            if (result < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "archive: cannot write file");
+            }
+            written += static_cast<size_t>(result);
+            // skip fully written entries and adjust a partially written one
+            size_t done = static_cast<size_t>(result);
+            while (first < pending.size() && done >= pending[first].iov_len) {
+                done -= pending[first].iov_len;
+                ++first;
+            }
+            if (done) {
+                pending[first].iov_base = static_cast<unsigned char*>(pending[first].iov_base) + done;
+                pending[first].iov_len -= done;
+            }
+        }
+        pending.clear();
+        staging_used = 0;
+        staging_sealed = 0;
+    }
+
+    /// Number of bytes that reached the file
+    size_t size() const { return written; }
+
+private:
+#if defined(IOV_MAX)
+    static constexpr size_t max_iov = IOV_MAX;
+#else
+    static constexpr size_t max_iov = 1024;
+#endif
+    /// Pending entries are flushed once there are too many of them
+    static constexpr size_t max_pending = 64 * max_iov;
+
+    void attach(int fd_, bool owns, size_t staging_size, size_t reference_threshold_) {
+        fd = fd_;
+        owns_fd = owns;
+        reference_threshold = std::max(reference_threshold_, min_reference_threshold);
+        // any write below the threshold must fit into the staging buffer
+        staging_capacity = std::max(staging_size, reference_threshold);
+        staging.reset(new unsigned char[staging_capacity]);
+        staging_used = 0;
+        staging_sealed = 0;
+        pending.clear();
+        written = 0;
+    }
+
+    /// Turns bytes staged since the last seal into an iovec so that ordering with referenced blobs is kept
+    void seal_staging() {
+        if (staging_used > staging_sealed) {
+            pending.push_back({staging.get() + staging_sealed, staging_used - staging_sealed});
+            staging_sealed = staging_used;
+        }
+    }
+
+    void close_silent() noexcept {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    int fd = -1;
+    bool owns_fd = false;
+    std::unique_ptr<unsigned char[]> staging;
+    size_t staging_capacity = 0;
+    size_t staging_used = 0;
+    size_t staging_sealed = 0;
+    size_t reference_threshold = default_reference_threshold;
+    std::vector<iovec> pending;
+    size_t written = 0;
+};
+
+} // namespace archive::storage
@@ -0,0 +1,545 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define ARCHIVE_ASSERT(x)
+
+/// Incremental decoding from input that arrives in fragments, e.g. a non-blocking socket:
+///    archive::IncrementalDecoder<Message> decoder;
+///    while (decoder.feed(data, size) == archive::DecodeStatus::NeedMoreData) { data, size = receive(); }
+///    Message message = decoder.take();    // bytes after `decoder.consumed()` belong to the next message
+/// The decoder is an explicit state machine over the same type dispatch as `BinaryArchive::deserialize`,
+/// so it reads exactly what `BinaryArchive::serialize` writes with the same encoding and byte order.
+/// Containers are filled as bytes arrive: primitive and trivially serializable elements are copied
+/// straight into the container, nothing is buffered except a value that is split between fragments.
+/// Types with user-defined serialization are opaque: their bytes are collected and decoding is retried
+/// once enough bytes arrived to get past the point where the previous attempt ran out of input.
+/// Each retry decodes the value from its first byte and usually gets one field further, so a large opaque
+/// value delivered in many small fragments costs O(size * fragments). Wrap such values in `archive::Lazy`:
+/// its length prefix lets the decoder wait for the whole value and decode it once
+namespace archive {
+
+enum class DecodeStatus {
+    NeedMoreData,
+    Done,
+};
+
+namespace details {
+
+/// Thrown by `UnderflowReader` when a read goes past the available bytes
+struct Underflow {
+    /// Total number of bytes the failed attempt needed at least
+    size_t needed;
+};
+
+/// Reader over the bytes collected for an opaque value
+class UnderflowReader {
+public:
+    UnderflowReader(const unsigned char* data_, size_t size_)
+        : begin(data_)
+        , length(size_)
+    {}
+
+    void read(unsigned char* data, size_t size) {
+        if (size > length - read_pos) {
+            throw Underflow{read_pos + size};
+        }
+        std::memcpy(data, begin + read_pos, size);
+        read_pos += size;
+    }
+
+    void advance(size_t size) {
+        if (size > length - read_pos) {
+            throw Underflow{read_pos + size};
+        }
+        read_pos += size;
+    }
+
+    size_t read_position() const { return read_pos; }
+
+private:
+    const unsigned char* begin;
+    size_t length;
+    size_t read_pos = 0;
+};
+
+} // namespace details
+
+
+/// Decodes a single `T` from byte fragments passed to `feed()`.
+/// Values are created with the memory resource set by `set_memory_resource`, like in `BinaryArchive`
+template<typename T, typename Encoding = encoding::Fixed, typename ByteOrder = byte_order::Native>
+class IncrementalDecoder {
+public:
+    IncrementalDecoder() { reset(); }
+
+    IncrementalDecoder(const IncrementalDecoder&) = delete;
+    IncrementalDecoder& operator=(const IncrementalDecoder&) = delete;
+
+    /// Drops the current state and starts decoding a new value
+    void reset() {
+        stack.clear();
+        partial_size = 0;
+        opaque.clear();
+        consumed_size = 0;
+        object.reset();
+        if constexpr (is_constructed_v<T>) {
+            push_constructed<T>(object);
+        } else {
+            object.emplace(details::make_value<T>(memory_resource));
+            push(*object);
+        }
+    }
+
+    /// Applies to values created after the next `reset()`
+    void set_memory_resource(std::pmr::memory_resource* resource) { memory_resource = resource; }
+    std::pmr::memory_resource* get_memory_resource() const { return memory_resource; }
+
+    /// Decodes as much as possible from `size` bytes at `data`. Stops at the end of the value,
+    /// so `consumed()` may be less than `size` when `Done` is returned
+    DecodeStatus feed(const void* data, size_t size) {
+        const auto* begin = static_cast<const unsigned char*>(data);
+        input = begin;
+        input_end = begin + size;
+        while (!stack.empty()) {
+            Frame& top = stack.back();
+            const Progress progress = top.step(*this, top);
+            if (progress == Progress::Done) {
+                stack.pop_back();
+            } else if (progress == Progress::Blocked) {
+                break;
+            }
+        }
+        consumed_size = static_cast<size_t>(input - begin);
+        input = input_end = nullptr;
+        return status();
+    }
+
+    DecodeStatus status() const { return stack.empty() ? DecodeStatus::Done : DecodeStatus::NeedMoreData; }
+    bool done() const { return stack.empty(); }
+
+    /// Number of bytes used from the last `feed()`
+    size_t consumed() const { return consumed_size; }
+
+    /// Value being decoded, complete once `done()`
+    T& value() { return *object; }
+    const T& value() const { return *object; }
+
+    /// Moves the decoded value out and starts decoding the next one
+    T take() {
+        ARCHIVE_ASSERT(done());
+        T result = std::move(*object);
+        reset();
+        return result;
+    }
+
+private:
+    /// Archive used to decode opaque values, its `is_block_v` drives the same block decisions
+    using OpaqueArchive = BinaryArchive<details::UnderflowReader, storage_policy::Inline, Encoding, ByteOrder>;
+
+    enum class Progress {
+        Done,
+        Blocked,
+        Pushed,
+    };
+
+    struct Frame {
+        Progress (*step)(IncrementalDecoder&, Frame&) = nullptr;
+        void* object = nullptr;
+        size_t phase = 0;
+        size_t index = 0;
+        size_t count = 0;
+        /// Element decoded by a child frame before it is inserted into a container
+        std::shared_ptr<void> element;
+    };
+
+    template<typename U>
+    static constexpr bool is_varint_v = Encoding::varint_integers && traits::is_varint_integer_v<U>;
+
+    /// Opaque values without a default constructor, created by their `from_archive_t` constructor
+    /// once decoded and then stored in their optional or container
+    template<typename U>
+    static constexpr bool is_constructed_v = !std::is_empty_v<U> && !traits::is_primitive_v<U> && !traits::is_container_v<U>
+            && !traits::is_tuple_like_v<U> && !traits::is_optional_v<U>
+            && !std::is_default_constructible_v<U> && details::is_archive_constructible_v<U, OpaqueArchive>;
+
+    template<typename U>
+    void push(U& value) {
+        Frame& frame = stack.emplace_back();
+        frame.step = &IncrementalDecoder::step<U>;
+        frame.object = &value;
+    }
+
+    /// Pushes a frame decoding a `U` into `target`, an optional or a container it is appended to
+    template<typename U, typename Target>
+    void push_constructed(Target& target) {
+        Frame& frame = stack.emplace_back();
+        frame.step = &IncrementalDecoder::step_constructed<U, Target>;
+        frame.object = &target;
+    }
+
+    template<typename U, typename Target>
+    static Progress step_constructed(IncrementalDecoder& decoder, Frame& frame) {
+        Target& target = *static_cast<Target*>(frame.object);
+        return decoder.template step_opaque<U>(frame, [&target] (U&& value) {
+            if constexpr (traits::is_optional_v<Target>) {
+                target.emplace(std::move(value));
+            } else {
+                details::emplace(target, std::move(value));
+            }
+        });
+    }
+
+    template<typename U>
+    static Progress step(IncrementalDecoder& decoder, Frame& frame) {
+        U& value = *static_cast<U*>(frame.object);
+        if constexpr (std::is_empty_v<U>) {
+            return Progress::Done;
+        } else if constexpr (traits::is_primitive_v<U>) {
+            return decoder.read_primitive(value) ? Progress::Done : Progress::Blocked;
+        } else if constexpr (traits::is_container_v<U>) {
+            return decoder.step_container(value, frame);
+        } else if constexpr (traits::is_tuple_like_v<U>) {
+            return decoder.step_tuple(value, frame);
+        } else if constexpr (traits::is_optional_v<U>) {
+            return decoder.step_optional(value, frame);
+        } else {
+            return decoder.template step_opaque<U>(frame, [&value] (U&& decoded) { value = std::move(decoded); });
+        }
+    }
+
+    template<typename Container>
+    Progress step_container(Container& container, Frame& frame) {
+        using Element = traits::remove_const_element_type_t<Container>;
+        constexpr bool resizable = traits::is_contiguous_v<Container> && traits::has_resize_v<Container>;
+        // phases: 0 - length, 1 - varint run size, 2 - raw bytes, 3 - elements, 4 - element in a child frame
+        if (frame.phase == 0) {
+            usize length = 0;
+            if (!read_length(length)) {
+                return Progress::Blocked;
+            }
+            frame.count = static_cast<size_t>(length);
+            frame.phase = 3;
+            if constexpr (is_varint_v<Element>) {
+                frame.phase = 1;
+            } else if constexpr (resizable && traits::is_primitive_v<Element>) {
+                frame.phase = 2;
+            } else if constexpr (resizable && OpaqueArchive::template is_block_v<Element>) {
+                frame.phase = 2;
+            }
+            if (frame.phase == 2 || (is_varint_v<Element> && resizable)) {
+                if constexpr (traits::has_resize_v<Container> && std::is_default_constructible_v<Element>) {
+                    container.resize(frame.count);
+                }
+            } else {
+                details::reserve_silent(container, frame.count);
+            }
+        }
+        if (frame.phase == 1) {
+            std::uint64_t run_size = 0;
+            if (!read_varint(run_size)) {
+                return Progress::Blocked;
+            }
+            frame.phase = 3;
+        }
+        if constexpr (resizable) {
+            if (frame.phase == 2) {
+                // `index` counts bytes here, a partially received element stays in place until completed
+                const size_t total = frame.count * sizeof(Element);
+                auto* bytes = reinterpret_cast<unsigned char*>(std::data(container));
+                frame.index += take(bytes + frame.index, total - frame.index);
+                if (frame.index < total) {
+                    return Progress::Blocked;
+                }
+                if constexpr (ByteOrder::swap && traits::is_primitive_v<Element> && sizeof(Element) > 1) {
+                    details::byteswap_elements<sizeof(Element)>(bytes, bytes, frame.count);
+                }
+                return Progress::Done;
+            }
+        }
+        while (frame.index < frame.count) {
+            if constexpr (traits::is_primitive_v<Element>) {
+                Element value {};
+                if (!read_primitive(value)) {
+                    return Progress::Blocked;
+                }
+                if constexpr (is_varint_v<Element> && resizable) {
+                    std::data(container)[frame.index] = value;
+                } else {
+                    details::emplace(container, value);
+                }
+                ++frame.index;
+            } else if constexpr (is_constructed_v<Element>) {
+                // appended by the child frame once decoded
+                if (frame.phase == 4) {
+                    frame.phase = 3;
+                    ++frame.index;
+                    continue;
+                }
+                frame.phase = 4;
+                push_constructed<Element>(container);
+                return Progress::Pushed;
+            } else if constexpr (traits::has_push_back_v<Container>) {
+                // decoded in place, nothing else is added to the container until the child frame is done (phase 4)
+                if (frame.phase == 4) {
+                    frame.phase = 3;
+                    ++frame.index;
+                    continue;
+                }
+                container.push_back(details::make_element<Element>(container, memory_resource));
+                frame.phase = 4;
+                push(container.back());
+                return Progress::Pushed;
+            } else {
+                if (frame.element) {
+                    details::emplace(container, std::move(*static_cast<Element*>(frame.element.get())));
+                    frame.element.reset();
+                    ++frame.index;
+                    continue;
+                }
+                auto element = std::make_shared<Element>(details::make_element<Element>(container, memory_resource));
+                Element& ref = *element;
+                frame.element = std::move(element);
+                push(ref);
+                return Progress::Pushed;
+            }
+        }
+        return Progress::Done;
+    }
+
+    template<typename Gettable>
+    Progress step_tuple(Gettable& object, Frame& frame) {
+        constexpr size_t N = std::tuple_size<Gettable>::value;
+        if constexpr (Encoding::varint_integers && traits::is_contiguous_varint_integer_v<Gettable>) {
+            if (frame.phase == 0) {
+                std::uint64_t run_size = 0;
+                if (!read_varint(run_size)) {
+                    return Progress::Blocked;
+                }
+                frame.phase = 1;
+            }
+            for (; frame.index < N; ++frame.index) {
+                if (!read_primitive(std::data(object)[frame.index])) {
+                    return Progress::Blocked;
+                }
+            }
+            return Progress::Done;
+        } else {
+            // phase 1 means the child frame of element `index` is done
+            while (frame.index < N) {
+                if (frame.phase == 1) {
+                    frame.phase = 0;
+                    ++frame.index;
+                    continue;
+                }
+                const Progress progress = step_element(object, frame, std::make_index_sequence<N>{});
+                if (progress != Progress::Done) {
+                    return progress;
+                }
+                ++frame.index;
+            }
+            return Progress::Done;
+        }
+    }
+
+    /// Reads element `frame.index` of a tuple in place if it is a primitive, pushes a child frame otherwise
+    template<typename Gettable, size_t... I>
+    Progress step_element(Gettable& object, Frame& frame, std::index_sequence<I...>) {
+        // `frame` is invalidated by `push`
+        const size_t index = frame.index;
+        Progress progress = Progress::Done;
+        const auto visit = [&] (auto& element) {
+            using Element = std::remove_reference_t<decltype(element)>;
+            if constexpr (traits::is_primitive_v<Element>) {
+                progress = read_primitive(element) ? Progress::Done : Progress::Blocked;
+            } else {
+                frame.phase = 1;
+                push(element);
+                progress = Progress::Pushed;
+            }
+        };
+        using std::get;
+        ((I == index ? visit(get<I>(object)) : void()), ...);
+        return progress;
+    }
+
+    template<typename Optional>
+    Progress step_optional(Optional& optional, Frame& frame) {
+        if (frame.phase == 1) {
+            return Progress::Done;
+        }
+        bool has_value = false;
+        if (!read_primitive(has_value)) {
+            return Progress::Blocked;
+        }
+        if (!has_value) {
+            optional.reset();
+            return Progress::Done;
+        }
+        using Value = std::remove_reference_t<decltype(*optional)>;
+        frame.phase = 1;
+        if constexpr (is_constructed_v<Value>) {
+            optional.reset();
+            push_constructed<Value>(optional);
+        } else {
+            optional = details::make_value<Value>(memory_resource);
+            push(*optional);
+        }
+        return Progress::Pushed;
+    }
+
+    /// Decodes a value with `BinaryArchive`, retrying from its first byte when more input arrives,
+    /// and passes it to `store(U&&)`. `frame.count` is the number of bytes the last attempt needed at least
+    template<typename U, typename Store>
+    Progress step_opaque(Frame& frame, Store&& store) {
+        const size_t available = static_cast<size_t>(input_end - input);
+        if (opaque.empty()) {
+            // first attempt straight from the input, without copying
+            size_t used = 0;
+            if (available >= frame.count && try_decode<U>(input, available, store, used, frame.count)) {
+                input += used;
+                return Progress::Done;
+            }
+            opaque.assign(input, input_end);
+            input = input_end;
+            return Progress::Blocked;
+        }
+        const size_t buffered = opaque.size();
+        if (buffered + available < frame.count) {
+            opaque.insert(opaque.end(), input, input_end);
+            input = input_end;
+            return Progress::Blocked;
+        }
+        opaque.insert(opaque.end(), input, input_end);
+        size_t used = 0;
+        if (try_decode<U>(opaque.data(), opaque.size(), store, used, frame.count)) {
+            // bytes past the value stay in the input
+            input += used - buffered;
+            opaque.clear();
+            return Progress::Done;
+        }
+        input = input_end;
+        return Progress::Blocked;
+    }
+
+    /// Types with a `from_archive_t` constructor are created by it, as in `BinaryArchive::deserialize<T>()`
+    template<typename U, typename Store>
+    bool try_decode(const unsigned char* data, size_t size, Store& store, size_t& used, size_t& needed) {
+        OpaqueArchive archive(data, size);
+        archive.set_memory_resource(memory_resource);
+        try {
+            store(archive.template deserialize<U>());
+        } catch (const details::Underflow& underflow) {
+            needed = underflow.needed;
+            return false;
+        }
+        used = archive.get_storage().read_position();
+        return true;
+    }
+
+    /// Copies up to `size` input bytes to `data`, returns how many were copied
+    size_t take(unsigned char* data, size_t size) {
+        const size_t count = std::min(size, static_cast<size_t>(input_end - input));
+        if (count > 0) {
+            std::memcpy(data, input, count);
+            input += count;
+        }
+        return count;
+    }
+
+    /// Reads `size` bytes or keeps what is available for the next attempt, which must ask for the same size
+    bool read_bytes(unsigned char* data, size_t size) {
+        const size_t needed = size - partial_size;
+        const size_t available = static_cast<size_t>(input_end - input);
+        if (available < needed) {
+            std::memcpy(partial + partial_size, input, available);
+            partial_size += available;
+            input = input_end;
+            return false;
+        }
+        std::memcpy(data, partial, partial_size);
+        std::memcpy(data + partial_size, input, needed);
+        input += needed;
+        partial_size = 0;
+        return true;
+    }
+
+    bool read_varint(std::uint64_t& value) {
+        while (input != input_end && partial_size < details::max_varint_size) {
+            const unsigned char byte = *input++;
+            partial[partial_size++] = byte;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        if (partial_size == 0 || ((partial[partial_size - 1] & 0x80) && partial_size < details::max_varint_size)) {
+            return false;
+        }
+        details::decode_varint(partial, value);
+        partial_size = 0;
+        return true;
+    }
+
+    template<typename Primitive>
+    bool read_primitive(Primitive& primitive) {
+        if constexpr (is_varint_v<Primitive>) {
+            std::uint64_t value = 0;
+            if (!read_varint(value)) {
+                return false;
+            }
+            primitive = details::from_varint<Primitive>(value);
+            return true;
+        } else {
+            static_assert(sizeof(Primitive) <= sizeof(partial), "Primitive is too large");
+            unsigned char bytes[sizeof(Primitive)];
+            if (!read_bytes(bytes, sizeof(Primitive))) {
+                return false;
+            }
+            std::memcpy(&primitive, bytes, sizeof(Primitive));
+            if constexpr (ByteOrder::swap && sizeof(Primitive) > 1) {
+                primitive = details::byteswap(primitive);
+            }
+            return true;
+        }
+    }
+
+    bool read_length(usize& length) {
+        if constexpr (Encoding::varint_lengths) {
+            std::uint64_t value = 0;
+            if (!read_varint(value)) {
+                return false;
+            }
+            length = value;
+            return true;
+        } else {
+            return read_primitive(length);
+        }
+    }
+
+    std::optional<T> object;
+    std::vector<Frame> stack;
+    std::pmr::memory_resource* memory_resource = nullptr;
+
+    const unsigned char* input = nullptr;
+    const unsigned char* input_end = nullptr;
+    size_t consumed_size = 0;
+
+    /// Beginning of a primitive or varint split between fragments
+    unsigned char partial[16];
+    size_t partial_size = 0;
+    /// Bytes of an opaque value collected so far
+    std::vector<unsigned char> opaque;
+};
+
+} // namespace archive
+
+#undef ARCHIVE_ASSERT
@@ -0,0 +1,282 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ARCHIVE_ASSERT(x)
+
+/// Memory-mapped file storages (POSIX only).
+/// Both storages are default constructible and movable, so they work with every `storage_policy`:
+///    BinaryArchive<MmapReader> archive("file.bin");                                  // Parent
+///    BinaryArchive<MmapReader, storage_policy::Inline> archive("file.bin");          // Inline
+///    BinaryArchive<MmapReader, storage_policy::NotOwningPointer> archive(&reader);   // NotOwningPointer
+/// Errors are reported with `std::system_error`
+namespace archive::storage {
+
+namespace details {
+
+[[noreturn]] inline void throw_errno(const char* what) {
+    throw std::system_error(errno, std::generic_category(), what);
+}
+
+} // namespace details
+
+
+/// Maps whole file into memory for reading. Implements contiguous storage interface,
+/// so primitive arrays are read with a single memcpy and views point straight into the mapping
+class MmapReader {
+public:
+    /// Access pattern hint passed to `madvise`
+    enum class Access {
+        Normal,
+        Sequential,
+        Random,
+    };
+
+    MmapReader() = default;
+
+    explicit MmapReader(const std::string& path, Access access = Access::Sequential) {
+        open(path, access);
+    }
+
+    MmapReader(MmapReader&& other) noexcept
+        : begin(std::exchange(other.begin, nullptr))
+        , length(std::exchange(other.length, 0))
+        , read_pos(std::exchange(other.read_pos, 0))
+    {}
+
+    MmapReader& operator=(MmapReader&& other) noexcept {
+        if (this != &other) {
+            close();
+            begin = std::exchange(other.begin, nullptr);
+            length = std::exchange(other.length, 0);
+            read_pos = std::exchange(other.read_pos, 0);
+        }
+        return *this;
+    }
+
+    ~MmapReader() { close(); }
+
+    void open(const std::string& path, Access access = Access::Sequential) {
+        close();
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) {
+            details::throw_errno("archive: cannot open file for reading");
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) != 0) {
+            const int error = errno;
+            ::close(fd);
+            errno = error;
+            details::throw_errno("archive: cannot stat file");
+        }
+        length = static_cast<size_t>(info.st_size);
+        if (length > 0) {
+            void* mapping = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping == MAP_FAILED) {
+                const int error = errno;
+                ::close(fd);
+                length = 0;
+                errno = error;
+                details::throw_errno("archive: cannot map file");
+            }
+            begin = static_cast<const unsigned char*>(mapping);
+        }
+        // mapping stays valid after the descriptor is closed
+        ::close(fd);
+        read_pos = 0;
+        advise(access);
+    }
+
+    void close() {
+        if (begin) {
+            ::munmap(const_cast<unsigned char*>(begin), length);
+        }
+        begin = nullptr;
+        length = 0;
+        read_pos = 0;
+    }
+
+    /// Tells the kernel how the mapping is going to be read: sequential access enables
+    /// aggressive read-ahead, random access disables it
+    void advise(Access access) {
+        if (!begin) {
+            return;
+        }
+        int advice = MADV_NORMAL;
+        if (access == Access::Sequential) {
+            advice = MADV_SEQUENTIAL;
+        } else if (access == Access::Random) {
+            advice = MADV_RANDOM;
+        }
+        ::madvise(const_cast<unsigned char*>(begin), length, advice);
+    }
+
+    bool is_open() const { return begin != nullptr; }
+
+    void read(unsigned char* data, size_t size) {
+        ARCHIVE_ASSERT(read_pos + size <= length);
+        std::memcpy(data, begin + read_pos, size);
+        read_pos += size;
+    }
+
+    const unsigned char* data() const { return begin; }
+    size_t size() const { return length; }
+
+    size_t read_position() const { return read_pos; }
+    void advance(size_t size) {
+        ARCHIVE_ASSERT(read_pos + size <= length);
+        read_pos += size;
+    }
+
+private:
+    const unsigned char* begin = nullptr;
+    size_t length = 0;
+    size_t read_pos = 0;
+};
+
+
+/// Writes into a shared file mapping. The file is grown in `grow_size` steps with `ftruncate`
+/// and remapped, `close()` truncates it to the number of bytes actually written
+class MmapWriter {
+public:
+    static constexpr size_t default_grow_size = size_t(64) << 20;
+
+    MmapWriter() = default;
+
+    explicit MmapWriter(const std::string& path, size_t grow_size_ = default_grow_size) {
+        open(path, grow_size_);
+    }
+
+    MmapWriter(MmapWriter&& other) noexcept
+        : fd(std::exchange(other.fd, -1))
+        , begin(std::exchange(other.begin, nullptr))
+        , capacity(std::exchange(other.capacity, 0))
+        , write_pos(std::exchange(other.write_pos, 0))
+        , grow_size(other.grow_size)
+    {}
+
+    MmapWriter& operator=(MmapWriter&& other) noexcept {
+        if (this != &other) {
+            close_silent();
+            fd = std::exchange(other.fd, -1);
+            begin = std::exchange(other.begin, nullptr);
+            capacity = std::exchange(other.capacity, 0);
+            write_pos = std::exchange(other.write_pos, 0);
+            grow_size = other.grow_size;
+        }
+        return *this;
+    }
+
+    ~MmapWriter() { close_silent(); }
+
+    /// Creates or truncates file at `path`
+    void open(const std::string& path, size_t grow_size_ = default_grow_size) {
+        close();
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            details::throw_errno("archive: cannot open file for writing");
+        }
+        const long page = ::sysconf(_SC_PAGESIZE);
+        const size_t page_size = page > 0 ? static_cast<size_t>(page) : 4096;
+        grow_size = std::max(page_size, (grow_size_ + page_size - 1) / page_size * page_size);
+        write_pos = 0;
+    }
+
+    /// Unmaps the file and truncates it to the written size
+    void close() {
+        if (fd < 0) {
+            return;
+        }
+        unmap();
+        const int result = ::ftruncate(fd, static_cast<off_t>(write_pos));
+        const int error = errno;
+        ::close(fd);
+        fd = -1;
+        if (result != 0) {
+            errno = error;
+            details::throw_errno("archive: cannot truncate file");
+        }
+    }
+
+    /// Schedules written pages to be flushed to disk
+    void sync(bool wait = false) {
+        if (begin && ::msync(begin, capacity, wait ? MS_SYNC : MS_ASYNC) != 0) {
+            details::throw_errno("archive: cannot sync file mapping");
+        }
+    }
+
+    bool is_open() const { return fd >= 0; }
+
+    size_t write(const unsigned char* data, size_t size) {
+        if (write_pos + size > capacity) {
+            grow(write_pos + size);
+        }
+        std::memcpy(begin + write_pos, data, size);
+        write_pos += size;
+        return size;
+    }
+
+    /// Number of bytes written so far
+    size_t size() const { return write_pos; }
+
+private:
+    void grow(size_t required) {
+        ARCHIVE_ASSERT(fd >= 0);
+        const size_t new_capacity = std::max(capacity + grow_size, (required + grow_size - 1) / grow_size * grow_size);
+        if (::ftruncate(fd, static_cast<off_t>(new_capacity)) != 0) {
+            details::throw_errno("archive: cannot grow file");
+        }
+        void* mapping = MAP_FAILED;
+#if defined(__linux__)
+        if (begin) {
+            mapping = ::mremap(begin, capacity, new_capacity, MREMAP_MAYMOVE);
+        } else
+#endif
+        {
+            unmap();
+            mapping = ::mmap(nullptr, new_capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        }
+        if (mapping == MAP_FAILED) {
+            details::throw_errno("archive: cannot map file");
+        }
+        begin = static_cast<unsigned char*>(mapping);
+        capacity = new_capacity;
+        ::madvise(begin, capacity, MADV_SEQUENTIAL);
+    }
+
+    void unmap() {
+        if (begin) {
+            ::munmap(begin, capacity);
+        }
+        begin = nullptr;
+        capacity = 0;
+    }
+
+    void close_silent() noexcept {
+        try {
+            close();
+        } catch (...) {
+        }
+    }
+
+    int fd = -1;
+    unsigned char* begin = nullptr;
+    size_t capacity = 0;
+    size_t write_pos = 0;
+    size_t grow_size = default_grow_size;
+};
+
+} // namespace archive::storage
+
+#undef ARCHIVE_ASSERT
@@ -0,0 +1,290 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/// Multi-threaded serialization of large containers:
+///    archive.serialize(records, archive::parallel);
+///    archive.serialize(records, archive::parallel.on(pool).with_chunk_length(512));
+/// Elements are split into chunks, each chunk is serialized on a worker into its own buffer
+/// and buffers are written to the archive storage in order, so the output is byte for byte
+/// the same as `archive.serialize(records)`.
+/// Element serialization must not depend on shared mutable state (e.g. a user `serialize_object`
+/// that counts calls), as chunks are serialized concurrently.
+/// `Indexed` containers are decoded in parallel from contiguous storages:
+///    archive.deserialize(archive::Indexed(records), archive::parallel);
+namespace archive {
+
+/// Fixed-size pool of worker threads executing tasks in submission order
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t threads = default_concurrency()) {
+        threads = std::max<size_t>(threads, 1);
+        workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { work(); });
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Finishes queued tasks and joins workers
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker: workers) {
+            worker.join();
+        }
+    }
+
+    static size_t default_concurrency() {
+        return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    size_t size() const { return workers.size(); }
+
+    /// True when called from one of the pool workers. Waiting for the pool from its own worker
+    /// could deadlock, so parallel algorithms run sequentially there
+    bool is_worker() const { return current_pool() == this; }
+
+    /// Runs `task` on a worker, the future carries its result or exception
+    template<typename Task>
+    std::future<std::invoke_result_t<std::decay_t<Task>&>> submit(Task&& task) {
+        using Result = std::invoke_result_t<std::decay_t<Task>&>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace_back([packaged] { (*packaged)(); });
+        }
+        wake.notify_one();
+        return result;
+    }
+
+private:
+    static const ThreadPool*& current_pool() {
+        thread_local const ThreadPool* pool = nullptr;
+        return pool;
+    }
+
+    void work() {
+        current_pool() = this;
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (tasks.empty()) {
+                    return;
+                }
+                task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+};
+
+/// Pool used by execution policies that were not given one, created on first use
+inline ThreadPool& default_thread_pool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+
+/// Execution policy serializing container elements and decoding `Indexed` chunks on a `ThreadPool`
+class ParallelPolicy {
+public:
+    static constexpr size_t default_min_chunk_length = 1024;
+    /// Chunks per worker: more chunks balance uneven elements better, fewer chunks copy less
+    static constexpr size_t chunks_per_thread = 4;
+
+    /// Runs on `pool` instead of `default_thread_pool()`. The pool must outlive the policy
+    constexpr ParallelPolicy on(ThreadPool& pool_) const {
+        ParallelPolicy policy = *this;
+        policy.pool = &pool_;
+        return policy;
+    }
+
+    /// Chunks have at least `length` elements, shorter containers are serialized sequentially
+    constexpr ParallelPolicy with_chunk_length(size_t length) const {
+        ParallelPolicy policy = *this;
+        policy.min_chunk_length = std::max<size_t>(length, 1);
+        return policy;
+    }
+
+    ThreadPool& get_pool() const { return pool ? *pool : default_thread_pool(); }
+
+    /// Serializes `length` elements starting at `first` into `archive`, in order.
+    /// Called by `BinaryArchive::serialize(container, policy)` after the container length is written
+    template<typename Archive, typename Iterator>
+    usize serialize_elements(Archive& archive, Iterator first, size_t length) const {
+        ThreadPool& workers = get_pool();
+        const size_t chunk_length = std::max(min_chunk_length, (length + chunks_per_thread * workers.size() - 1) / (chunks_per_thread * workers.size()));
+        if (workers.size() < 2 || length <= chunk_length || workers.is_worker()) {
+            usize size = 0;
+            for (size_t i = 0; i < length; ++i, ++first) {
+                size += archive.serialize(*first);
+            }
+            return size;
+        }
+
+        using ChunkArchive = BinaryArchive<storage::Buffer, storage_policy::NotOwningPointer,
+                typename Archive::encoding_type, typename Archive::byte_order_type>;
+        const size_t chunks = (length + chunk_length - 1) / chunk_length;
+        // bounds memory held by finished chunks that wait for their turn to be written
+        const size_t window = 2 * workers.size();
+
+        std::deque<std::future<storage::Buffer>> in_flight;
+        std::vector<storage::Buffer> spare;
+        size_t submitted = 0;
+        usize size = 0;
+        try {
+            while (submitted < chunks || !in_flight.empty()) {
+                while (submitted < chunks && in_flight.size() < window) {
+                    const size_t count = std::min(chunk_length, length - submitted * chunk_length);
+                    storage::Buffer buffer;
+                    if (!spare.empty()) {
+                        buffer = std::move(spare.back());
+                        spare.pop_back();
+                    }
+                    in_flight.push_back(workers.submit([first, count, buffer = std::move(buffer)] () mutable {
+                        ChunkArchive chunk(&buffer);
+                        Iterator it = first;
+                        for (size_t i = 0; i < count; ++i, ++it) {
+                            chunk.serialize(*it);
+                        }
+                        return std::move(buffer);
+                    }));
+                    std::advance(first, count);
+                    ++submitted;
+                }
+                storage::Buffer buffer = in_flight.front().get();
+                in_flight.pop_front();
+                size += archive.get_storage().write(buffer.data(), buffer.size());
+                if constexpr (traits::references_writes_v<std::remove_reference_t<decltype(archive.get_storage())>>) {
+                    // the buffer is reused or freed next
+                    archive.get_storage().flush();
+                }
+                buffer.clear();
+                spare.push_back(std::move(buffer));
+            }
+        } catch (...) {
+            // workers reference the container, let them finish before unwinding
+            for (auto& chunk: in_flight) {
+                chunk.wait();
+            }
+            throw;
+        }
+        return size;
+    }
+
+    /// Appends all elements of `view` to `container`, decoding chunks concurrently.
+    /// Random access containers with `resize` are filled in place, others get chunks inserted in order
+    template<typename View, typename Container>
+    void deserialize_chunks(const View& view, Container& container) const {
+        ThreadPool& workers = get_pool();
+        const size_t chunks = view.chunk_count();
+        if (workers.size() < 2 || chunks < 2 || workers.is_worker()) {
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                view.read_chunk(chunk, container);
+            }
+            return;
+        }
+
+        using Iterator = decltype(std::begin(container));
+        if constexpr (traits::has_resize_v<Container> && std::is_default_constructible_v<typename View::value_type>
+                && std::is_base_of_v<std::random_access_iterator_tag, typename std::iterator_traits<Iterator>::iterator_category>) {
+            const size_t first = std::size(container);
+            container.resize(first + view.size());
+            run_chunks(workers, chunks, [&view, &container, first] (size_t chunk) {
+                auto archive = view.chunk_archive(chunk);
+                auto out = std::begin(container) + static_cast<std::ptrdiff_t>(first + chunk * view.stride());
+                for (size_t i = view.chunk_length(chunk); i > 0; --i, ++out) {
+                    archive.deserialize(*out);
+                }
+            });
+        } else {
+            std::vector<std::vector<typename View::value_type>> decoded(chunks);
+            run_chunks(workers, chunks, [&view, &decoded] (size_t chunk) {
+                view.read_chunk(chunk, decoded[chunk]);
+            });
+            details::reserve_silent(container, std::size(container) + view.size());
+            for (auto& elements: decoded) {
+                for (auto& e: elements) {
+                    details::emplace(container, std::move(e));
+                }
+            }
+        }
+    }
+
+private:
+    /// Calls `task(chunk)` for every chunk on the pool, grouping chunks into a few tasks per worker.
+    /// Waits for all of them and rethrows the first exception
+    template<typename Task>
+    void run_chunks(ThreadPool& workers, size_t chunks, const Task& task) const {
+        const size_t groups = std::min(chunks, chunks_per_thread * workers.size());
+        std::vector<std::future<void>> done;
+        done.reserve(groups);
+        std::exception_ptr error;
+        try {
+            for (size_t group = 0; group < groups; ++group) {
+                const size_t begin = chunks * group / groups;
+                const size_t end = chunks * (group + 1) / groups;
+                done.push_back(workers.submit([&task, begin, end] {
+                    for (size_t chunk = begin; chunk < end; ++chunk) {
+                        task(chunk);
+                    }
+                }));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto& group: done) {
+            try {
+                group.get();
+            } catch (...) {
+                if (!error) {
+                    error = std::current_exception();
+                }
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    ThreadPool* pool = nullptr;
+    size_t min_chunk_length = default_min_chunk_length;
+};
+
+/// Default parallel execution policy, see `ParallelPolicy`
+inline constexpr ParallelPolicy parallel {};
+
+template<>
+struct traits::is_execution_policy<ParallelPolicy> : std::true_type {};
+
+} // namespace archive
@@ -0,0 +1,419 @@
+#pragma once
+#include "archive.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#define ARCHIVE_ASSERT(x)
+
+/// Framed record log on top of `BinaryArchive`:
+///    archive::record_log::Writer<storage::GatherWriter> log("events.log");
+///    log.append(EventType, event);                       // one record, any serializable objects
+///    archive::record_log::Reader<> reader(mapping.data(), mapping.size());
+///    for (const auto& record: reader) { if (record.type() == EventType) handle(record.get<Event>()); }
+///
+/// The log is a sequence of `block_size` blocks. Each record is stored as one or more fragments,
+/// a fragment never crosses a block boundary:
+///    [length: u32][type: u16][kind: u8][check: u8][length bytes of the record]
+/// Header fields are little-endian, `kind` tells if the fragment is a whole record or its first,
+/// middle or last part, `check` guards the header against garbage. A block tail too short for a header
+/// is zero-filled. Because every block starts with a fragment header, readers can resync at the next
+/// block after corrupted data and a log can be split at block boundaries to be scanned by several threads
+namespace archive::record_log {
+
+inline constexpr size_t default_block_size = size_t(32) << 10;
+inline constexpr size_t header_size = 8;
+
+/// Fragment kinds
+enum class Kind : unsigned char {
+    Full = 1,
+    First = 2,
+    Middle = 3,
+    Last = 4,
+};
+
+namespace details {
+
+inline unsigned char header_check(const unsigned char* header) {
+    unsigned char check = 0xa5;
+    for (size_t i = 0; i < header_size - 1; ++i) {
+        check ^= header[i];
+    }
+    return check;
+}
+
+inline void encode_header(unsigned char* header, std::uint32_t length, std::uint16_t type, Kind kind) {
+    header[0] = static_cast<unsigned char>(length);
+    header[1] = static_cast<unsigned char>(length >> 8);
+    header[2] = static_cast<unsigned char>(length >> 16);
+    header[3] = static_cast<unsigned char>(length >> 24);
+    header[4] = static_cast<unsigned char>(type);
+    header[5] = static_cast<unsigned char>(type >> 8);
+    header[6] = static_cast<unsigned char>(kind);
+    header[7] = header_check(header);
+}
+
+struct Header {
+    std::uint32_t length;
+    std::uint16_t type;
+    Kind kind;
+};
+
+/// Returns false for headers that were not written by `encode_header`
+inline bool decode_header(const unsigned char* header, Header& result) {
+    if (header[7] != header_check(header) || header[6] < 1 || header[6] > 4) {
+        return false;
+    }
+    result.length = std::uint32_t(header[0]) | std::uint32_t(header[1]) << 8
+            | std::uint32_t(header[2]) << 16 | std::uint32_t(header[3]) << 24;
+    result.type = static_cast<std::uint16_t>(header[4] | header[5] << 8);
+    result.kind = static_cast<Kind>(header[6]);
+    return true;
+}
+
+} // namespace details
+
+
+/// Appends records to `Storage`. Data is batched into blocks and handed to the storage a block at a time,
+/// `flush()` writes a partially filled block, the next records continue it. Storages that keep references
+/// to written memory, such as `GatherWriter`, are flushed after each write
+template<
+        typename Storage,
+        template<typename S>class StoragePolicy = storage_policy::Inline,
+        typename Encoding = encoding::Fixed,
+        typename ByteOrder = byte_order::Native
+>
+class Writer : public StoragePolicy<Storage> {
+public:
+    using StoragePolicy<Storage>::get_storage;
+
+    template<typename... Args>
+    Writer(Args&&... args)
+        : StoragePolicy<Storage> (std::forward<Args>(args)...)
+    {
+        set_block_size(default_block_size);
+    }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    ~Writer() {
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
+    /// Must be called before anything is appended. Readers have to use the same block size
+    void set_block_size(size_t size) {
+        ARCHIVE_ASSERT(position == 0);
+        block_size = std::max(size, header_size + 1);
+        block.assign(block_size, 0);
+    }
+    size_t get_block_size() const { return block_size; }
+
+    /// Appends a record of `type` holding `objects` serialized one after another.
+    /// Objects with `stream_serialization` are supported as in `ArchiveStream`
+    template<typename... Objects>
+    void append(std::uint16_t type, const Objects&... objects) {
+        scratch.clear();
+        stream::Writer<BinaryArchive<storage::Buffer, storage_policy::NotOwningPointer, Encoding, ByteOrder>> writer(&scratch);
+        (writer << ... << objects);
+        append_raw(type, scratch.data(), scratch.size());
+    }
+
+    /// Appends a record of `type` with `size` bytes at `data`
+    void append_raw(std::uint16_t type, const void* data, size_t size) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        bool first = true;
+        do {
+            size_t left = block_size - used;
+            if (left < header_size) {
+                std::memset(block.data() + used, 0, left);
+                used = block_size;
+                write_block();
+                left = block_size;
+            }
+            const size_t fragment = std::min(size, left - header_size);
+            const bool last = fragment == size;
+            const Kind kind = first ? (last ? Kind::Full : Kind::First) : (last ? Kind::Last : Kind::Middle);
+            details::encode_header(block.data() + used, static_cast<std::uint32_t>(fragment), type, kind);
+            if (fragment > 0) {
+                std::memcpy(block.data() + used + header_size, bytes, fragment);
+            }
+            used += header_size + fragment;
+            if (used == block_size) {
+                write_block();
+            }
+            bytes += fragment;
+            size -= fragment;
+            first = false;
+        } while (size > 0);
+        ++records;
+    }
+
+    /// Writes buffered bytes to the storage and flushes the storage if it can be flushed
+    void flush() {
+        if (used > written) {
+            write_storage(block.data() + written, used - written);
+            position += used - written;
+            written = used;
+        }
+        if constexpr (traits::has_flush_v<Storage>) {
+            get_storage().flush();
+        }
+    }
+
+    /// Number of records appended
+    size_t size() const { return records; }
+    /// Number of bytes in the log, including buffered ones
+    usize bytes() const { return position + (used - written); }
+
+private:
+    void write_block() {
+        write_storage(block.data() + written, block_size - written);
+        position += block_size - written;
+        used = 0;
+        written = 0;
+    }
+
+    /// The block is refilled after a write, storages that keep references to it are flushed first
+    void write_storage(const unsigned char* data, size_t size) {
+        get_storage().write(data, size);
+        if constexpr (traits::references_writes_v<Storage>) {
+            get_storage().flush();
+        }
+    }
+
+    size_t block_size = default_block_size;
+    std::vector<unsigned char> block;
+    /// Bytes of the current block filled and already handed to the storage
+    size_t used = 0;
+    size_t written = 0;
+    usize position = 0;
+    size_t records = 0;
+    storage::Buffer scratch;
+};
+
+
+/// Record yielded by `Reader`. Its bytes are valid until the iterator that produced it is advanced
+template<typename Encoding = encoding::Fixed, typename ByteOrder = byte_order::Native>
+class Record {
+public:
+    using Archive = BinaryArchive<storage::MemoryReader, storage_policy::Inline, Encoding, ByteOrder>;
+
+    std::uint16_t type() const { return record_type; }
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+    /// Offset of the first fragment of the record in the log
+    size_t offset() const { return record_offset; }
+
+    /// Archive reading the record bytes
+    Archive archive() const { return Archive(bytes, length); }
+
+    template<typename T>
+    T get() const {
+        T value {};
+        read(value);
+        return value;
+    }
+
+    /// Reads objects in the order they were appended, objects with `stream_serialization` are supported
+    template<typename... Objects>
+    void read(Objects&... objects) const {
+        stream::Reader<Archive> reader(bytes, length);
+        (reader >> ... >> objects);
+    }
+
+private:
+    template<typename, typename>
+    friend class Reader;
+
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+    size_t record_offset = 0;
+    std::uint16_t record_type = 0;
+};
+
+
+/// Reads records from a log in memory, e.g. from `storage::MmapReader`.
+/// A reader over a range of the log yields records whose first fragment is in the range,
+/// so readers over adjacent ranges (see `split`) yield every record exactly once
+template<typename Encoding = encoding::Fixed, typename ByteOrder = byte_order::Native>
+class Reader {
+public:
+    using value_type = Record<Encoding, ByteOrder>;
+
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Record<Encoding, ByteOrder>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const value_type*;
+        using reference = const value_type&;
+
+        iterator() = default;
+        iterator(const iterator& other) { *this = other; }
+        iterator(iterator&&) = default;
+        iterator& operator=(iterator&&) = default;
+
+        iterator& operator=(const iterator& other) {
+            reader = other.reader;
+            position = other.position;
+            record = other.record;
+            scratch = other.scratch;
+            // a record assembled from fragments points into the scratch buffer of its iterator
+            if (!other.scratch.empty() && other.record.bytes == other.scratch.data()) {
+                record.bytes = scratch.data();
+            }
+            return *this;
+        }
+
+        reference operator*() const { return record; }
+        pointer operator->() const { return &record; }
+        iterator& operator++() { next(); return *this; }
+        iterator operator++(int) { iterator copy = *this; next(); return copy; }
+        bool operator==(const iterator& other) const { return position == other.position; }
+        bool operator!=(const iterator& other) const { return position != other.position; }
+
+    private:
+        friend class Reader;
+
+        iterator(const Reader* reader_, size_t position_)
+            : reader(reader_)
+            , position(position_)
+        {
+            next();
+        }
+
+        /// Finds the next complete record, `position` becomes `npos` at the end
+        void next() {
+            const unsigned char* log = reader->log;
+            const size_t block_size = reader->block_size;
+            bool in_record = false;
+            scratch.clear();
+            while (position < reader->log_size) {
+                const size_t left = block_size - position % block_size;
+                if (left < header_size) {
+                    position += left;
+                    continue;
+                }
+                if (!in_record && position >= reader->range_end) {
+                    break;
+                }
+                details::Header header;
+                if (position + header_size > reader->log_size
+                        || !details::decode_header(log + position, header)
+                        || header.length > left - header_size
+                        || position + header_size + header.length > reader->log_size) {
+                    // resync at the next block, a partially read record is lost. Copies of an iterator
+                    // and repeated iterations pass the same blocks, each one is counted once
+                    if (position >= reader->scanned) {
+                        reader->skipped += left;
+                        reader->scanned = position + left;
+                    }
+                    position += left;
+                    in_record = false;
+                    scratch.clear();
+                    continue;
+                }
+                const unsigned char* fragment = log + position + header_size;
+                const size_t fragment_position = position;
+                position += header_size + header.length;
+                switch (header.kind) {
+                case Kind::Full:
+                    record.bytes = fragment;
+                    record.length = header.length;
+                    record.record_type = header.type;
+                    record.record_offset = fragment_position;
+                    return;
+                case Kind::First:
+                    in_record = true;
+                    scratch.assign(fragment, fragment + header.length);
+                    record.record_type = header.type;
+                    record.record_offset = fragment_position;
+                    break;
+                case Kind::Middle:
+                case Kind::Last:
+                    // continuation of a record that started before the range or was corrupted
+                    if (!in_record) {
+                        break;
+                    }
+                    scratch.insert(scratch.end(), fragment, fragment + header.length);
+                    if (header.kind == Kind::Last) {
+                        record.bytes = scratch.data();
+                        record.length = scratch.size();
+                        return;
+                    }
+                    break;
+                }
+            }
+            position = npos;
+        }
+
+        static constexpr size_t npos = ~size_t(0);
+
+        const Reader* reader = nullptr;
+        size_t position = npos;
+        value_type record;
+        /// Bytes of a record split into several fragments
+        std::vector<unsigned char> scratch;
+    };
+    using const_iterator = iterator;
+
+    Reader(const void* data, size_t size, size_t block_size_ = default_block_size)
+        : Reader(data, size, 0, size, block_size_)
+    {}
+
+    /// Reads records that start in [begin, end), `begin` is rounded up to a block boundary
+    Reader(const void* data, size_t size, size_t begin_, size_t end_, size_t block_size_ = default_block_size)
+        : log(static_cast<const unsigned char*>(data))
+        , log_size(size)
+        , block_size(std::max(block_size_, header_size + 1))
+        , range_begin(std::min(size, (begin_ + block_size - 1) / block_size * block_size))
+        , range_end(std::min(size, end_))
+    {}
+
+    /// Starts a new iteration, `skipped_bytes()` is counted again
+    iterator begin() const {
+        skipped = 0;
+        scanned = 0;
+        return iterator(this, range_begin);
+    }
+    iterator end() const { return iterator(); }
+
+    /// Bytes skipped because of corrupted fragments since the last `begin()`
+    size_t skipped_bytes() const { return skipped; }
+
+    /// Splits a log of `size` bytes into at most `parts` block-aligned ranges [begin, end)
+    static std::vector<std::pair<size_t, size_t>> split(size_t size, size_t parts, size_t block_size = default_block_size) {
+        std::vector<std::pair<size_t, size_t>> ranges;
+        const size_t blocks = (size + block_size - 1) / block_size;
+        parts = std::max<size_t>(std::min(parts, blocks), 1);
+        for (size_t part = 0; part < parts; ++part) {
+            const size_t begin = std::min(size, blocks * part / parts * block_size);
+            const size_t end = std::min(size, blocks * (part + 1) / parts * block_size);
+            ranges.emplace_back(begin, end);
+        }
+        return ranges;
+    }
+
+private:
+    const unsigned char* log;
+    size_t log_size;
+    size_t block_size;
+    size_t range_begin;
+    size_t range_end;
+    mutable size_t skipped = 0;
+    /// End of the last block counted in `skipped`
+    mutable size_t scanned = 0;
+};
+
+} // namespace archive::record_log
+
+#undef ARCHIVE_ASSERT
@@ -1,9 +1,22 @@
 #include "archive.h"
+#include "archive_parallel.h"
+#include "archive_incremental.h"
+#include "archive_record_log.h"
+#include "archive_concurrent.h"
+#include "archive_async.h"
+#include "archive_compress.h"
+#include "archive_checksum.h"
+#if __has_include(<sys/mman.h>)
+#include "archive_mmap.h"
+#include "archive_file.h"
+#define HAS_MMAP 1
+#endif
 
 #include <iostream>
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 #include <utility>
 #include <algorithm>
 #include <type_traits>
@@ -12,6 +25,17 @@
 #include <tuple>
 #include <array>
 #include <optional>
+#include <list>
+#include <deque>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <cstdio>
+#include <filesystem>
+#include <thread>
+#include <stdexcept>
+#include <random>
+#include <unordered_map>
 
 enum Enum {E1, E2};
 enum class Enumc {E1, E2};
@@ -51,6 +75,62 @@ struct DummyStorage {
     }
 };
 
+/// DummyStorage that also counts storage calls and can skip bytes
+template<size_t buffer_size>
+struct CallCountingStorage : DummyStorage<buffer_size> {
+    size_t writes = 0;
+    size_t reads = 0;
+    size_t advances = 0;
+
+    void advance(size_t size) {
+        ++advances;
+        this->read_pos += size;
+    }
+
+    size_t write(const unsigned char* data, size_t size) {
+        ++writes;
+        return DummyStorage<buffer_size>::write(data, size);
+    }
+
+    void read(unsigned char* data, size_t size) {
+        ++reads;
+        DummyStorage<buffer_size>::read(data, size);
+    }
+};
+
+struct Vec3 {
+    float x, y, z;
+    bool operator == (const Vec3& other) const { return x == other.x && y == other.y && z == other.z; }
+};
+
+template<typename Archive>
+archive::usize serialize_object(const Vec3& v, Archive& a) {
+    return a.serialize(v.x) + a.serialize(v.y) + a.serialize(v.z);
+}
+
+template<typename Archive>
+void deserialize_object(Vec3& v, Archive& a) {
+    a.deserialize(v.x);
+    a.deserialize(v.y);
+    a.deserialize(v.z);
+}
+
+template<>
+struct archive::traits::is_trivially_serializable<Vec3> : std::true_type {};
+
+struct Rgb {
+    std::uint8_t r, g, b;
+    bool operator == (const Rgb& other) const { return r == other.r && g == other.g && b == other.b; }
+};
+
+template<typename Stream>
+void stream_serialization(Stream& stream, archive::ArgumentRef<Rgb, Stream::get_policy()>& t) {
+    stream & t.r & t.g & t.b;
+}
+
+template<>
+struct archive::traits::is_trivially_serializable<Rgb> : std::true_type {};
+
 struct TestObject {
     int i {};
     double d {};
@@ -208,6 +288,2198 @@ void test_directional() {
 
 
 
+void test_contiguous() {
+    archive::BinaryArchive<CallCountingStorage<4096>> archive;
+
+    std::vector<float> vec(100);
+    for (size_t i = 0; i < vec.size(); ++i) {
+        vec[i] = static_cast<float>(i) * 0.5f;
+    }
+    const std::string str = "contiguous string payload";
+    const std::array<int, 4> sarr {{4, 3, 2, 1}};
+    const int arr[3] = {7, 8, 9};
+
+    archive.serialize(vec);
+    archive.serialize(str);
+    archive.serialize(sarr);
+    archive.serialize(arr);
+    assert(archive.writes == 2 + 2 + 1 + 2); // length prefix + one payload call each
+
+    std::vector<float> vec1 {1.f, 2.f};
+    std::string str1;
+    std::array<int, 4> sarr1 {};
+    int arr1[3] = {};
+
+    archive.deserialize(vec1);
+    archive.deserialize(str1);
+    archive.deserialize(sarr1);
+    archive.deserialize(arr1);
+    assert(archive.reads == 2 + 2 + 1 + 2);
+
+    assert(vec == vec1);
+    assert(str == str1);
+    assert(sarr == sarr1);
+    assert(std::equal(std::begin(arr), std::end(arr), std::begin(arr1)));
+}
+
+void test_serialized_size() {
+    const TestObject test = makeTestObject();
+    const std::vector<std::string> strings {"a", "bb", "", "dddd"};
+    const std::map<int, std::vector<std::string>> nested {{1, strings}, {2, {}}};
+
+    static_assert(archive::traits::static_size<std::tuple<int, double, std::array<short, 3>>>::value
+                  == sizeof(int) + sizeof(double) + 3 * sizeof(short));
+    static_assert(!archive::traits::has_static_size_v<std::pair<int, std::string>>);
+
+    archive::BinaryArchive<archive::storage::Buffer> archive;
+    const archive::usize strings_size = archive.serialize(strings);
+    assert(strings_size == archive.get_storage().size());
+    assert(archive::serialized_size(strings) == strings_size);
+
+    archive.get_storage().clear();
+    const archive::usize nested_size = archive.serialize(nested);
+    assert(nested_size == archive.get_storage().size());
+    assert(archive::serialized_size(nested) == nested_size);
+
+    archive::storage::Buffer buffer = archive::serialize_to_buffer(test.str, test.map, strings, nested);
+    assert(buffer.size() == buffer.capacity());
+    assert(buffer.size() == archive::serialized_size(test.str) + archive::serialized_size(test.map)
+                            + strings_size + nested_size);
+
+    archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::NotOwningPointer> reader(&buffer);
+    std::string str;
+    std::map<int, std::string> map;
+    std::vector<std::string> strings1;
+    std::map<int, std::vector<std::string>> nested1;
+    reader.deserialize(str);
+    reader.deserialize(map);
+    reader.deserialize(strings1);
+    reader.deserialize(nested1);
+    assert(str == test.str);
+    assert(map == test.map);
+    assert(strings1 == strings);
+    assert(nested1 == nested);
+}
+
+template<typename Encoding>
+archive::usize test_encoding() {
+    using ArchiveType = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::NotOwningPointer, Encoding>;
+    archive::storage::Buffer buffer;
+
+    const TestObject test = makeTestObject();
+    std::vector<std::int64_t> ints(10000);
+    for (size_t i = 0; i < ints.size(); ++i) {
+        // mix of single and multi-byte varints, negative values and extremes
+        const std::int64_t v = static_cast<std::int64_t>(i % 7 == 0 ? i * i * 1000 : i % 60);
+        ints[i] = (i % 3 == 0) ? -v : v;
+    }
+    ints[17] = INT64_MIN;
+    ints[18] = INT64_MAX;
+    const std::list<std::uint32_t> list {1, 300, 70000, 0xffffffffu};
+    const std::deque<short> deque {-1, 2, -300, 4, 5, 6, 7, 8, 9};
+    const std::array<std::uint16_t, 5> sarr {{1, 2, 65535, 4, 5}};
+    const std::tuple<int, std::string, std::vector<unsigned>> tup {-5, "tuple", {1, 2, 3}};
+
+    archive::stream::Writer<ArchiveType> writer(&buffer);
+    writer & test & ints & list & deque & sarr & tup;
+
+    // TestObject only has stream_serialization, measure it with a stream over a counting storage
+    archive::stream::Writer<archive::BinaryArchive<archive::storage::Counter, archive::storage_policy::Inline, Encoding>> counter;
+    counter & test;
+
+    const archive::usize expected = counter.getArchive().get_storage().size + ArchiveType::serialized_size(ints)
+            + ArchiveType::serialized_size(list) + ArchiveType::serialized_size(deque)
+            + ArchiveType::serialized_size(sarr) + ArchiveType::serialized_size(tup);
+    assert(expected == buffer.size());
+
+    archive::stream::Reader<ArchiveType> reader(&buffer);
+    TestObject result;
+    std::vector<std::int64_t> ints1 {42};
+    std::list<std::uint32_t> list1;
+    std::deque<short> deque1;
+    std::array<std::uint16_t, 5> sarr1 {};
+    std::tuple<int, std::string, std::vector<unsigned>> tup1;
+    reader & result & ints1 & list1 & deque1 & sarr1 & tup1;
+
+    assert_equal(test, result);
+    assert(ints == ints1);
+    assert(list == list1);
+    assert(deque == deque1);
+    assert(sarr == sarr1);
+    assert(tup == tup1);
+    return buffer.size();
+}
+
+void test_encodings() {
+    const archive::usize fixed = test_encoding<archive::encoding::Fixed>();
+    const archive::usize lengths = test_encoding<archive::encoding::VarintLengths>();
+    const archive::usize varint = test_encoding<archive::encoding::Varint>();
+    assert(varint < lengths && lengths < fixed);
+
+    // single-byte varints decode on the fast path, multi-byte ones take the slow path
+    std::vector<std::uint64_t> small(1000, 5), large(1000, 1ull << 40);
+    const archive::usize small_size = archive::BinaryArchive<archive::storage::Counter, archive::storage_policy::Inline, archive::encoding::Varint>::serialized_size(small);
+    assert(small_size == 2 + 2 + 1000);
+    const archive::usize large_size = archive::BinaryArchive<archive::storage::Counter, archive::storage_policy::Inline, archive::encoding::Varint>::serialized_size(large);
+    assert(large_size == 2 + 2 + 6000);
+
+    // a run ending in a cut varint (malformed input) is decoded without reading past its bytes
+    std::vector<unsigned char> cut {20, 30};
+    cut.resize(cut.size() + 30, 0xff);
+    archive::BinaryArchive<archive::storage::MemoryReader, archive::storage_policy::Parent, archive::encoding::Varint> malformed(cut.data(), cut.size());
+    std::vector<std::uint64_t> values;
+    malformed.deserialize(values);
+    assert(values.size() <= 20 && malformed.get_storage().read_position() == cut.size());
+}
+
+template<typename T>
+void assert_big_endian(const unsigned char* bytes, T value) {
+    std::uint64_t expected = 0;
+    memcpy(&expected, &value, sizeof(T)); // only works for the little-endian hosts this test runs on
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        assert(bytes[i] == static_cast<unsigned char>(expected >> (8 * (sizeof(T) - 1 - i))));
+    }
+}
+
+void test_byte_order() {
+    using BigArchive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Inline,
+                                              archive::encoding::Fixed, archive::byte_order::Big>;
+    using LittleArchive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Inline,
+                                                 archive::encoding::Fixed, archive::byte_order::Little>;
+    BigArchive big;
+
+    // odd sizes exercise AVX2, SSSE3 and scalar tails
+    std::vector<std::uint16_t> u16(1003);
+    std::vector<std::int32_t> i32(517);
+    std::vector<double> f64(10001);
+    for (size_t i = 0; i < f64.size(); ++i) {
+        if (i < u16.size()) u16[i] = static_cast<std::uint16_t>(i * 263);
+        if (i < i32.size()) i32[i] = static_cast<std::int32_t>(i * 16777259) - 5;
+        f64[i] = static_cast<double>(i) / 3.0;
+    }
+    const std::uint32_t u = 0x01020304;
+    const Enumc ec = Enumc::E2;
+    const std::array<std::int64_t, 3> sarr {{-1, 1ll << 40, 3}};
+
+    big.serialize(u);
+    big.serialize(ec);
+    big.serialize(u16);
+    big.serialize(i32);
+    big.serialize(f64);
+    big.serialize(sarr);
+
+    if (archive::details::host_is_little_endian) {
+        const unsigned char* bytes = big.get_storage().data();
+        assert(bytes[0] == 1 && bytes[1] == 2 && bytes[2] == 3 && bytes[3] == 4);
+        bytes += sizeof(u);
+        assert_big_endian(bytes, ec);
+        bytes += sizeof(ec);
+        assert_big_endian(bytes, archive::usize(u16.size()));
+        bytes += sizeof(archive::usize);
+        for (size_t i = 0; i < u16.size(); ++i, bytes += 2) {
+            assert_big_endian(bytes, u16[i]);
+        }
+        assert_big_endian(bytes, archive::usize(i32.size()));
+        bytes += sizeof(archive::usize);
+        for (size_t i = 0; i < i32.size(); ++i, bytes += 4) {
+            assert_big_endian(bytes, i32[i]);
+        }
+        bytes += sizeof(archive::usize);
+        for (size_t i = 0; i < f64.size(); ++i, bytes += 8) {
+            assert_big_endian(bytes, f64[i]);
+        }
+        for (size_t i = 0; i < sarr.size(); ++i, bytes += 8) {
+            assert_big_endian(bytes, sarr[i]);
+        }
+    }
+
+    std::uint32_t u1 = 0;
+    Enumc ec1 = Enumc::E1;
+    std::vector<std::uint16_t> u16_1;
+    std::vector<std::int32_t> i32_1;
+    std::vector<double> f64_1;
+    std::array<std::int64_t, 3> sarr1 {};
+    big.deserialize(u1);
+    big.deserialize(ec1);
+    big.deserialize(u16_1);
+    big.deserialize(i32_1);
+    big.deserialize(f64_1);
+    big.deserialize(sarr1);
+    assert(u == u1 && ec == ec1 && u16 == u16_1 && i32 == i32_1 && f64 == f64_1 && sarr == sarr1);
+
+    // little archive on little-endian host is byte-identical to the native one
+    LittleArchive little;
+    archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Inline> native;
+    little.serialize(f64);
+    native.serialize(f64);
+    assert(little.get_storage().get_bytes() == native.get_storage().get_bytes() || !archive::details::host_is_little_endian);
+}
+
+void test_views() {
+    const std::string str = "zero-copy string";
+    const std::vector<int> ints {1, -2, 3, -4, 5};
+    const std::vector<std::uint8_t> blob {0xde, 0xad, 0xbe, 0xef};
+    const std::vector<std::string> strings {"a", "bb", "ccc"};
+    const std::optional<std::string> opt = "optional";
+
+    const archive::storage::Buffer buffer = archive::serialize_to_buffer(str, ints, blob, strings, opt, ints);
+
+    archive::BinaryArchive<archive::storage::MemoryReader> reader(buffer.data(), buffer.size());
+    std::string_view str1;
+    archive::View<int> ints1;
+    archive::View<std::uint8_t> blob1;
+    std::vector<std::string_view> strings1;
+    std::optional<std::string_view> opt1;
+    reader.deserialize(str1);
+    reader.deserialize(ints1);
+    reader.deserialize(blob1);
+    reader.deserialize(strings1);
+    reader.deserialize(opt1);
+
+    assert(str1 == str);
+    assert(str1.data() >= reinterpret_cast<const char*>(buffer.data())
+           && str1.data() < reinterpret_cast<const char*>(buffer.data() + buffer.size()));
+    assert(std::equal(ints.begin(), ints.end(), ints1.begin(), ints1.end()));
+    assert(ints1[1] == -2 && ints1.back() == 5);
+    const auto first = ints1.begin();
+    assert(2 + first == first + 2 && *(2 + first) == ints[2]);
+    assert(ints1.end() > first && first <= first && ints1.end() >= first + 1 && !(first >= ints1.end()));
+    assert(std::equal(blob.begin(), blob.end(), blob1.begin(), blob1.end()));
+    assert(std::equal(strings.begin(), strings.end(), strings1.begin(), strings1.end()));
+    assert(opt1 && *opt1 == *opt);
+
+#if __cplusplus >= 202002L && __has_include(<span>)
+    std::span<const int> span;
+    reader.deserialize(span);
+    assert(std::equal(ints.begin(), ints.end(), span.begin(), span.end()));
+#else
+    archive::View<int> last;
+    reader.deserialize(last);
+    assert(last.size() == ints.size());
+#endif
+
+    // views serialize exactly like the containers they point into
+    archive::BinaryArchive<archive::storage::Buffer> writer;
+    writer.serialize(str1);
+    writer.serialize(ints1);
+    std::string str2;
+    std::vector<int> ints2;
+    writer.deserialize(str2);
+    writer.deserialize(ints2);
+    assert(str2 == str && ints2 == ints);
+}
+
+struct Checkpoint {
+    std::vector<double> a;
+    std::vector<double> b;
+    std::string name;
+    std::vector<std::uint32_t> c;
+};
+
+template<typename Stream>
+void stream_serialization(Stream& stream, archive::ArgumentRef<Checkpoint, Stream::get_policy()>& t) {
+    stream & t.a & t.name & t.b & t.c;
+}
+
+#if defined(HAS_MMAP)
+template<template<typename S> class Policy>
+void test_mmap_read(const std::string& path, const TestObject& test, const std::vector<double>& large) {
+    using Reader = archive::storage::MmapReader;
+    using ArchiveType = archive::BinaryArchive<Reader, Policy>;
+    TestObject result;
+    archive::View<double> large1;
+    std::string_view str;
+    if constexpr (std::is_same_v<Policy<Reader>, archive::storage_policy::NotOwningPointer<Reader>>) {
+        Reader reader(path, Reader::Access::Random);
+        archive::stream::Reader<ArchiveType> stream(&reader);
+        stream & result & large1 & str;
+        // views are valid only while the mapping is alive
+        assert(std::equal(large.begin(), large.end(), large1.begin(), large1.end()));
+        assert(str == "tail");
+    } else {
+        archive::stream::Reader<ArchiveType> stream(path);
+        stream & result & large1 & str;
+        assert(std::equal(large.begin(), large.end(), large1.begin(), large1.end()));
+        assert(str == "tail");
+    }
+    assert_equal(test, result);
+}
+
+void test_mmap() {
+    const std::string path = (std::filesystem::temp_directory_path() / "archive_test_mmap.bin").string();
+    const TestObject test = makeTestObject();
+    std::vector<double> large(100000);
+    for (size_t i = 0; i < large.size(); ++i) {
+        large[i] = static_cast<double>(i) * 1.5;
+    }
+
+    archive::usize written = 0;
+    {
+        // small grow step forces several remaps
+        archive::stream::Writer<archive::BinaryArchive<archive::storage::MmapWriter>> writer(path, 4096);
+        const std::string_view tail = "tail";
+        writer & test & large & tail;
+        written = writer.getArchive().size();
+        writer.getArchive().close();
+    }
+    assert(std::filesystem::file_size(path) == written);
+
+    test_mmap_read<archive::storage_policy::Parent>(path, test, large);
+    test_mmap_read<archive::storage_policy::Inline>(path, test, large);
+    test_mmap_read<archive::storage_policy::NotOwningPointer>(path, test, large);
+    std::remove(path.c_str());
+}
+
+template<typename ByteOrder>
+void test_gather_writer_with() {
+    const std::string path = (std::filesystem::temp_directory_path() / "archive_test_gather.bin").string();
+    Checkpoint test;
+    test.a.assign(50000, 1.25);
+    test.b.resize(3000);
+    for (size_t i = 0; i < test.b.size(); ++i) {
+        test.b[i] = static_cast<double>(i);
+    }
+    test.name = "checkpoint";
+    test.c.assign(10, 7);
+
+    using Writer = archive::BinaryArchive<archive::storage::GatherWriter, archive::storage_policy::Parent,
+                                          archive::encoding::Fixed, ByteOrder>;
+    using Reader = archive::BinaryArchive<archive::storage::MmapReader, archive::storage_policy::Parent,
+                                          archive::encoding::Fixed, ByteOrder>;
+    {
+        // tiny staging buffer forces flushes between referenced blobs
+        archive::stream::Writer<Writer> writer(path, 64, 0);
+        for (int i = 0; i < 3; ++i) {
+            writer & test;
+        }
+        writer.getArchive().close();
+        assert(writer.getArchive().size() == 3 * Writer::serialized_size(test.a) + 3 * Writer::serialized_size(test.b)
+                                             + 3 * Writer::serialized_size(test.name) + 3 * Writer::serialized_size(test.c));
+    }
+
+    archive::stream::Reader<Reader> reader(path);
+    for (int i = 0; i < 3; ++i) {
+        Checkpoint result;
+        reader & result;
+        assert(result.a == test.a && result.b == test.b && result.name == test.name && result.c == test.c);
+    }
+    std::remove(path.c_str());
+}
+
+void test_gather_writer() {
+    test_gather_writer_with<archive::byte_order::Native>();
+    test_gather_writer_with<archive::byte_order::Big>();
+
+    // parallel serialization hands chunk buffers to the writer and reuses them
+    const std::string path = (std::filesystem::temp_directory_path() / "archive_test_gather_parallel.bin").string();
+    std::vector<std::string> strings(200000);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        strings[i] = std::to_string(i * 7919);
+    }
+    archive::ThreadPool pool(4);
+    {
+        archive::BinaryArchive<archive::storage::GatherWriter> writer(path);
+        writer.serialize(strings, archive::parallel.on(pool));
+        writer.close();
+    }
+    archive::BinaryArchive<archive::storage::MmapReader> reader(path);
+    std::vector<std::string> strings1;
+    reader.deserialize(strings1);
+    assert(strings1 == strings);
+    std::remove(path.c_str());
+}
+#endif
+
+void test_trivially_serializable() {
+    static_assert(archive::traits::is_trivially_serializable_v<std::pair<int, float>>);
+    static_assert(archive::traits::is_trivially_serializable_v<std::array<std::pair<short, short>, 3>>);
+    static_assert(!archive::traits::is_trivially_serializable_v<std::pair<char, int>>); // padding
+    static_assert(!archive::traits::is_trivially_serializable_v<std::pair<int, std::string>>);
+    static_assert(archive::traits::static_size<Vec3>::value == 3 * sizeof(float));
+
+    std::vector<Vec3> points(1000);
+    std::vector<std::pair<int, float>> pairs(500);
+    std::vector<std::tuple<int, float>> tuples(500);
+    for (size_t i = 0; i < points.size(); ++i) {
+        points[i] = {float(i), float(i) * 2, float(i) * 3};
+        if (i < pairs.size()) {
+            pairs[i] = {int(i), float(i) / 2};
+            tuples[i] = {int(i), float(i) / 4};
+        }
+    }
+    const std::array<std::pair<short, short>, 3> sarr {{{1, 2}, {3, 4}, {5, 6}}};
+
+    archive::BinaryArchive<CallCountingStorage<1 << 16>> archive;
+    archive.serialize(points);
+    assert(archive.writes == 2); // length and one block
+    archive.serialize(pairs);
+    assert(archive.writes == 4); // not trivially copyable, fields gathered into one chunk
+    archive.serialize(tuples);
+    archive.serialize(sarr);
+    assert(archive.writes == 7);
+
+    // the wire format equals field by field encoding
+    archive::BinaryArchive<DummyStorage<1 << 16>> fieldwise;
+    fieldwise.serialize(archive::usize(points.size()));
+    for (const Vec3& p: points) {
+        fieldwise.serialize(p.x);
+        fieldwise.serialize(p.y);
+        fieldwise.serialize(p.z);
+    }
+    fieldwise.serialize(archive::usize(pairs.size()));
+    for (const auto& p: pairs) {
+        fieldwise.serialize(p.first);
+        fieldwise.serialize(p.second);
+    }
+    fieldwise.serialize(archive::usize(tuples.size()));
+    for (const auto& t: tuples) {
+        fieldwise.serialize(std::get<0>(t));
+        fieldwise.serialize(std::get<1>(t));
+    }
+    for (const auto& p: sarr) {
+        fieldwise.serialize(p.first);
+        fieldwise.serialize(p.second);
+    }
+    assert(fieldwise.write_pos == archive.write_pos);
+    assert(memcmp(fieldwise.buffer, archive.buffer, archive.write_pos) == 0);
+
+    std::vector<Vec3> points1;
+    std::vector<std::pair<int, float>> pairs1;
+    std::vector<std::tuple<int, float>> tuples1;
+    std::array<std::pair<short, short>, 3> sarr1 {};
+    archive.deserialize(points1);
+    assert(archive.reads == 2);
+    archive.deserialize(pairs1);
+    archive.deserialize(tuples1);
+    archive.deserialize(sarr1);
+    assert(archive.reads == 7);
+    assert(points == points1 && pairs == pairs1 && tuples == tuples1 && sarr == sarr1);
+
+    // several chunks, non-contiguous container
+    const std::list<std::pair<int, float>> many(1200, {7, 0.5f});
+    archive::BinaryArchive<CallCountingStorage<1 << 16>> chunked;
+    chunked.serialize(many);
+    assert(chunked.writes == 1 + 3);
+    std::list<std::pair<int, float>> many1;
+    chunked.deserialize(many1);
+    assert(many == many1);
+
+    // opted-in type with only stream_serialization
+    const std::vector<Rgb> pixels {{1, 2, 3}, {4, 5, 6}};
+    archive::BinaryArchive<archive::storage::Buffer> buffer;
+    buffer.serialize(pixels);
+    assert(buffer.get_storage().size() == sizeof(archive::usize) + 6);
+    std::vector<Rgb> pixels1;
+    buffer.deserialize(pixels1);
+    assert(pixels == pixels1);
+}
+
+void test_memory_resource() {
+    const std::string long_string(100, 'x'); // longer than any small string buffer
+    const std::vector<std::string> strings {long_string, long_string + "1", long_string + "2"};
+    const std::map<int, std::vector<std::string>> map {{1, strings}, {2, {long_string}}};
+    const std::optional<std::string> opt = long_string;
+    const std::vector<std::optional<std::string>> optionals {opt, std::nullopt, opt};
+
+    archive::BinaryArchive<archive::storage::Buffer> archive;
+    archive.serialize(strings);
+    archive.serialize(map);
+    archive.serialize(opt);
+    archive.serialize(optionals);
+    archive.serialize(strings);
+
+    std::pmr::monotonic_buffer_resource arena;
+    archive.set_memory_resource(&arena);
+
+    // nothing is allowed to use the default resource while decoding
+    std::pmr::memory_resource* previous = std::pmr::set_default_resource(std::pmr::null_memory_resource());
+
+    std::pmr::vector<std::pmr::string> strings1(&arena);
+    std::pmr::map<int, std::pmr::vector<std::pmr::string>> map1(&arena);
+    std::optional<std::pmr::string> opt1;
+    std::pmr::vector<std::optional<std::pmr::string>> optionals1(&arena);
+    archive.deserialize(strings1);
+    archive.deserialize(map1);
+    archive.deserialize(opt1);
+    archive.deserialize(optionals1);
+    const auto strings2 = archive.deserialize<std::pmr::vector<std::pmr::string>>();
+
+    std::pmr::set_default_resource(previous);
+
+    const auto same = [] (const auto& a, const auto& b) { return std::string_view(a) == std::string_view(b); };
+    assert(std::equal(strings.begin(), strings.end(), strings1.begin(), strings1.end(), same));
+    assert(strings1[0].get_allocator().resource() == &arena);
+    assert(map1.size() == 2 && map1[1].size() == 3 && same(map1[1][2], strings[2]));
+    assert(map1[1][0].get_allocator().resource() == &arena);
+    assert(opt1 && same(*opt1, long_string) && opt1->get_allocator().resource() == &arena);
+    assert(optionals1.size() == 3 && !optionals1[1] && same(*optionals1[2], long_string));
+    assert(std::equal(strings.begin(), strings.end(), strings2.begin(), strings2.end(), same));
+    assert(strings2.get_allocator().resource() == &arena);
+}
+
+/// Has no default constructor, decoded by the `from_archive_t` hook
+struct Sensor {
+    int id;
+    std::string name;
+
+    Sensor(int id_, std::string name_) : id(id_), name(std::move(name_)) {}
+
+    template<typename Archive>
+    Sensor(archive::from_archive_t, Archive& a)
+        : id(a.template deserialize<int>())
+        , name(a.template deserialize<std::string>())
+    {}
+
+    bool operator == (const Sensor& other) const { return id == other.id && name == other.name; }
+};
+
+template<typename Archive>
+archive::usize serialize_object(const Sensor& s, Archive& a) {
+    return a.serialize(s.id) + a.serialize(s.name);
+}
+
+/// Counts copies and moves to check that elements are decoded where they are stored
+struct Tracked {
+    static inline int relocations = 0;
+
+    std::string value;
+
+    Tracked() = default;
+    explicit Tracked(std::string value_) : value(std::move(value_)) {}
+    Tracked(const Tracked& other) : value(other.value) { ++relocations; }
+    Tracked(Tracked&& other) noexcept : value(std::move(other.value)) { ++relocations; }
+    Tracked& operator = (const Tracked&) = default;
+    Tracked& operator = (Tracked&&) = default;
+
+    bool operator == (const Tracked& other) const { return value == other.value; }
+};
+
+template<typename Archive>
+archive::usize serialize_object(const Tracked& t, Archive& a) {
+    return a.serialize(t.value);
+}
+
+template<typename Archive>
+void deserialize_object(Tracked& t, Archive& a) {
+    a.deserialize(t.value);
+}
+
+void test_in_place() {
+    static_assert(!std::is_default_constructible_v<Sensor>);
+    std::vector<Sensor> sensors;
+    std::map<int, Sensor> by_id;
+    for (int i = 0; i < 100; ++i) {
+        sensors.emplace_back(i, "sensor " + std::to_string(i));
+        by_id.emplace(i * 3, sensors.back());
+    }
+    const std::optional<Sensor> optional = sensors[7];
+    std::vector<Tracked> tracked;
+    std::map<std::string, Tracked> tracked_map;
+    std::set<int> ordered;
+    std::unordered_map<int, std::string> unordered;
+    for (int i = 0; i < 1000; ++i) {
+        tracked.emplace_back(std::to_string(i));
+        tracked_map.emplace(std::to_string(i), Tracked(std::to_string(i * 2)));
+        ordered.insert(i * 7);
+        unordered.emplace(i, std::to_string(i));
+    }
+
+    archive::BinaryArchive<archive::storage::Buffer> archive;
+    archive.serialize(sensors);
+    archive.serialize(by_id);
+    archive.serialize(optional);
+    archive.serialize(sensors[3]);
+    archive.serialize(std::list<Sensor>(sensors.begin(), sensors.end()));
+    archive.serialize(archive::Indexed(sensors, 16));
+    archive.serialize(tracked);
+    archive.serialize(tracked_map);
+    archive.serialize(ordered);
+    archive.serialize(unordered);
+    archive.serialize(sensors[5]);
+
+    std::vector<Sensor> sensors1;
+    std::map<int, Sensor> by_id1;
+    std::optional<Sensor> optional1;
+    std::list<Sensor> list1;
+    archive.deserialize(sensors1);
+    archive.deserialize(by_id1);
+    archive.deserialize(optional1);
+    assert(sensors1 == sensors && by_id1 == by_id && optional1 == optional);
+    assert(archive.deserialize<Sensor>() == sensors[3]);
+    archive.deserialize(list1);
+    assert(std::equal(list1.begin(), list1.end(), sensors.begin(), sensors.end()));
+
+    archive::IndexedView<Sensor> view;
+    archive.deserialize(view);
+    assert(view.size() == sensors.size() && view[42] == sensors[42]);
+
+    Tracked::relocations = 0;
+    std::vector<Tracked> tracked1;
+    std::map<std::string, Tracked> tracked_map1;
+    archive.deserialize(tracked1);
+    archive.deserialize(tracked_map1);
+    // vectors are reserved and filled in place, map values are decoded inside their nodes
+    assert(Tracked::relocations == 0);
+    assert(tracked1 == tracked && tracked_map1 == tracked_map);
+
+    std::set<int> ordered1;
+    std::unordered_map<int, std::string> unordered1;
+    archive.deserialize(ordered1);
+    archive.deserialize(unordered1);
+    assert(ordered1 == ordered && unordered1 == unordered);
+    archive.skip<Sensor>();
+    assert(archive.get_storage().read_position() == archive.get_storage().size());
+}
+
+template<typename Encoding, typename ByteOrder, typename Container>
+void assert_parallel_matches(const Container& container, const archive::ParallelPolicy& policy) {
+    using Archive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding, ByteOrder>;
+    Archive sequential;
+    const archive::usize size = sequential.serialize(container);
+    Archive parallel;
+    assert(parallel.serialize(container, policy) == size);
+    assert(parallel.get_bytes() == sequential.get_bytes());
+
+    Container result;
+    parallel.deserialize(result);
+    assert(result == container);
+}
+
+void test_parallel() {
+    archive::ThreadPool pool(3);
+    const auto policy = archive::parallel.on(pool).with_chunk_length(7);
+
+    std::vector<std::pair<TestPack, std::string>> records;
+    for (int i = 0; i < 1000; ++i) {
+        records.push_back({{i * 1000}, std::string(size_t(i % 37), 'r')});
+    }
+    const std::list<std::vector<int>> lists(100, {1, -200, 300000});
+    const std::map<int, std::string> map {{1, "one"}, {2, "two"}, {3, "three"}};
+
+    assert_parallel_matches<archive::encoding::Fixed, archive::byte_order::Native>(records, policy);
+    assert_parallel_matches<archive::encoding::Varint, archive::byte_order::Big>(records, policy);
+    assert_parallel_matches<archive::encoding::VarintLengths, archive::byte_order::Little>(lists, policy);
+    // shorter than a chunk and contiguous primitives are written sequentially
+    assert_parallel_matches<archive::encoding::Fixed, archive::byte_order::Native>(map, policy);
+    assert_parallel_matches<archive::encoding::Fixed, archive::byte_order::Big>(std::vector<double>(100, 0.5), policy);
+    assert_parallel_matches<archive::encoding::Fixed, archive::byte_order::Native>(records, archive::parallel);
+
+    // nested parallel serialization from a worker runs sequentially instead of waiting for itself
+    auto nested = pool.submit([&] {
+        archive::BinaryArchive<archive::storage::Buffer> archive;
+        archive.serialize(records, policy);
+        return archive.get_bytes().size();
+    });
+    assert(nested.get() == archive::serialized_size(records));
+}
+
+template<typename Encoding, typename ByteOrder, typename Container>
+void assert_indexed(const Container& container, archive::ThreadPool& pool) {
+    using Archive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding, ByteOrder>;
+    using Element = archive::traits::remove_const_element_type_t<Container>;
+    Archive archive;
+    const archive::usize size = archive.serialize(archive::Indexed(container, 16));
+    assert(size == archive.size() && size == Archive::serialized_size(archive::Indexed(container, 16)));
+    archive.serialize(std::string("tail"));
+
+    Container sequential;
+    archive.deserialize(archive::Indexed(sequential));
+    assert(sequential == container && archive.template deserialize<std::string>() == "tail");
+
+    archive.rewind();
+    Container parallel;
+    archive.deserialize(archive::Indexed(parallel), archive::parallel.on(pool));
+    assert(parallel == container && archive.template deserialize<std::string>() == "tail");
+
+    archive.rewind();
+    archive::IndexedView<Element, Encoding, ByteOrder> view;
+    archive.deserialize(view);
+    assert(archive.template deserialize<std::string>() == "tail");
+    assert(view.size() == container.size() && view.stride() == 16 && view.chunk_count() == (container.size() + 15) / 16);
+    auto it = container.begin();
+    for (size_t i = 0; i < view.size(); ++i, ++it) {
+        assert(view[i] == Element(*it));
+    }
+    if (!view.empty()) {
+        std::vector<Element> last;
+        view.read_chunk(view.chunk_count() - 1, last);
+        assert(last.size() == view.chunk_length(view.chunk_count() - 1) && last.back() == Element(*container.rbegin()));
+    }
+}
+
+void test_indexed() {
+    archive::ThreadPool pool(3);
+
+    std::vector<std::pair<TestPack, std::string>> records;
+    for (int i = 0; i < 1000; ++i) {
+        records.push_back({{i}, std::string(size_t(i % 23), 'i')});
+    }
+    std::map<int, std::string> map;
+    for (int i = 0; i < 100; ++i) {
+        map[i * 3] = std::to_string(i);
+    }
+    std::vector<std::pair<int, double>> pairs; // static size, offsets are computed without a counting pass
+    for (int i = 0; i < 100; ++i) {
+        pairs.push_back({i, i * 0.5});
+    }
+    std::vector<int> ints(100);
+    for (int i = 0; i < 100; ++i) {
+        ints[size_t(i)] = i * (i % 2 ? -1000 : 1000);
+    }
+
+    assert_indexed<archive::encoding::Fixed, archive::byte_order::Native>(records, pool);
+    assert_indexed<archive::encoding::Varint, archive::byte_order::Big>(records, pool);
+    assert_indexed<archive::encoding::Fixed, archive::byte_order::Native>(map, pool);
+    assert_indexed<archive::encoding::Fixed, archive::byte_order::Big>(pairs, pool);
+    assert_indexed<archive::encoding::Varint, archive::byte_order::Native>(ints, pool);
+    assert_indexed<archive::encoding::Fixed, archive::byte_order::Native>(std::vector<Vec3>(40, Vec3{1, 2, 3}), pool);
+    assert_indexed<archive::encoding::Fixed, archive::byte_order::Native>(std::vector<std::string>(), pool);
+
+    // storages without `advance` skip the offset table by reading it
+    auto dummy = std::make_unique<archive::BinaryArchive<DummyStorage<1 << 16>>>();
+    dummy->serialize(archive::Indexed(records, 100));
+    std::vector<std::pair<TestPack, std::string>> records1;
+    dummy->deserialize(archive::Indexed(records1), archive::parallel.on(pool));
+    assert(records1 == records);
+}
+
+struct Envelope {
+    int id = 0;
+    archive::Lazy<TestObject> body;   // TestObject only has stream_serialization
+};
+
+template<typename Stream>
+void stream_serialization(Stream& stream, archive::ArgumentRef<Envelope, Stream::get_policy()>& t) {
+    stream & t.id & t.body;
+}
+
+void test_lazy() {
+    const std::vector<std::string> attachments {"a", std::string(100, 'b'), "c"};
+    const std::map<int, std::string> history {{1, "one"}, {2, "two"}};
+    using Attachments = archive::Lazy<std::vector<std::string>>;
+
+    archive::BinaryArchive<archive::storage::Buffer> archive;
+    const Attachments lazy = attachments;
+    const archive::usize size = archive.serialize(lazy);
+    assert(size == archive.size() && size == sizeof(archive::usize) + archive::serialized_size(attachments));
+    archive.serialize(archive::Lazy(history));
+    archive.serialize(42);
+
+    Attachments attachments1;
+    archive::Lazy<std::map<int, std::string>> history1;
+    archive.deserialize(attachments1);
+    archive.deserialize(history1);
+    assert(!attachments1.is_loaded() && attachments1.encoded_size() == archive::serialized_size(attachments));
+    assert(archive.deserialize<int>() == 42);
+
+    // untouched values are copied as is
+    archive::BinaryArchive<archive::storage::Buffer> copy;
+    copy.serialize(attachments1);
+    copy.serialize(history1);
+    copy.serialize(42);
+    assert(copy.get_bytes() == archive.get_bytes() && !attachments1.is_loaded());
+
+    assert(*attachments1 == attachments && attachments1.is_loaded() && attachments1.encoded_size() == 0);
+    assert(history1->size() == 2 && history1.get() == history);
+
+    // loaded values are encoded again, possibly changed
+    attachments1->push_back("d");
+    archive::BinaryArchive<archive::storage::Buffer> changed;
+    changed.serialize(attachments1);
+    Attachments attachments2;
+    changed.deserialize(attachments2);
+    assert(attachments2->size() == 4 && attachments2->back() == "d");
+
+    // values read with another encoding are decoded and encoded again
+    archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, archive::encoding::Varint> varint;
+    archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, archive::encoding::Varint> expected;
+    archive.rewind();
+    Attachments attachments3;
+    archive.deserialize(attachments3);
+    varint.serialize(attachments3);
+    expected.serialize(Attachments(attachments));
+    assert(varint.get_bytes() == expected.get_bytes());
+
+    // storages without memory access keep a copy of the bytes, streams use the same overloads
+    auto stream = std::make_unique<archive::ArchiveStream<archive::BinaryArchive<DummyStorage<1024>>, archive::Direction::Bidirectional>>();
+    Attachments attachments4;
+    *stream << lazy >> attachments4;
+    assert(!attachments4.is_loaded() && attachments4.get() == attachments);
+
+    // values with only stream_serialization are encoded and decoded through streams
+    archive::ArchiveStream<archive::BinaryArchive<archive::storage::Buffer>, archive::Direction::Bidirectional> envelopes;
+    Envelope envelope {7, makeTestObject()};
+    envelopes << envelope;
+    Envelope envelope1;
+    envelopes >> envelope1;
+    assert(envelope1.id == 7 && !envelope1.body.is_loaded());
+    assert(envelope1.body.encoded_size() + 4 + sizeof(archive::usize) == envelopes.getArchive().get_bytes().size());
+    assert_equal(*envelope1.body, makeTestObject());
+}
+
+template<typename Encoding, typename Storage>
+void test_skip_with(const std::vector<unsigned char>& bytes) {
+    auto archive = std::make_unique<archive::BinaryArchive<Storage, archive::storage_policy::Parent, Encoding>>();
+    archive->get_storage().write(bytes.data(), bytes.size());
+    int sentinel = 0;
+    const auto next = [&] { archive->deserialize(sentinel); assert(sentinel == 0x5eed); };
+
+    archive->template skip<int>(); next();
+    archive->template skip<const double>(); next();
+    archive->template skip<Enumc>(); next();
+    archive->template skip<std::string>(); next();
+    archive->template skip<std::vector<int>>(); next();
+    archive->template skip<std::vector<std::string>>(); next();
+    archive->template skip<std::list<short>>(); next();
+    archive->template skip<std::map<int, std::string>>(); next();
+    archive->template skip<int[3]>(); next();
+    archive->template skip<std::array<std::int64_t, 3>>(); next();
+    archive->template skip<std::array<std::string, 2>>(); next();
+    archive->template skip<std::tuple<int, std::string, std::vector<double>>>(); next();
+    archive->template skip<std::pair<int, double>>(); next();
+    archive->template skip<std::optional<std::string>>(); next();
+    archive->template skip<std::optional<std::string>>(); next();
+    archive->template skip<std::vector<std::optional<int>>>(); next();
+    archive->template skip<archive::Lazy<std::vector<std::string>>>(); next();
+    archive->template skip<archive::Indexed<std::vector<std::string>>>(); next();
+    archive->template skip<archive::Packed<std::vector<int>>>(); next();
+    archive->template skip<archive::Delta<std::list<std::uint64_t>>>(); next();
+    archive->template skip<archive::Columnar<std::vector<std::pair<int, std::string>>>>(); next();
+    archive->template skip<TestPack>(); next();
+    archive->template skip<std::vector<Vec3>>(); next();
+    archive->template skip<std::vector<std::map<std::string, std::vector<int>>>>(); next();
+}
+
+template<typename Encoding>
+void test_skip_encoding() {
+    const int sentinel = 0x5eed;
+    const int array[3] = {1, -2, 3};
+    std::vector<std::string> strings {"a", "bb", std::string(300, 'c')};
+    std::vector<int> packed(300, -5);
+    packed[7] = 1 << 20;
+    const std::list<std::uint64_t> steps {1, 5, 200, 200, 3};
+    const std::vector<std::pair<int, std::string>> columns {{1, "one"}, {-2, "two"}};
+    archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding> archive;
+    archive.serialize(-7); archive.serialize(sentinel);
+    archive.serialize(0.5); archive.serialize(sentinel);
+    archive.serialize(Enumc::E2); archive.serialize(sentinel);
+    archive.serialize(std::string("string")); archive.serialize(sentinel);
+    archive.serialize(std::vector<int>{1, -200, 30000}); archive.serialize(sentinel);
+    archive.serialize(strings); archive.serialize(sentinel);
+    archive.serialize(std::list<short>{1, 2}); archive.serialize(sentinel);
+    archive.serialize(std::map<int, std::string>{{1, "one"}, {-2, "two"}}); archive.serialize(sentinel);
+    archive.serialize(array); archive.serialize(sentinel);
+    archive.serialize(std::array<std::int64_t, 3>{{1, -1, 1 << 20}}); archive.serialize(sentinel);
+    archive.serialize(std::array<std::string, 2>{{"x", "yy"}}); archive.serialize(sentinel);
+    archive.serialize(std::tuple<int, std::string, std::vector<double>>{1, "t", {0.5}}); archive.serialize(sentinel);
+    archive.serialize(std::pair<int, double>{1, 0.5}); archive.serialize(sentinel);
+    archive.serialize(std::optional<std::string>("opt")); archive.serialize(sentinel);
+    archive.serialize(std::optional<std::string>()); archive.serialize(sentinel);
+    archive.serialize(std::vector<std::optional<int>>{1, std::nullopt, -300}); archive.serialize(sentinel);
+    archive.serialize(archive::Lazy(strings)); archive.serialize(sentinel);
+    archive.serialize(archive::Indexed(strings, 2)); archive.serialize(sentinel);
+    archive.serialize(archive::Packed(packed)); archive.serialize(sentinel);
+    archive.serialize(archive::Delta(steps)); archive.serialize(sentinel);
+    archive.serialize(archive::Columnar(columns)); archive.serialize(sentinel);
+    archive.serialize(TestPack{5}); archive.serialize(sentinel);
+    archive.serialize(std::vector<Vec3>{{1, 2, 3}, {4, 5, 6}}); archive.serialize(sentinel);
+    archive.serialize(std::vector<std::map<std::string, std::vector<int>>>{{{"k", {1, 2}}}, {}}); archive.serialize(sentinel);
+
+    test_skip_with<Encoding, archive::storage::Buffer>(archive.get_bytes());
+    test_skip_with<Encoding, DummyStorage<4096>>(archive.get_bytes());
+}
+
+void test_skip() {
+    test_skip_encoding<archive::encoding::Fixed>();
+    test_skip_encoding<archive::encoding::VarintLengths>();
+    test_skip_encoding<archive::encoding::Varint>();
+
+    // fixed-size values and containers of primitives are skipped without reading
+    archive::BinaryArchive<CallCountingStorage<1024>> archive;
+    archive.serialize(std::vector<double>(10, 0.5));
+    archive.serialize(std::make_pair(1, 2.0));
+    archive.serialize(std::vector<std::vector<int>>{{1, 2}, {3}});
+    archive.serialize(0x5eed);
+    archive.reads = 0;
+    archive.skip<std::vector<double>>();
+    archive.skip<std::pair<int, double>>();
+    assert(archive.reads == 1 && archive.advances == 2);
+    archive.skip<std::vector<std::vector<int>>>();
+    assert(archive.reads == 4 && archive.advances == 4);
+    assert(archive.deserialize<int>() == 0x5eed);
+
+    // streams decode types with stream_serialization
+    archive::ArchiveStream<archive::BinaryArchive<archive::storage::Buffer>, archive::Direction::Bidirectional> stream;
+    Rgb pixel {1, 2, 3};
+    TestObject object;
+    int value = 42;
+    stream << pixel << object << value;
+    value = 0;
+    stream.skip<Rgb>().skip<TestObject>() >> value;
+    assert(value == 42);
+}
+
+using IncrementalValue = std::tuple<
+        int, std::string, std::vector<double>, std::map<int, std::string>, std::optional<TestPack>,
+        std::list<std::vector<int>>, std::vector<Vec3>, std::array<std::int64_t, 3>, std::set<short>,
+        std::pair<std::optional<std::string>, Enumc>>;
+
+template<typename Encoding, typename ByteOrder>
+void test_incremental_with(const IncrementalValue& value, size_t fragment) {
+    archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding, ByteOrder> archive;
+    archive.serialize(value);
+    archive.serialize(value);
+    const std::vector<unsigned char>& bytes = archive.get_bytes();
+
+    archive::IncrementalDecoder<IncrementalValue, Encoding, ByteOrder> decoder;
+    size_t position = 0;
+    for (int message = 0; message < 2; ++message) {
+        archive::DecodeStatus status = archive::DecodeStatus::NeedMoreData;
+        while (status == archive::DecodeStatus::NeedMoreData) {
+            assert(position < bytes.size());
+            const size_t size = std::min(fragment, bytes.size() - position);
+            status = decoder.feed(bytes.data() + position, size);
+            assert(decoder.consumed() == size || status == archive::DecodeStatus::Done);
+            position += decoder.consumed();
+        }
+        assert(decoder.take() == value);
+    }
+    assert(position == bytes.size());
+}
+
+void test_incremental() {
+    IncrementalValue value {
+        -5, "string", {0.5, 1.5, 2.5}, {{1, "one"}, {2, "two"}}, TestPack{7},
+        {{1, 2}, {}, {300000}}, {{1, 2, 3}, {4, 5, 6}}, {{1, -1, 1 << 20}}, {-3, 4},
+        {std::string("opt"), Enumc::E2}
+    };
+    for (size_t fragment: {size_t(1), size_t(3), size_t(7), size_t(1) << 20}) {
+        test_incremental_with<archive::encoding::Fixed, archive::byte_order::Native>(value, fragment);
+        test_incremental_with<archive::encoding::Varint, archive::byte_order::Big>(value, fragment);
+        test_incremental_with<archive::encoding::VarintLengths, archive::byte_order::Little>(value, fragment);
+    }
+
+    // large vectors are filled while bytes arrive
+    const std::vector<double> large(100000, 0.25);
+    const archive::storage::Buffer buffer = archive::serialize_to_buffer(large, archive::Lazy(large));
+    archive::IncrementalDecoder<std::vector<double>> decoder;
+    assert(decoder.feed(buffer.data(), buffer.size() / 4) == archive::DecodeStatus::NeedMoreData);
+    assert(decoder.value().size() == large.size() && decoder.value()[1000] == 0.25);
+    const size_t quarter = buffer.size() / 4;
+    assert(decoder.feed(buffer.data() + quarter, buffer.size() - quarter) == archive::DecodeStatus::Done);
+    assert(decoder.value() == large && decoder.consumed() < buffer.size() - quarter);
+
+    // opaque values are collected and decoded once complete
+    const size_t offset = quarter + decoder.consumed();
+    archive::IncrementalDecoder<archive::Lazy<std::vector<double>>> lazy;
+    assert(lazy.feed(buffer.data() + offset, 100) == archive::DecodeStatus::NeedMoreData);
+    assert(lazy.feed(buffer.data() + offset + 100, buffer.size() - offset - 100) == archive::DecodeStatus::Done);
+    assert(lazy.consumed() == buffer.size() - offset - 100 && *lazy.value() == large);
+
+    // types without a default constructor are created by their `from_archive_t` constructor
+    const Sensor sensor(3, "thermometer");
+    const std::vector<Sensor> sensors {Sensor(1, "a"), Sensor(2, "bb")};
+    const archive::storage::Buffer sensor_bytes = archive::serialize_to_buffer(sensor, sensors, std::optional(sensor));
+    archive::IncrementalDecoder<Sensor> single;
+    archive::IncrementalDecoder<std::vector<Sensor>> vector;
+    archive::IncrementalDecoder<std::optional<Sensor>> optional;
+    size_t position = 0;
+    const auto feed_bytes = [&] (auto& incremental) {
+        archive::DecodeStatus status = archive::DecodeStatus::NeedMoreData;
+        while (status == archive::DecodeStatus::NeedMoreData) {
+            status = incremental.feed(sensor_bytes.data() + position, std::min<size_t>(2, sensor_bytes.size() - position));
+            position += incremental.consumed();
+        }
+    };
+    feed_bytes(single);
+    feed_bytes(vector);
+    feed_bytes(optional);
+    assert(position == sensor_bytes.size());
+    assert(single.value() == sensor && vector.value() == sensors && optional.value() == sensor);
+}
+
+void test_record_log() {
+    using Reader = archive::record_log::Reader<>;
+    constexpr size_t block_size = 64;
+
+    archive::record_log::Writer<archive::storage::Buffer> log;
+    log.set_block_size(block_size);
+    std::vector<std::string> strings;
+    for (size_t i = 0; i < 100; ++i) {
+        // some records span several blocks
+        strings.push_back(std::string(i * 7 % 150, char('a' + i % 26)));
+        log.append(std::uint16_t(i % 3), strings.back(), int(i));
+    }
+    const TestObject object = makeTestObject();
+    log.append(7, object);
+    log.append_raw(8, "raw", 3);
+    log.flush();
+    assert(log.size() == 102 && log.bytes() == log.get_storage().size());
+    const archive::storage::Buffer& bytes = log.get_storage();
+
+    const auto check = [&] (const Reader::value_type& record, size_t i) {
+        if (i < strings.size()) {
+            std::string string;
+            int index = 0;
+            record.read(string, index);
+            assert(record.type() == i % 3 && string == strings[i] && index == int(i));
+        } else if (i == strings.size()) {
+            assert(record.type() == 7);
+            assert_equal(record.get<TestObject>(), object);
+        } else {
+            assert(record.type() == 8 && record.size() == 3 && memcmp(record.data(), "raw", 3) == 0);
+        }
+    };
+
+    Reader reader(bytes.data(), bytes.size(), block_size);
+    size_t count = 0;
+    for (const auto& record: reader) {
+        check(record, count++);
+    }
+    assert(count == 102 && reader.skipped_bytes() == 0);
+
+    // copies of iterators own their record bytes
+    auto it = reader.begin();
+    std::advance(it, 40);
+    const auto copy = it;
+    ++it;
+    check(*copy, 40);
+
+    // ranges split at block boundaries yield every record once
+    count = 0;
+    for (const auto& range: Reader::split(bytes.size(), 5, block_size)) {
+        for (const auto& record: Reader(bytes.data(), bytes.size(), range.first, range.second, block_size)) {
+            check(record, count++);
+        }
+    }
+    assert(count == 102);
+
+    // corrupted block is skipped, reading resumes with the next record that starts in a later block
+    std::vector<unsigned char> corrupted(bytes.data(), bytes.data() + bytes.size());
+    corrupted[block_size * 10 + 2] ^= 0xff;
+    Reader damaged(corrupted.data(), corrupted.size(), block_size);
+    count = 0;
+    for (const auto& record: damaged) {
+        assert(record.offset() < block_size * 10 || record.offset() >= block_size * 11);
+        ++count;
+    }
+    assert(count < 102 && count > 90 && damaged.skipped_bytes() == block_size);
+    // copies of iterators and repeated iterations don't count skipped blocks again
+    for (auto i = damaged.begin(), j = i; i != damaged.end(); ++i) {
+        j = i;
+        ++j;
+    }
+    assert(damaged.skipped_bytes() == block_size);
+
+#if defined(HAS_MMAP)
+    // the block buffer is reused only after writers that reference it are flushed
+    const std::string path = (std::filesystem::temp_directory_path() / "archive_test_record_log.bin").string();
+    {
+        archive::record_log::Writer<archive::storage::GatherWriter> file(path);
+        for (size_t i = 0; i < strings.size(); ++i) {
+            file.append(std::uint16_t(i % 3), strings[i], int(i), std::string(1000 * i, 'x'));
+        }
+    }
+    archive::storage::MmapReader mapping(path);
+    count = 0;
+    for (const auto& record: Reader(mapping.data(), mapping.size())) {
+        std::string string;
+        int index = 0;
+        std::string padding;
+        record.read(string, index, padding);
+        assert(string == strings[count] && index == int(count) && padding.size() == 1000 * count);
+        ++count;
+    }
+    assert(count == strings.size());
+    mapping.close();
+    std::remove(path.c_str());
+#endif
+}
+
+/// Measures fine but fails when written into a real storage
+struct FailingWrite {
+    int value = 0;
+};
+
+template<typename Archive>
+archive::usize serialize_object(const FailingWrite& t, Archive& a) {
+    if constexpr (!std::is_same_v<std::decay_t<decltype(a.get_storage())>, archive::storage::Counter>) {
+        throw std::runtime_error("write failed");
+    }
+    return a.serialize(t.value);
+}
+
+template<typename Archive>
+void deserialize_object(FailingWrite& t, Archive& a) {
+    a.deserialize(t.value);
+}
+
+void test_concurrent_log() {
+    // a small ring makes records wrap around its end and producers wait for the consumer
+    archive::ConcurrentLog<archive::encoding::Varint> log(1000);
+    assert(log.get_capacity() == 1000);
+
+    constexpr int producers = 4;
+    constexpr int records = 2000;
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producers; ++p) {
+        threads.emplace_back([&log, p] {
+            for (int i = 0; i < records; ++i) {
+                log.write(p, i, std::string(size_t(i % 53), char('a' + p)));
+            }
+        });
+    }
+
+    // a monitoring thread never sees the consumer ahead of the producers
+    std::atomic<bool> done {false};
+    std::thread monitor([&log, &done] {
+        while (!done.load()) {
+            assert(log.pending_bytes() < archive::usize(1) << 20);
+        }
+    });
+
+    std::vector<int> next(producers, 0);
+    int count = 0;
+    while (count < producers * records) {
+        count += int(log.poll([&] (const auto& record) {
+            int p = -1, i = -1;
+            std::string string;
+            record.read(p, i, string);
+            // records of one producer arrive in order
+            assert(p >= 0 && p < producers && i == next[size_t(p)]++);
+            assert(string == std::string(size_t(i % 53), char('a' + p)));
+        }));
+    }
+    for (auto& thread: threads) {
+        thread.join();
+    }
+    done = true;
+    monitor.join();
+    assert(log.poll([] (const auto&) {}) == 0 && log.pending_bytes() == 0);
+
+    // a failed write keeps its slot but is never delivered
+    log.write(TestPack{1});
+    bool thrown = false;
+    try {
+        log.write(FailingWrite{});
+    } catch (const std::runtime_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+    log.write(makeTestObject());
+    std::vector<unsigned char> first;
+    assert(log.poll([&] (const auto& record) { first.assign(record.data(), record.data() + record.size()); }, 1) == 1);
+    assert(first.size() == 1 && first[0] == 2);   // zigzag varint of 1
+    TestObject object;
+    assert(log.poll([&] (const auto& record) { object = record.template get<TestObject>(); }) == 1);
+    assert_equal(object, makeTestObject());
+
+    thrown = false;
+    try {
+        log.write(std::string(1000, 'x'));
+    } catch (const std::system_error&) {
+        thrown = true;
+    }
+    assert(thrown && log.pending_bytes() == 0);
+}
+
+/// Sink failing once it got `limit` bytes
+struct FailingSink {
+    size_t limit = 0;
+    size_t size = 0;
+    bool closed = false;
+
+    size_t write(const unsigned char*, size_t size_) {
+        if (size + size_ > limit) {
+            throw std::system_error(std::make_error_code(std::errc::no_space_on_device), "sink is full");
+        }
+        size += size_;
+        return size_;
+    }
+    void close() { closed = true; }
+};
+
+void test_async_writer() {
+    Checkpoint test;
+    test.a.assign(5000, 1.25);
+    test.b.assign(300, 2.5);
+    test.name = "async";
+    test.c.assign(77, 7);
+
+    using Sink = archive::storage::Buffer;
+    using Writer = archive::BinaryArchive<archive::storage::AsyncWriter<Sink>, archive::storage_policy::Inline>;
+    for (size_t buffers: {2, 3}) {
+        // buffers much smaller than the objects keep all of them in flight
+        archive::stream::Writer<Writer> writer(Sink(), 100, buffers);
+        archive::stream::Writer<archive::BinaryArchive<Sink>> expected;
+        for (int i = 0; i < 20; ++i) {
+            writer & test;
+            expected & test;
+        }
+        auto& storage = writer.getArchive().get_storage();
+        storage.flush();
+        const Sink& sink = storage.get_sink();
+        assert(storage.size() == sink.size() && sink.size() == expected.getArchive().get_storage().size());
+        assert(memcmp(sink.data(), expected.getArchive().get_storage().data(), sink.size()) == 0);
+
+        // flush keeps the writer usable
+        writer & test;
+        storage.close();
+        assert(!storage.is_open() && storage.size() == sink.size());
+        archive::stream::Reader<archive::BinaryArchive<archive::storage::MemoryReader, archive::storage_policy::Inline>> reader(sink.data(), sink.size());
+        for (int i = 0; i < 21; ++i) {
+            Checkpoint result;
+            reader & result;
+            assert(result.a == test.a && result.b == test.b && result.name == test.name && result.c == test.c);
+        }
+    }
+
+    // sink errors surface in write, flush and close; the sink is closed only after a clean close
+    archive::storage::AsyncWriter<FailingSink> failing(FailingSink{1000}, 64, 2);
+    archive::BinaryArchive<archive::storage::AsyncWriter<FailingSink>, archive::storage_policy::NotOwningPointer> archive(&failing);
+    size_t errors = 0;
+    try {
+        for (int i = 0; i < 100; ++i) {
+            archive.serialize(test.b);
+        }
+    } catch (const std::system_error& e) {
+        assert(e.code() == std::errc::no_space_on_device);
+        ++errors;
+    }
+    try {
+        failing.flush();
+    } catch (const std::system_error&) {
+        ++errors;
+    }
+    try {
+        failing.close();
+    } catch (const std::system_error&) {
+        ++errors;
+    }
+    assert(errors == 3 && !failing.is_open() && !failing.get_sink().closed && failing.size() <= 1000);
+
+    archive::storage::AsyncWriter<FailingSink> closing(FailingSink{1000}, 64, 2);
+    closing.write(reinterpret_cast<const unsigned char*>("data"), 4);
+    closing.close();
+    assert(closing.get_sink().closed && closing.get_sink().size == 4);
+}
+
+/// Codec plugged into the compression storages: one byte per run of equal bytes
+struct RunLengthCodec {
+    static constexpr std::uint8_t id = 7;
+
+    size_t max_compressed_size(size_t size) const { return 2 * size; }
+
+    size_t compress(const unsigned char* src, size_t size, unsigned char* dst, size_t capacity) const {
+        size_t op = 0;
+        for (size_t i = 0; i < size; op += 2) {
+            size_t run = 1;
+            while (i + run < size && run < 255 && src[i + run] == src[i]) {
+                ++run;
+            }
+            if (op + 2 > capacity) {
+                return 0;
+            }
+            dst[op] = static_cast<unsigned char>(run);
+            dst[op + 1] = src[i];
+            i += run;
+        }
+        return op;
+    }
+
+    void decompress(const unsigned char* src, size_t size, unsigned char* dst, size_t original_size) const {
+        size_t op = 0;
+        for (size_t i = 0; i + 1 < size; i += 2) {
+            if (op + src[i] > original_size) {
+                throw std::system_error(std::make_error_code(std::errc::illegal_byte_sequence));
+            }
+            memset(dst + op, src[i + 1], src[i]);
+            op += src[i];
+        }
+    }
+};
+
+void test_lz_codec() {
+    const archive::compression::Lz codec;
+    std::mt19937 random(42);
+    std::vector<unsigned char> input;
+    std::vector<unsigned char> compressed;
+    std::vector<unsigned char> output;
+    for (size_t size: {0, 1, 5, 12, 13, 64, 100, 1000, 70000, 200000}) {
+        for (int kind = 0; kind < 3; ++kind) {
+            input.resize(size);
+            for (size_t i = 0; i < size; ++i) {
+                // random bytes, short repeats far apart and long runs
+                input[i] = kind == 0 ? static_cast<unsigned char>(random())
+                         : kind == 1 ? static_cast<unsigned char>("abcdefgh"[random() % 8])
+                         : static_cast<unsigned char>(i / 1000);
+            }
+            compressed.assign(codec.max_compressed_size(size), 0);
+            const size_t compressed_size = codec.compress(input.data(), size, compressed.data(), compressed.size());
+            assert(compressed_size > 0);
+            if (kind == 2 && size >= 1000) {
+                assert(compressed_size * 20 < size);
+            }
+            output.assign(size, 0);
+            codec.decompress(compressed.data(), compressed_size, output.data(), size);
+            assert(output == input);
+            // too small output buffer is reported, not overrun
+            assert(size < 2 || codec.compress(input.data(), size, compressed.data(), 1) == 0);
+
+            // malformed input throws and stays in bounds
+            for (int i = 0; i < 20 && compressed_size > 0; ++i) {
+                std::vector<unsigned char> damaged(compressed.begin(), compressed.begin() + long(compressed_size));
+                damaged[random() % compressed_size] ^= static_cast<unsigned char>(1 + random() % 255);
+                try {
+                    codec.decompress(damaged.data(), damaged.size(), output.data(), size);
+                } catch (const std::system_error& e) {
+                    assert(e.code() == std::errc::illegal_byte_sequence);
+                }
+            }
+        }
+    }
+}
+
+template<typename Codec>
+void test_compress_storage_with(archive::ThreadPool* pool) {
+    using Sink = archive::storage::Buffer;
+    using Writer = archive::BinaryArchive<archive::storage::CompressWriter<Sink, Codec>, archive::storage_policy::Inline>;
+    using Reader = archive::BinaryArchive<archive::storage::DecompressReader<archive::storage::MemoryReader, Codec>, archive::storage_policy::Inline>;
+
+    Checkpoint test;
+    test.a.assign(20000, 1.25);
+    test.b.resize(3000);
+    for (size_t i = 0; i < test.b.size(); ++i) {
+        test.b[i] = static_cast<double>(i % 100);
+    }
+    test.name = "compressed";
+    test.c.assign(1000, 7);
+    std::vector<std::uint32_t> noise(5000);
+    std::mt19937 random(7);
+    for (auto& n: noise) {
+        n = random();
+    }
+
+    archive::stream::Writer<Writer> writer(Sink(), 4096);
+    if (pool) {
+        writer.getArchive().get_storage().compress_on(*pool);
+    }
+    archive::stream::Writer<archive::BinaryArchive<Sink>> plain;
+    for (int i = 0; i < 5; ++i) {
+        writer & test & noise;
+        plain & test & noise;
+    }
+    auto& storage = writer.getArchive().get_storage();
+    storage.flush();
+    // blocks continue after a flush
+    writer & test;
+    plain & test;
+    storage.close();
+    const Sink& sink = storage.get_sink();
+    assert(storage.size() == plain.getArchive().get_storage().size() && storage.compressed_size() == sink.size());
+    assert(sink.size() < storage.size() / (std::is_same_v<Codec, archive::compression::Lz> ? 2 : 1));
+
+    archive::stream::Reader<Reader> reader(archive::storage::MemoryReader(sink.data(), sink.size()));
+    for (int i = 0; i < 5; ++i) {
+        Checkpoint result;
+        std::vector<std::uint32_t> noise1;
+        if (i == 2) {
+            // whole blocks are skipped without decompression
+            reader.template skip<Checkpoint>().template skip<std::vector<std::uint32_t>>();
+            continue;
+        }
+        reader & result & noise1;
+        assert(result.a == test.a && result.b == test.b && result.name == test.name && result.c == test.c && noise1 == noise);
+    }
+    Checkpoint last;
+    reader & last;
+    assert(last.a == test.a && last.c == test.c);
+}
+
+void test_compress_storage() {
+    test_lz_codec();
+    archive::ThreadPool pool(3);
+    test_compress_storage_with<archive::compression::Lz>(nullptr);
+    test_compress_storage_with<archive::compression::Lz>(&pool);
+    test_compress_storage_with<RunLengthCodec>(&pool);
+
+    // parallel compression produces the same bytes
+    std::vector<std::string> strings(20000);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        strings[i] = std::to_string(i * 7919);
+    }
+    using Writer = archive::BinaryArchive<archive::storage::CompressWriter<archive::storage::Buffer>, archive::storage_policy::Inline>;
+    Writer sequential(archive::storage::Buffer(), 1000);
+    Writer concurrent(archive::storage::Buffer(), 1000);
+    concurrent.get_storage().compress_on(pool);
+    sequential.serialize(strings);
+    concurrent.serialize(strings);
+    sequential.get_storage().flush();
+    concurrent.get_storage().flush();
+    const auto& bytes = sequential.get_storage().get_sink();
+    const auto& bytes1 = concurrent.get_storage().get_sink();
+    assert(bytes.size() == bytes1.size() && memcmp(bytes.data(), bytes1.data(), bytes.size()) == 0);
+
+#if defined(HAS_MMAP)
+    // block buffers are reused only after sinks that reference them are flushed
+    const std::string path = (std::filesystem::temp_directory_path() / "archive_test_compress.bin").string();
+    std::vector<std::uint32_t> noise(100000);
+    std::mt19937 random(11);
+    for (auto& n: noise) {
+        n = random();
+    }
+    for (archive::ThreadPool* on: {static_cast<archive::ThreadPool*>(nullptr), &pool}) {
+        {
+            archive::BinaryArchive<archive::storage::CompressWriter<archive::storage::GatherWriter>, archive::storage_policy::Inline>
+                    file {archive::storage::GatherWriter(path)};
+            if (on) {
+                file.get_storage().compress_on(*on);
+            }
+            file.serialize(noise);
+            file.serialize(strings);
+            file.get_storage().close();
+        }
+        archive::BinaryArchive<archive::storage::DecompressReader<archive::storage::MmapReader>, archive::storage_policy::Inline>
+                reader {archive::storage::MmapReader(path)};
+        std::vector<std::uint32_t> noise1;
+        std::vector<std::string> strings1;
+        reader.deserialize(noise1);
+        reader.deserialize(strings1);
+        assert(noise1 == noise && strings1 == strings);
+    }
+
+    // adapters stack: compressed blocks are checksummed, sinks that cannot move are built in place
+    {
+        using Checksummed = archive::storage::ChecksumWriter<archive::storage::GatherWriter>;
+        archive::BinaryArchive<archive::storage::CompressWriter<Checksummed>, archive::storage_policy::Inline>
+                file {Checksummed(archive::storage::GatherWriter(path), 4096)};
+        file.serialize(noise);
+        file.serialize(strings);
+        file.get_storage().close();
+    }
+    archive::BinaryArchive<archive::storage::DecompressReader<archive::storage::ChecksumReader<archive::storage::MmapReader>>, archive::storage_policy::Inline>
+            stacked {archive::storage::ChecksumReader<archive::storage::MmapReader>(archive::storage::MmapReader(path))};
+    std::vector<std::uint32_t> noise1;
+    std::vector<std::string> strings1;
+    stacked.deserialize(noise1);
+    stacked.deserialize(strings1);
+    assert(noise1 == noise && strings1 == strings);
+    stacked.get_storage().get_source().verify_end();
+    std::remove(path.c_str());
+#endif
+    archive::BinaryArchive<archive::storage::CompressWriter<archive::storage::AsyncWriter<archive::storage::Buffer>>, archive::storage_policy::Inline>
+            async {std::in_place, size_t(1000), archive::storage::Buffer(), size_t(4096)};
+    async.serialize(strings);
+    async.get_storage().flush();
+    const archive::storage::Buffer& async_bytes = async.get_storage().get_sink().get_sink();
+    assert(async_bytes.size() == bytes.size() && memcmp(async_bytes.data(), bytes.data(), bytes.size()) == 0);
+}
+
+void test_crc32c() {
+    assert(archive::checksum::crc32c("123456789", 9) == 0xe3069283);
+    assert(archive::checksum::crc32c("", 0) == 0);
+
+    std::mt19937 random(3);
+    std::vector<unsigned char> data(3 * 4096 * 3 + 100);
+    for (auto& byte: data) {
+        byte = static_cast<unsigned char>(random());
+    }
+    for (size_t size: {1, 7, 8, 9, 100, 3 * 4096 - 1, 3 * 4096, 3 * 4096 + 13, 2 * 3 * 4096 + 99}) {
+        for (size_t offset: {0, 1, 3}) {
+            const unsigned char* bytes = data.data() + offset;
+            const std::uint32_t expected = ~archive::checksum::details::crc32c_scalar(~0u, bytes, size);
+            assert(archive::checksum::crc32c(bytes, size) == expected);
+            // continued checksum matches the one over the whole range
+            const size_t half = size / 3;
+            assert(archive::checksum::crc32c(bytes + half, size - half, archive::checksum::crc32c(bytes, half)) == expected);
+        }
+    }
+}
+
+void test_checksum_storage() {
+    test_crc32c();
+
+    Checkpoint test;
+    test.a.assign(5000, 1.25);
+    test.b.assign(300, 2.5);
+    test.name = "checksummed";
+    test.c.assign(77, 7);
+
+    using Sink = archive::storage::Buffer;
+    archive::stream::Writer<archive::BinaryArchive<archive::storage::ChecksumWriter<Sink>, archive::storage_policy::Inline>> writer(Sink(), 1000);
+    for (int i = 0; i < 3; ++i) {
+        writer & test;
+    }
+    auto& storage = writer.getArchive().get_storage();
+    storage.close();
+    const Sink& sink = storage.get_sink();
+    const size_t blocks = (size_t(storage.size()) + 999) / 1000 + 1;
+    assert(sink.size() == storage.size() + 8 * blocks);
+
+    using MemoryReader = archive::storage::MemoryReader;
+    const auto read_all = [&test] (auto& reader) {
+        for (int i = 0; i < 3; ++i) {
+            Checkpoint result;
+            if (i == 1) {
+                reader.template skip<Checkpoint>();
+                continue;
+            }
+            reader & result;
+            assert(result.a == test.a && result.b == test.b && result.name == test.name && result.c == test.c);
+        }
+        reader.getArchive().get_storage().verify_end();
+    };
+    {
+        // contiguous sources are verified in place, others through a block buffer
+        archive::stream::Reader<archive::BinaryArchive<archive::storage::ChecksumReader<MemoryReader>, archive::storage_policy::Inline>> reader(MemoryReader(sink.data(), sink.size()));
+        read_all(reader);
+        archive::storage::Buffer copy;
+        copy.write(sink.data(), sink.size());
+        archive::stream::Reader<archive::BinaryArchive<archive::storage::ChecksumReader<Sink>, archive::storage_policy::Inline>> buffered(std::move(copy));
+        read_all(buffered);
+    }
+
+    const auto expect_error = [] (std::vector<unsigned char> bytes, size_t blocks_before) {
+        archive::storage::ChecksumReader<MemoryReader> reader(MemoryReader(bytes.data(), bytes.size()));
+        std::vector<unsigned char> chunk(1000);
+        size_t read = 0;
+        try {
+            for (;; ++read) {
+                reader.read(chunk.data(), chunk.size());
+            }
+        } catch (const std::system_error& e) {
+            assert(e.code() == std::errc::illegal_byte_sequence);
+        }
+        // fails on the damaged block, before any of its bytes are returned
+        assert(read == blocks_before);
+    };
+    std::vector<unsigned char> bytes(sink.data(), sink.data() + sink.size());
+    std::vector<unsigned char> damaged = bytes;
+    damaged[3 * 1008 + 500] ^= 1;
+    expect_error(damaged, 3);
+    expect_error(std::vector<unsigned char>(bytes.begin(), bytes.begin() + 5 * 1008 + 700), 5);
+    expect_error(std::vector<unsigned char>(bytes.begin(), bytes.begin() + 5 * 1008 + 4), 5);
+
+    // cut at a block boundary: every block is valid but the end marker is missing
+    archive::storage::ChecksumReader<MemoryReader> cut(MemoryReader(bytes.data(), 2 * 1008));
+    std::vector<unsigned char> chunk(2000);
+    cut.read(chunk.data(), chunk.size());
+    bool thrown = false;
+    try {
+        cut.verify_end();
+    } catch (const std::system_error&) {
+        thrown = true;
+    }
+    assert(thrown);
+
+#if defined(HAS_MMAP)
+    // the block buffer is reused only after sinks that reference it are flushed
+    const std::string path = (std::filesystem::temp_directory_path() / "archive_test_checksum.bin").string();
+    {
+        archive::stream::Writer<archive::BinaryArchive<archive::storage::ChecksumWriter<archive::storage::GatherWriter>, archive::storage_policy::Inline>>
+                file {archive::storage::GatherWriter(path)};
+        for (int i = 0; i < 10; ++i) {
+            file & test;
+        }
+        file.getArchive().get_storage().close();
+    }
+    archive::stream::Reader<archive::BinaryArchive<archive::storage::ChecksumReader<archive::storage::MmapReader>, archive::storage_policy::Inline>>
+            mapped {archive::storage::MmapReader(path)};
+    for (int i = 0; i < 10; ++i) {
+        Checkpoint result;
+        mapped & result;
+        assert(result.a == test.a && result.b == test.b && result.name == test.name && result.c == test.c);
+    }
+    mapped.getArchive().get_storage().verify_end();
+
+    // whole blocks passed through from parallel chunk buffers, which are reused once written
+    std::vector<std::string> strings(200000);
+    for (size_t i = 0; i < strings.size(); ++i) {
+        strings[i] = std::to_string(i * 7919);
+    }
+    archive::ThreadPool pool(4);
+    {
+        archive::BinaryArchive<archive::storage::ChecksumWriter<archive::storage::GatherWriter>, archive::storage_policy::Inline>
+                file {archive::storage::GatherWriter(path), 16384};
+        file.serialize(strings, archive::parallel.on(pool));
+        file.get_storage().close();
+    }
+    archive::BinaryArchive<archive::storage::ChecksumReader<archive::storage::MmapReader>, archive::storage_policy::Inline>
+            parallel_reader {archive::storage::MmapReader(path)};
+    std::vector<std::string> strings1;
+    parallel_reader.deserialize(strings1);
+    assert(strings1 == strings);
+    std::remove(path.c_str());
+#endif
+}
+
+void assert_same_bit_packing(const archive::details::BitPackKernels& kernels) {
+    const archive::details::BitPackKernels reference = archive::details::make_bit_pack_kernels<archive::details::BitPackScalar>(std::make_index_sequence<33>{});
+    const auto bytes = [] (auto& vector) { return reinterpret_cast<unsigned char*>(vector.data()); };
+    std::mt19937 random(7);
+    std::vector<std::uint32_t> values(archive::details::packed_block_size), unpacked(values.size());
+    // values are accessed as bytes, so unaligned buffers work too
+    std::vector<unsigned char> unaligned(values.size() * 4 + 1);
+    for (unsigned bits = 0; bits <= 32; ++bits) {
+        for (auto& value: values) {
+            value = bits == 32 ? random() : random() & ((1u << bits) - 1);
+        }
+        std::vector<unsigned char> expected(bits * 32 + 1, 0xaa), packed(expected);
+        reference.pack[bits](bytes(values), expected.data());
+        kernels.pack[bits](bytes(values), packed.data());
+        assert(packed == expected && packed.back() == 0xaa);
+        kernels.unpack[bits](packed.data(), bytes(unpacked));
+        assert(unpacked == values);
+        kernels.unpack[bits](packed.data(), unaligned.data() + 1);
+        assert(memcmp(unaligned.data() + 1, values.data(), values.size() * 4) == 0);
+        kernels.pack[bits](unaligned.data() + 1, packed.data());
+        assert(packed == expected);
+    }
+    for (auto& value: values) {
+        value = random();
+    }
+    std::vector<std::uint32_t> expected(values);
+    std::vector<std::uint32_t> decoded(values);
+    assert(reference.delta_decode32(bytes(expected), 251, 5) == expected[250]);
+    assert(kernels.delta_decode32(bytes(decoded), 251, 5) == decoded[250] && decoded == expected);
+
+    std::vector<std::uint64_t> expected64(251);
+    for (auto& value: expected64) {
+        value = std::uint64_t(random()) << 32 | random();
+    }
+    std::vector<std::uint64_t> decoded64(expected64);
+    assert(reference.delta_decode64(bytes(expected64), 251, 5) == expected64[250]);
+    assert(kernels.delta_decode64(bytes(decoded64), 251, 5) == decoded64[250] && decoded64 == expected64);
+}
+
+template<typename Encoding, typename ByteOrder, typename Container>
+void assert_packed(const Container& container) {
+    using Archive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding, ByteOrder>;
+    Archive archive;
+    const archive::usize size = archive.serialize(archive::Packed(container)) + archive.serialize(archive::Delta(container));
+    assert(size == archive.size());
+    assert(size == Archive::serialized_size(archive::Packed(container)) + Archive::serialized_size(archive::Delta(container)));
+    archive.serialize(std::string("tail"));
+
+    Container packed;
+    Container delta;
+    archive.deserialize(archive::Packed(packed));
+    archive.deserialize(archive::Delta(delta));
+    assert(packed == container && delta == container && archive.template deserialize<std::string>() == "tail");
+
+    // elements are appended, other storages are read block by block
+    auto dummy = std::make_unique<archive::BinaryArchive<DummyStorage<1 << 16>, archive::storage_policy::Parent, Encoding, ByteOrder>>();
+    dummy->get_storage().write(archive.get_bytes().data(), archive.get_bytes().size());
+    dummy->deserialize(archive::Packed(packed));
+    dummy->template skip<archive::Delta<Container>>();
+    assert(dummy->template deserialize<std::string>() == "tail");
+    assert(packed.size() == 2 * container.size() && std::equal(container.begin(), container.end(), std::next(packed.begin(), std::ptrdiff_t(container.size()))));
+}
+
+void test_packed() {
+#if defined(__x86_64__) || defined(__i386__)
+    assert_same_bit_packing(archive::details::make_bit_pack_kernels<archive::details::BitPackSse2>(std::make_index_sequence<33>{}));
+    if (archive::details::cpu_features().avx2) {
+        assert_same_bit_packing(archive::details::make_bit_pack_kernels<archive::details::BitPackAvx2>(std::make_index_sequence<33>{}));
+    }
+#endif
+
+    std::mt19937_64 random(3);
+    std::vector<std::uint32_t> ids(1000);
+    for (auto& id: ids) {
+        id = 1000000 + std::uint32_t(random() % 4096);
+    }
+    std::vector<std::uint64_t> timestamps(700);
+    std::uint64_t now = std::uint64_t(1) << 40;
+    for (auto& timestamp: timestamps) {
+        timestamp = now += random() % 100;
+    }
+    std::vector<std::int64_t> wide(600);  // offsets of more than 32 bits
+    for (auto& value: wide) {
+        value = std::int64_t(random());
+    }
+    std::deque<std::int8_t> bytes(300);
+    for (auto& value: bytes) {
+        value = std::int8_t(random());
+    }
+    std::list<int> ints;
+    for (int i = 0; i < 520; ++i) {
+        ints.push_back(i % 3 ? -i * 1000 : i);
+    }
+
+    assert_packed<archive::encoding::Fixed, archive::byte_order::Native>(ids);
+    assert_packed<archive::encoding::Varint, archive::byte_order::Big>(ids);
+    assert_packed<archive::encoding::Fixed, archive::byte_order::Big>(timestamps);
+    assert_packed<archive::encoding::Fixed, archive::byte_order::Native>(wide);
+    assert_packed<archive::encoding::VarintLengths, archive::byte_order::Native>(bytes);
+    assert_packed<archive::encoding::Fixed, archive::byte_order::Little>(ints);
+    assert_packed<archive::encoding::Fixed, archive::byte_order::Native>(std::vector<std::uint16_t>{7});
+    assert_packed<archive::encoding::Fixed, archive::byte_order::Native>(std::vector<std::uint32_t>(256, 9));
+    assert_packed<archive::encoding::Fixed, archive::byte_order::Native>(std::vector<int>());
+
+    // 12 bits per id and 8 bits per timestamp step instead of 32 and 64
+    assert(archive::serialized_size(archive::Packed(ids)) < archive::serialized_size(ids) / 2);
+    assert(archive::serialized_size(archive::Delta(timestamps)) < archive::serialized_size(timestamps) / 6);
+}
+
+/// Analytics row declaring its columns for `archive::Columnar`
+struct Trade {
+    std::int64_t time = 0;
+    double price = 0;
+    std::uint32_t quantity = 0;
+    std::string symbol;
+    Vec3 position {0, 0, 0};
+
+    bool operator == (const Trade& other) const {
+        return time == other.time && price == other.price && quantity == other.quantity
+                && symbol == other.symbol && position == other.position;
+    }
+};
+
+constexpr auto columnar_fields(const Trade*) {
+    return std::make_tuple(&Trade::time, &Trade::price, &Trade::quantity, &Trade::symbol, &Trade::position);
+}
+
+template<typename Encoding, typename ByteOrder, typename Container>
+void assert_columnar(const Container& container) {
+    using Archive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding, ByteOrder>;
+    Archive archive;
+    const archive::usize size = archive.serialize(archive::Columnar(container));
+    assert(size == archive.size() && size == Archive::serialized_size(archive::Columnar(container)));
+    archive.serialize(std::string("tail"));
+
+    Container decoded;
+    archive.deserialize(archive::Columnar(decoded));
+    assert(decoded == container && archive.template deserialize<std::string>() == "tail");
+
+    archive.rewind();
+    archive.template skip<archive::Columnar<Container>>();
+    assert(archive.template deserialize<std::string>() == "tail");
+}
+
+void test_columnar() {
+    std::vector<std::tuple<int, double, std::string>> rows;
+    for (int i = 0; i < 300; ++i) {
+        rows.emplace_back(i * 7, i * 0.25, std::string(size_t(i % 5), 'r'));
+    }
+    std::vector<Trade> trades;
+    for (int i = 0; i < 100; ++i) {
+        trades.push_back({1700000000000 + i, 100.5 + i, std::uint32_t(i * 3), "SYM" + std::to_string(i % 7), {float(i), 1, 2}});
+    }
+    std::list<std::pair<std::uint16_t, std::vector<int>>> pairs {{1, {1, 2}}, {2, {}}, {3, {-3}}};
+
+    assert_columnar<archive::encoding::Fixed, archive::byte_order::Native>(rows);
+    assert_columnar<archive::encoding::Varint, archive::byte_order::Big>(rows);
+    assert_columnar<archive::encoding::Fixed, archive::byte_order::Native>(trades);
+    assert_columnar<archive::encoding::VarintLengths, archive::byte_order::Big>(trades);
+    assert_columnar<archive::encoding::Fixed, archive::byte_order::Native>(pairs);
+    assert_columnar<archive::encoding::Fixed, archive::byte_order::Native>(std::deque<std::array<std::int64_t, 3>>(5, {{1, 2, 3}}));
+    assert_columnar<archive::encoding::Fixed, archive::byte_order::Native>(std::vector<Trade>());
+
+    // only the selected columns are decoded, into elements appended after the existing ones
+    archive::BinaryArchive<archive::storage::Buffer> archive;
+    archive.serialize(archive::Columnar(trades));
+    std::vector<Trade> prices(1);
+    archive.deserialize(archive::Columnar(prices).only({1, 3}));
+    assert(prices.size() == trades.size() + 1 && archive.get_storage().read_position() == archive.size());
+    for (size_t i = 0; i < trades.size(); ++i) {
+        const Trade& t = prices[i + 1];
+        assert(t.price == trades[i].price && t.symbol == trades[i].symbol && t.time == 0 && t.quantity == 0);
+    }
+
+    // a column is written like a vector of its field
+    archive::BinaryArchive<archive::storage::Buffer> columns;
+    columns.serialize(archive::Columnar(rows));
+    archive::usize length = 0;
+    std::vector<int> first;
+    std::vector<double> second;
+    columns.deserialize(length);
+    columns.deserialize(first);
+    columns.deserialize(second);
+    assert(length == rows.size() && first.size() == rows.size() && first[10] == 70 && second[10] == 2.5);
+}
+
+template<typename Encoding, typename ByteOrder>
+void assert_string_dictionary(const std::vector<std::string>& strings) {
+    using Archive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding, ByteOrder>;
+    archive::StringDictionary writer;
+    Archive archive;
+    archive.set_string_dictionary(&writer);
+    archive.serialize(strings);
+    archive.serialize(std::string_view("tail"));
+
+    archive::StringDictionary reader;
+    archive.set_string_dictionary(&reader);
+    std::vector<std::string> result;
+    std::string_view tail;
+    archive.deserialize(result);
+    archive.deserialize(tail);
+    assert(result == strings && tail == "tail" && archive.get_storage().read_position() == archive.size());
+    assert(reader.size() == writer.size());
+}
+
+void test_string_dictionary() {
+    std::vector<std::string> strings;
+    for (int i = 0; i < 1000; ++i) {
+        strings.push_back("symbol-" + std::to_string(i % 10));
+    }
+    strings.push_back(std::string(1000, 'l'));
+    strings.push_back("");
+
+    assert_string_dictionary<archive::encoding::Fixed, archive::byte_order::Native>(strings);
+    assert_string_dictionary<archive::encoding::Varint, archive::byte_order::Big>(strings);
+    assert_string_dictionary<archive::encoding::VarintLengths, archive::byte_order::Little>(std::vector<std::string>());
+
+    // repeated strings are written once, later occurrences as ids
+    archive::BinaryArchive<archive::storage::Buffer> plain;
+    plain.serialize(strings);
+    archive::StringDictionary dictionary;
+    archive::BinaryArchive<archive::storage::Buffer> archive;
+    archive.set_string_dictionary(&dictionary);
+    archive.serialize(strings);
+    assert(dictionary.size() == 11 && dictionary[0] == "symbol-0" && archive.size() * 4 < plain.size());
+
+    // views point into the dictionary, so equal strings share memory; map keys use the dictionary too
+    std::map<std::string, int> map {{"symbol-3", 3}, {"other", 4}};
+    archive.serialize(map);
+    archive.serialize(std::vector<std::string_view>{"symbol-1", "symbol-1"});
+    archive::StringDictionary reader;
+    archive.set_string_dictionary(&reader);
+    std::vector<std::string_view> views;
+    std::map<std::string, int> map1;
+    archive.deserialize(views);
+    assert(views.size() == strings.size() && views[1].data() == views[11].data() && views[1] == "symbol-1");
+    assert(views[1000].size() == 1000 && views[1001].empty());
+    archive.deserialize(map1);
+    assert(map1 == map);
+    archive.deserialize(views);
+    assert(views[1000 + 2].data() == views[1].data());
+
+    // skipped strings are still learned so later ids resolve
+    archive.rewind();
+    archive::StringDictionary skipper;
+    archive.set_string_dictionary(&skipper);
+    archive.skip<std::vector<std::string>>();
+    archive.skip<std::map<std::string, int>>();
+    std::vector<std::string> last;
+    archive.deserialize(last);
+    assert(last.size() == 2 && last[0] == "symbol-1" && skipper.size() == reader.size());
+
+    // new strings past the limit are written in full
+    archive::StringDictionary small(2, 4);
+    archive::BinaryArchive<archive::storage::Buffer> limited;
+    limited.set_string_dictionary(&small);
+    limited.serialize(std::vector<std::string>{"long string", "a", "b", "c", "c", "a"});
+    assert(small.size() == 2);
+    archive::StringDictionary small1(2, 4);
+    limited.set_string_dictionary(&small1);
+    std::vector<std::string> limited1;
+    limited.deserialize(limited1);
+    assert((limited1 == std::vector<std::string>{"long string", "a", "b", "c", "c", "a"}));
+
+    // parallel writes fall back to sequential, nested encodings are written without the dictionary
+    archive::ThreadPool pool(2);
+    archive::StringDictionary sequential_dictionary;
+    archive::StringDictionary parallel_dictionary;
+    archive::BinaryArchive<archive::storage::Buffer> sequential;
+    archive::BinaryArchive<archive::storage::Buffer> parallel;
+    sequential.set_string_dictionary(&sequential_dictionary);
+    parallel.set_string_dictionary(&parallel_dictionary);
+    sequential.serialize(strings);
+    parallel.serialize(strings, archive::parallel.on(pool).with_chunk_length(7));
+    assert(sequential.get_bytes() == parallel.get_bytes());
+
+    archive::StringDictionary nested;
+    archive::BinaryArchive<archive::storage::Buffer> outer;
+    outer.set_string_dictionary(&nested);
+    outer.serialize(std::string("symbol-1"));
+    outer.serialize(archive::Indexed(strings, 100));
+    outer.serialize(archive::Lazy<std::vector<std::string>>(strings));
+    assert(nested.size() == 1);
+    archive::StringDictionary nested1;
+    outer.set_string_dictionary(&nested1);
+    std::string first;
+    std::vector<std::string> indexed;
+    archive::Lazy<std::vector<std::string>> lazy;
+    outer.deserialize(first);
+    outer.deserialize(archive::Indexed(indexed));
+    outer.deserialize(lazy);
+    assert(first == "symbol-1" && indexed == strings && lazy.get() == strings);
+}
+
+struct GraphNode {
+    int value = 0;
+    std::vector<std::shared_ptr<GraphNode>> children;
+    std::weak_ptr<GraphNode> parent;
+};
+
+template<typename Archive>
+archive::usize serialize_object(const GraphNode& n, Archive& a) {
+    return a.serialize(n.value) + a.serialize(n.children) + a.serialize(n.parent);
+}
+
+template<typename Archive>
+void deserialize_object(GraphNode& n, Archive& a) {
+    a.deserialize(n.value);
+    a.deserialize(n.children);
+    a.deserialize(n.parent);
+}
+
+struct ListNode {
+    int value = 0;
+    std::unique_ptr<ListNode> next;
+    const ListNode* previous = nullptr;
+};
+
+template<typename Stream>
+void stream_serialization(Stream& stream, archive::ArgumentRef<ListNode, Stream::get_policy()>& t) {
+    stream & t.value & t.next & t.previous;
+}
+
+template<typename Encoding, typename ByteOrder>
+void assert_object_graph(const std::vector<std::shared_ptr<GraphNode>>& roots) {
+    using Archive = archive::BinaryArchive<archive::storage::Buffer, archive::storage_policy::Parent, Encoding, ByteOrder>;
+    archive::ObjectTable writer;
+    Archive archive;
+    archive.set_object_table(&writer);
+    archive.serialize(roots);
+
+    archive::ObjectTable reader;
+    archive.set_object_table(&reader);
+    std::vector<std::shared_ptr<GraphNode>> result;
+    archive.deserialize(result);
+    assert(result.size() == roots.size() && reader.size() == writer.size());
+    assert(archive.get_storage().read_position() == archive.size());
+    for (size_t i = 0; i < roots.size(); ++i) {
+        assert(!roots[i] == !result[i] && (!roots[i] || roots[i]->value == result[i]->value));
+        for (size_t j = 0; j < roots.size(); ++j) {
+            assert((roots[i] == roots[j]) == (result[i] == result[j]));
+        }
+    }
+}
+
+void test_object_graph() {
+    // many parents share one child, the child points back to the first parent
+    auto shared = std::make_shared<GraphNode>();
+    shared->value = 7;
+    std::vector<std::shared_ptr<GraphNode>> roots;
+    for (int i = 0; i < 100; ++i) {
+        roots.push_back(std::make_shared<GraphNode>());
+        roots.back()->value = i;
+        roots.back()->children = {shared, nullptr};
+    }
+    shared->parent = roots[0];
+    roots.push_back(shared);
+    roots.push_back(nullptr);
+    roots.push_back(roots[5]);
+
+    assert_object_graph<archive::encoding::Fixed, archive::byte_order::Native>(roots);
+    assert_object_graph<archive::encoding::Varint, archive::byte_order::Big>(roots);
+
+    archive::ObjectTable table;
+    archive::BinaryArchive<archive::storage::Buffer> archive;
+    archive.set_object_table(&table);
+    archive.serialize(roots);
+    archive::ObjectTable reader;
+    archive.set_object_table(&reader);
+    std::vector<std::shared_ptr<GraphNode>> result;
+    archive.deserialize(result);
+    assert(table.size() == 101 && result[100] == result[0]->children[0] && result[100] == result[99]->children[0]);
+    assert(result[100]->parent.lock() == result[0] && result[0]->children[1] == nullptr && result[102] == result[5]);
+
+    // without a table every pointer writes its object
+    archive::BinaryArchive<archive::storage::Buffer> copies;
+    shared->parent.reset();
+    copies.serialize(roots);
+    assert(copies.size() > archive.size());
+    std::vector<std::shared_ptr<GraphNode>> copied;
+    copies.deserialize(copied);
+    assert(copied[0]->children[0] != copied[1]->children[0] && copied[1]->children[0]->value == 7 && copied[102] != copied[5]);
+
+    // shared cycles and weak-only objects, which the reading table keeps alive
+    auto loop = std::make_shared<GraphNode>();
+    loop->children = {loop};
+    auto orphan = std::make_shared<GraphNode>();
+    orphan->value = 3;
+    std::weak_ptr<GraphNode> weak = orphan;
+    archive::ObjectTable cycles;
+    archive::BinaryArchive<archive::storage::Buffer> graph;
+    graph.set_object_table(&cycles);
+    graph.serialize(loop);
+    graph.serialize(weak);
+    graph.serialize(orphan);
+    loop->children.clear();
+    {
+        archive::ObjectTable reader1;
+        graph.set_object_table(&reader1);
+        std::shared_ptr<GraphNode> loop1;
+        std::weak_ptr<GraphNode> weak1;
+        std::shared_ptr<GraphNode> orphan1;
+        graph.deserialize(loop1);
+        graph.deserialize(weak1);
+        graph.deserialize(orphan1);
+        assert(loop1->children[0] == loop1 && weak1.lock() == orphan1 && orphan1->value == 3);
+        loop1->children.clear();
+        reader1.clear();
+        assert(!weak1.expired() && loop1.use_count() == 1);
+    }
+
+    // skipped objects are still numbered, so later back-references resolve
+    archive::ObjectTable skipped;
+    archive::BinaryArchive<archive::storage::Buffer> skips;
+    skips.set_object_table(&skipped);
+    skips.serialize(roots);
+    skips.serialize(weak);
+    skips.serialize(orphan);
+    archive::ObjectTable skipper;
+    skips.set_object_table(&skipper);
+    skips.skip<std::vector<std::shared_ptr<GraphNode>>>();
+    skips.skip<std::weak_ptr<GraphNode>>();
+    std::shared_ptr<GraphNode> orphan2;
+    skips.deserialize(orphan2);
+    assert(orphan2 && orphan2->value == 3 && skipper.size() == skipped.size());
+
+    // the writing table keeps shared objects alive, so a new object cannot reuse the address of a freed one
+    archive::ObjectTable temporaries;
+    archive::BinaryArchive<archive::storage::Buffer> short_lived;
+    short_lived.set_object_table(&temporaries);
+    for (int i = 0; i < 4; ++i) {
+        short_lived.serialize(std::make_shared<int>(i));
+    }
+    archive::ObjectTable temporaries1;
+    short_lived.set_object_table(&temporaries1);
+    for (int i = 0; i < 4; ++i) {
+        std::shared_ptr<int> value;
+        short_lived.deserialize(value);
+        assert(*value == i);
+    }
+    assert(temporaries.size() == 4 && temporaries1.size() == 4);
+
+    // raw pointers refer back to objects owned elsewhere, objects read through them belong to the table
+    // (or to the caller without one), an object and its first member are told apart
+    using Pair = std::pair<int, int>;
+    auto pair = std::make_unique<Pair>(1, 2);
+    const Pair* view = pair.get();
+    std::shared_ptr<int> member(std::shared_ptr<void>(), &pair->first);
+    archive::ObjectTable raw;
+    archive::BinaryArchive<archive::storage::Buffer> pointers;
+    pointers.set_object_table(&raw);
+    pointers.serialize(pair);
+    pointers.serialize(view);
+    pointers.serialize(member);
+    pointers.serialize(std::unique_ptr<int>());
+    archive::ObjectTable raw1;
+    pointers.set_object_table(&raw1);
+    std::unique_ptr<Pair> pair1;
+    const Pair* view1 = nullptr;
+    std::shared_ptr<int> member1;
+    std::unique_ptr<int> empty = std::make_unique<int>(5);
+    pointers.deserialize(pair1);
+    pointers.deserialize(view1);
+    pointers.deserialize(member1);
+    pointers.deserialize(empty);
+    assert(view1 == pair1.get() && pair1->second == 2 && *member1 == 1 && member1.get() != &pair1->first && !empty);
+    pointers.rewind();
+    pointers.set_object_table(nullptr);
+    const Pair* owned = pointers.deserialize<Pair*>();
+    assert(owned->first == 1);
+    delete owned;
+
+    // back-references that cannot be resolved throw instead of leaving null or dangling pointers
+    const auto throws = [] (auto&& action) {
+        try {
+            action();
+        } catch (const std::system_error&) {
+            return true;
+        }
+        return false;
+    };
+    auto first = std::make_shared<Pair>(3, 4);
+    archive::ObjectTable errors;
+    archive::BinaryArchive<archive::storage::Buffer> invalid;
+    invalid.set_object_table(&errors);
+    invalid.serialize(first);
+    invalid.serialize(first);
+    invalid.serialize(pair);
+    invalid.serialize(view);
+    std::unique_ptr<Pair> alias(pair.get());
+    assert(throws([&] { invalid.serialize(alias); }));
+    alias.release();
+
+    const auto read_second = [&] (archive::ObjectTable* table, auto first_pointer, auto second_pointer) {
+        invalid.rewind();
+        invalid.set_object_table(table);
+        invalid.deserialize(first_pointer);
+        invalid.deserialize(second_pointer);
+    };
+    archive::ObjectTable errors1;
+    assert(throws([&] { read_second(nullptr, std::shared_ptr<Pair>(), std::shared_ptr<Pair>()); }));
+    assert(throws([&] { read_second(&errors1, std::shared_ptr<Pair>(), std::unique_ptr<Pair>()); }));
+    errors1.clear();
+    assert(throws([&] { read_second(&errors1, std::shared_ptr<Pair>(), std::shared_ptr<int>()); }));
+    errors1.clear();
+    read_second(&errors1, std::shared_ptr<Pair>(), std::shared_ptr<Pair>());
+    std::unique_ptr<Pair> pair2;
+    std::shared_ptr<Pair> view2;
+    invalid.deserialize(pair2);
+    assert(pair2->first == 1 && throws([&] { invalid.deserialize(view2); }) && !view2);
+    // skipped pointers are read as raw pointers, which may refer back to an object of any owner
+    errors1.clear();
+    invalid.rewind();
+    invalid.skip<std::shared_ptr<Pair>>();
+    invalid.skip<std::shared_ptr<Pair>>();
+    invalid.skip<std::unique_ptr<Pair>>();
+    invalid.skip<std::shared_ptr<Pair>>();
+    assert(errors1.size() == 2 && invalid.get_storage().read_position() == invalid.size());
+    errors1.clear();
+    archive::BinaryArchive<archive::storage::Buffer> unknown;
+    const unsigned char code = 5;
+    unknown.get_storage().write(&code, 1);
+    unknown.set_object_table(&errors1);
+    assert(throws([&] { unknown.deserialize<Pair*>(); }));
+
+    // streams write objects with stream_serialization, a list owned by unique_ptr with raw back-pointers.
+    // It is reached through its head, a unique_ptr written after the object it owns could not be read back
+    ListNode head;
+    head.next = std::make_unique<ListNode>();
+    head.next->value = 1;
+    head.next->previous = &head;
+    head.next->next = std::make_unique<ListNode>();
+    head.next->next->value = 2;
+    head.next->next->previous = head.next.get();
+    archive::ObjectTable stream_writer;
+    archive::ObjectTable stream_reader;
+    archive::ArchiveStream<archive::BinaryArchive<archive::storage::Buffer>, archive::Direction::Bidirectional> stream;
+    stream.getArchive().set_object_table(&stream_writer);
+    const ListNode* list = &head;
+    stream << list << head.next->next->previous;
+    stream.getArchive().set_object_table(&stream_reader);
+    const ListNode* list1 = nullptr;
+    const ListNode* previous = nullptr;
+    stream >> list1 >> previous;
+    const ListNode* next = list1->next.get();
+    assert(list1->value == 0 && next->value == 1 && next->previous == list1 && next->next->value == 2);
+    assert(next->next->previous == next && previous == next);
+
+    archive::ObjectTable stream_skipper;
+    stream.getArchive().rewind();
+    stream.getArchive().set_object_table(&stream_skipper);
+    stream.skip<const ListNode*>() >> previous;
+    assert(previous && previous->value == 1 && stream_skipper.size() == stream_writer.size());
+
+    // parallel writes fall back to sequential
+    archive::ThreadPool pool(2);
+    archive::ObjectTable sequential_table;
+    archive::ObjectTable parallel_table;
+    archive::BinaryArchive<archive::storage::Buffer> sequential;
+    archive::BinaryArchive<archive::storage::Buffer> parallel;
+    sequential.set_object_table(&sequential_table);
+    parallel.set_object_table(&parallel_table);
+    sequential.serialize(roots);
+    parallel.serialize(roots, archive::parallel.on(pool).with_chunk_length(7));
+    assert(sequential.get_bytes() == parallel.get_bytes());
+}
+
 void test_empty() {
     struct Empty {};
     archive::BinaryArchive<DummyStorage<1024>> archive;
@@ -226,6 +2498,32 @@ int main() {
     test_arch();
     test_stream();
     test_directional();
+    test_contiguous();
+    test_serialized_size();
+    test_encodings();
+    test_byte_order();
+    test_views();
+    test_trivially_serializable();
+    test_memory_resource();
+    test_in_place();
+    test_parallel();
+    test_indexed();
+    test_lazy();
+    test_skip();
+    test_incremental();
+    test_record_log();
+    test_concurrent_log();
+    test_async_writer();
+    test_compress_storage();
+    test_checksum_storage();
+    test_packed();
+    test_columnar();
+    test_string_dictionary();
+    test_object_graph();
+#if defined(HAS_MMAP)
+    test_mmap();
+    test_gather_writer();
+#endif
     test_empty();
     std::cout << "OK\n";
 }